@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "authindex.h"
+
+// Card lookups: the old per-scan file scan against the in-memory AuthIndex
+
+#define INDEX_LOOKUPS 1000000
+#define SCAN_TIME_BUDGET_NS 2000000000ULL // stop the file scan after ~2 s per size
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// The lookup the overseer used to run on every scan
+static char* lookup_authorisation(const char* auth_file, const char* scanned_code) {
+    FILE* file = fopen(auth_file, "r");
+    if (!file) {
+        perror("Failed to open authorisation.txt");
+        return NULL;
+    }
+
+    static char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (strstr(line, scanned_code) != NULL) {
+            fclose(file);
+            return line;
+        }
+    }
+    fclose(file);
+    return NULL;
+}
+
+static uint64_t* write_cards(const char* path, size_t cards) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror("fopen()");
+        exit(1);
+    }
+
+    uint64_t* codes = malloc(cards * sizeof(uint64_t));
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < cards; i++) {
+        codes[i] = next_random(&state);
+        fprintf(file, "%016llx DOOR:%d DOOR:%d FLOOR:%d FLOOR:%d\n", (unsigned long long)codes[i],
+                (int)(100 + next_random(&state) % 400), (int)(100 + next_random(&state) % 400),
+                (int)(1 + next_random(&state) % 20), (int)(1 + next_random(&state) % 20));
+    }
+    fclose(file);
+    return codes;
+}
+
+static void run(size_t cards) {
+    char path[] = "/tmp/authbench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp()");
+        exit(1);
+    }
+    close(fd);
+
+    uint64_t* codes = write_cards(path, cards);
+    uint64_t state = 12345;
+    char code_text[17];
+
+    // File scan: random cards until the time budget runs out
+    unsigned long scans = 0;
+    uint64_t start = now_ns();
+    while (now_ns() - start < SCAN_TIME_BUDGET_NS) {
+        snprintf(code_text, sizeof(code_text), "%016llx", (unsigned long long)codes[next_random(&state) % cards]);
+        if (!lookup_authorisation(path, code_text)) {
+            fprintf(stderr, "file scan missed %s\n", code_text);
+        }
+        scans++;
+    }
+    double scan_ns = (double)(now_ns() - start) / scans;
+
+    start = now_ns();
+    AuthIndex* index = auth_index_load(path);
+    double load_ms = (now_ns() - start) / 1e6;
+    if (!index) {
+        exit(1);
+    }
+
+    unsigned long allowed = 0;
+    start = now_ns();
+    for (unsigned long i = 0; i < INDEX_LOOKUPS; i++) {
+        const uint64_t* grants = auth_index_lookup(index, codes[next_random(&state) % cards]);
+        allowed += grants && auth_index_allows(index, grants, AUTH_GRANT_DOOR, 101);
+    }
+    double index_ns = (double)(now_ns() - start) / INDEX_LOOKUPS;
+
+    printf("%8zu cards: file scan %12.0f ns/lookup (%lu lookups), index %6.1f ns/lookup, load %8.1f ms, speedup %.0fx\n",
+           cards, scan_ns, scans, index_ns, load_ms, scan_ns / index_ns);
+
+    auth_index_free(index);
+    free(codes);
+    unlink(path);
+}
+
+int main() {
+    size_t sizes[] = { 10000, 100000, 1000000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run(sizes[i]);
+    }
+    return 0;
+}
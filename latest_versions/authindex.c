@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "authindex.h"
+
+// 64-bit finaliser (splitmix64), spreads nearby codes and ids across the table
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static size_t table_size(size_t entries) {
+    size_t size = 16;
+    while (size < entries * 2) { // keep the load factor at or below 0.5
+        size <<= 1;
+    }
+    return size;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int auth_parse_code(const char* text, uint64_t* code) {
+    uint64_t value = 0;
+    int digits = 0;
+
+    for (; hex_value(*text) >= 0; text++, digits++) {
+        value = (value << 4) | hex_value(*text);
+    }
+    if (digits != 16 || (*text != '\0' && !isspace((unsigned char)*text))) {
+        return -1;
+    }
+    *code = value;
+    return 0;
+}
+
+// Parse "DOOR:n" or "FLOOR:n" between start and end into an interning key
+static int parse_grant(const char* start, const char* end, uint64_t* key) {
+    AuthGrantKind kind;
+    if (end - start > 5 && strncmp(start, "DOOR:", 5) == 0) {
+        kind = AUTH_GRANT_DOOR;
+        start += 5;
+    } else if (end - start > 6 && strncmp(start, "FLOOR:", 6) == 0) {
+        kind = AUTH_GRANT_FLOOR;
+        start += 6;
+    } else {
+        return -1;
+    }
+
+    long id = 0;
+    for (; start < end; start++) {
+        if (!isdigit((unsigned char)*start)) return -1;
+        id = id * 10 + (*start - '0');
+        if (id > INT32_MAX) return -1;
+    }
+    *key = ((uint64_t)kind << 32) | (uint32_t)id;
+    return 0;
+}
+
+static int find_grant(const AuthIndex* index, uint64_t key) {
+    for (size_t i = mix64(key) & index->grant_mask;; i = (i + 1) & index->grant_mask) {
+        if (index->grant_keys[i] == key) return index->grant_bits[i];
+        if (index->grant_keys[i] == 0) return -1;
+    }
+}
+
+static int intern_grant(AuthIndex* index, uint64_t key) {
+    if ((index->grant_count + 1) * 2 > index->grant_mask + 1) {
+        size_t old_size = index->grant_mask + 1;
+        uint64_t* old_keys = index->grant_keys;
+        uint32_t* old_bits = index->grant_bits;
+        size_t new_size = old_size * 2;
+
+        // Both tables or neither: on failure the old ones stay in place for the caller to free
+        uint64_t* keys = calloc(new_size, sizeof(uint64_t));
+        uint32_t* bits = calloc(new_size, sizeof(uint32_t));
+        if (!keys || !bits) {
+            perror("Failed to grow grant table");
+            free(keys);
+            free(bits);
+            return -1;
+        }
+        index->grant_keys = keys;
+        index->grant_bits = bits;
+        index->grant_mask = new_size - 1;
+        for (size_t i = 0; i < old_size; i++) {
+            if (old_keys[i] == 0) continue;
+            size_t j = mix64(old_keys[i]) & index->grant_mask;
+            while (index->grant_keys[j] != 0) j = (j + 1) & index->grant_mask;
+            index->grant_keys[j] = old_keys[i];
+            index->grant_bits[j] = old_bits[i];
+        }
+        free(old_keys);
+        free(old_bits);
+    }
+
+    size_t i = mix64(key) & index->grant_mask;
+    while (index->grant_keys[i] != 0) {
+        if (index->grant_keys[i] == key) return index->grant_bits[i];
+        i = (i + 1) & index->grant_mask;
+    }
+    index->grant_keys[i] = key;
+    index->grant_bits[i] = index->grant_count;
+    return index->grant_count++;
+}
+
+static AuthSlot* find_slot(const AuthIndex* index, uint64_t code) {
+    for (size_t i = mix64(code) & index->mask;; i = (i + 1) & index->mask) {
+        AuthSlot* slot = &index->slots[i];
+        if (slot->grants == AUTH_EMPTY_SLOT || slot->code == code) {
+            return slot;
+        }
+    }
+}
+
+static char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror("Failed to open authorisation file");
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* data = malloc(length + 1);
+    if (!data || fread(data, 1, length, file) != (size_t)length) {
+        perror("Failed to read authorisation file");
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    data[length] = '\0';
+    fclose(file);
+
+    *size = length;
+    return data;
+}
+
+/*
+ * Walk every line of the file. Pass 0 counts cards and interns grants,
+ * pass 1 fills the card table and the bitsets.
+ */
+static int scan_lines(AuthIndex* index, const char* data, int pass) {
+    const char* p = data;
+
+    while (*p) {
+        const char* eol = strchr(p, '\n');
+        if (!eol) eol = p + strlen(p);
+
+        uint64_t code;
+        const char* token = p;
+        while (token < eol && isspace((unsigned char)*token)) token++;
+
+        if (token < eol && auth_parse_code(token, &code) == 0) {
+            uint64_t* words = NULL;
+            if (pass == 0) {
+                index->count++;
+            } else {
+                AuthSlot* slot = find_slot(index, code);
+                if (slot->grants == AUTH_EMPTY_SLOT) {
+                    // Like the old file scan, the first line for a card wins
+                    slot->code = code;
+                    slot->grants = index->count++;
+                    words = &index->grant_words[(size_t)slot->grants * index->words_per_entry];
+                }
+            }
+
+            token += 16;
+            while (token < eol) {
+                while (token < eol && isspace((unsigned char)*token)) token++;
+                const char* end = token;
+                while (end < eol && !isspace((unsigned char)*end)) end++;
+
+                uint64_t key;
+                if (end > token && parse_grant(token, end, &key) == 0) {
+                    if (pass == 0) {
+                        if (intern_grant(index, key) < 0) return -1;
+                    } else if (words) {
+                        int bit = find_grant(index, key);
+                        words[bit / 64] |= 1ULL << (bit % 64);
+                    }
+                }
+                token = end;
+            }
+        }
+
+        p = *eol ? eol + 1 : eol;
+    }
+    return 0;
+}
+
+AuthIndex* auth_index_load(const char* path) {
+    size_t size;
+    char* data = read_file(path, &size);
+    if (!data) {
+        return NULL;
+    }
+
+    AuthIndex* index = calloc(1, sizeof(AuthIndex));
+    if (!index) {
+        free(data);
+        return NULL;
+    }
+    index->grant_mask = 15;
+    index->grant_keys = calloc(16, sizeof(uint64_t));
+    index->grant_bits = calloc(16, sizeof(uint32_t));
+    if (!index->grant_keys || !index->grant_bits || scan_lines(index, data, 0) == -1) {
+        free(data);
+        auth_index_free(index);
+        return NULL;
+    }
+
+    size_t size_slots = table_size(index->count);
+    index->words_per_entry = index->grant_count ? (index->grant_count + 63) / 64 : 1;
+    index->slots = malloc(size_slots * sizeof(AuthSlot));
+    index->grant_words = calloc(index->count ? index->count : 1, index->words_per_entry * sizeof(uint64_t));
+    if (!index->slots || !index->grant_words) {
+        perror("Failed to allocate authorisation index");
+        free(data);
+        auth_index_free(index);
+        return NULL;
+    }
+    for (size_t i = 0; i < size_slots; i++) {
+        index->slots[i].grants = AUTH_EMPTY_SLOT;
+    }
+    index->mask = size_slots - 1;
+    index->count = 0;
+
+    scan_lines(index, data, 1);
+    free(data);
+    return index;
+}
+
+void auth_index_free(AuthIndex* index) {
+    if (!index) return;
+    free(index->slots);
+    free(index->grant_keys);
+    free(index->grant_bits);
+    free(index->grant_words);
+    free(index);
+}
+
+const uint64_t* auth_index_lookup(const AuthIndex* index, uint64_t code) {
+    const AuthSlot* slot = find_slot(index, code);
+    if (slot->grants == AUTH_EMPTY_SLOT) {
+        return NULL;
+    }
+    return &index->grant_words[(size_t)slot->grants * index->words_per_entry];
+}
+
+int auth_index_allows(const AuthIndex* index, const uint64_t* grants, AuthGrantKind kind, int id) {
+    if (id < 0) return 0;
+    int bit = find_grant(index, ((uint64_t)kind << 32) | (uint32_t)id);
+    if (bit < 0) {
+        return 0; // nobody holds this grant
+    }
+    return (grants[bit / 64] >> (bit % 64)) & 1;
+}
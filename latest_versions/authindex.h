@@ -0,0 +1,69 @@
+#ifndef AUTHINDEX_H
+#define AUTHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUTH_EMPTY_SLOT UINT32_MAX
+
+typedef struct {
+    uint64_t code;
+    uint32_t grants; // index of the entry's bitset in grant_words, AUTH_EMPTY_SLOT if unused
+} AuthSlot;
+
+/*
+ * Read-only index of authorisation.txt, built once and then shared by
+ * every scan thread without locking.
+ *
+ * Card codes (16 hex digits) are keys of an open-addressing table with
+ * linear probing. Every distinct DOOR:n / FLOOR:n grant in the file is
+ * given a bit number, and each card's grants are stored as a bitset of
+ * words_per_entry 64-bit words.
+ */
+typedef struct {
+    AuthSlot* slots;
+    size_t mask;
+    size_t count;
+
+    uint64_t* grant_keys;   // interned grants: (kind << 32 | id), open addressing
+    uint32_t* grant_bits;   // bit number for grant_keys[i]
+    size_t grant_mask;
+    size_t grant_count;
+
+    size_t words_per_entry;
+    uint64_t* grant_words;
+} AuthIndex;
+
+typedef enum {
+    AUTH_GRANT_DOOR = 1,
+    AUTH_GRANT_FLOOR = 2
+} AuthGrantKind;
+
+/**
+ * Parse an authorisation file into a new index.
+ * @param path Path of authorisation.txt.
+ * @return The index, or NULL if the file could not be read.
+ */
+AuthIndex* auth_index_load(const char* path);
+
+void auth_index_free(AuthIndex* index);
+
+/**
+ * Parse a scanned card code (16 hex digits).
+ * @return 0 on success, -1 if the text is not a card code.
+ */
+int auth_parse_code(const char* text, uint64_t* code);
+
+/**
+ * Find the grant bitset of a card. Never allocates or locks.
+ * @return The card's bitset, or NULL if the card is unknown.
+ */
+const uint64_t* auth_index_lookup(const AuthIndex* index, uint64_t code);
+
+/**
+ * Test a card's bitset for a DOOR:id or FLOOR:id grant.
+ * @return 1 if granted, 0 otherwise.
+ */
+int auth_index_allows(const AuthIndex* index, const uint64_t* grants, AuthGrantKind kind, int id);
+
+#endif // AUTHINDEX_H
@@ -9,6 +9,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include "timerwheel.h"
 
 typedef struct {
     char status; 
@@ -20,6 +21,11 @@ typedef struct {
     char header[4];
 } FireEmergencyDatagram;
 
+typedef struct {
+    const char *address;
+    int port;
+} FireAlarmTarget;
+
 void send_fire_emergency_datagram(const char *fire_alarm_addr, int fire_alarm_port) {
     int sockfd;
     struct sockaddr_in fire_alarm_addr_struct;
@@ -38,6 +44,12 @@ void send_fire_emergency_datagram(const char *fire_alarm_addr, int fire_alarm_po
     close(sockfd);
 }
 
+// Timer callback: one FIRE datagram per {resend delay} while the call point is triggered
+void resend_fire_emergency(void *arg) {
+    FireAlarmTarget *target = arg;
+    send_fire_emergency_datagram(target->address, target->port);
+}
+
 int main(int argc, char *argv[]) {
     if (argc != 5) {
         fprintf(stderr, "Usage: %s {resend delay (in microseconds)} {shared memory path} {shared memory offset} {fire alarm unit address:port}\n", argv[0]);
@@ -68,20 +80,33 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
     SharedMemory *sharedMem = (SharedMemory *)(shm + shm_offset);
-    while (1) { 
-        pthread_mutex_lock(&sharedMem->mutex);
 
+    TimerWheel wheel;
+    unsigned int tick_us = resend_delay > 0 && resend_delay < TIMER_DEFAULT_TICK_US ? resend_delay : TIMER_DEFAULT_TICK_US;
+    if (timer_wheel_init(&wheel, tick_us) == -1 || timer_wheel_start(&wheel) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    FireAlarmTarget target = { fire_alarm_addr, fire_alarm_port };
+    Timer resend_timer;
+    timer_init(&resend_timer, resend_fire_emergency, &target);
+
+    pthread_mutex_lock(&sharedMem->mutex);
+    while (1) { 
         while (sharedMem->status != '*') {
             pthread_cond_wait(&sharedMem->cond, &sharedMem->mutex);
         }
-        if (sharedMem->status == '*') {
-            send_fire_emergency_datagram(fire_alarm_addr, fire_alarm_port);
-            usleep(resend_delay);
-        }
 
-        pthread_mutex_unlock(&sharedMem->mutex);
+        // Resends run on the timer thread, so the mutex is not held between them
+        timer_arm(&wheel, &resend_timer, 0, resend_delay);
+
+        while (sharedMem->status == '*') {
+            pthread_cond_wait(&sharedMem->cond, &sharedMem->mutex);
+        }
+        timer_cancel_sync(&wheel, &resend_timer);
     }
+    pthread_mutex_unlock(&sharedMem->mutex);
 
+    timer_wheel_destroy(&wheel);
     munmap(sharedMem, sizeof(SharedMemory));
     close(shm_fd);
     return 0;
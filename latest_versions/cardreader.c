@@ -11,6 +11,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/types.h>
+#include "frame.h"
 
 #define BUFFER_SIZE 64
 
@@ -55,6 +56,48 @@ int send_init_message(const char *id, const char *addr, int port) {
     return 0;
 }
 
+// Send a SCANNED message and wait for the overseer's verdict: 'Y' if ALLOWED#, 'N' otherwise
+char request_access(const char *id, const char *scanned, const char *addr, int port) {
+    char message[BUFFER_SIZE]; // Create message
+    snprintf(message, sizeof(message), "CARDREADER %s SCANNED %s#", id, scanned);
+
+    int sockfd;
+    struct sockaddr_in overseer_addr;
+
+    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("ERROR opening socket");
+        return 'N';
+    }
+
+    overseer_addr.sin_family = AF_INET;
+    overseer_addr.sin_port = htons(port);
+    overseer_addr.sin_addr.s_addr = inet_addr(addr);
+
+    if (connect(sockfd, (struct sockaddr *)&overseer_addr, sizeof(overseer_addr)) < 0) {
+        perror("ERROR connecting");
+        close(sockfd); // Ensure socket is closed to release the resource.
+        return 'N';
+    }
+
+    ssize_t bytes_sent = send(sockfd, message, strlen(message), 0);
+    if (bytes_sent < 0 || (size_t)bytes_sent != strlen(message)) {
+        perror("ERROR sending message");
+        close(sockfd);
+        return 'N';
+    }
+
+    FrameReader reader;
+    frame_reader_init(&reader);
+    char *response = frame_read(&reader, sockfd, NULL);
+    close(sockfd);
+
+    if (response != NULL && strcmp(response, "ALLOWED") == 0) {
+        return 'Y';
+    }
+    return 'N';
+}
+
 int main(int argc, char *argv[]) {
     
     if (argc != 6) {
@@ -103,76 +146,10 @@ int main(int argc, char *argv[]) {
         if(shared->scanned[0] != '\0') {          
 
             // Connect to overseer and send scanned data
-
-            char message[BUFFER_SIZE]; // Create message
-            snprintf(message, sizeof(message), "CARDREADER %s SCANNED %s#", id, shared->scanned);
-
-            int sockfd;
-            struct sockaddr_in overseer_addr;
-            char response[BUFFER_SIZE];
-
-            sockfd = socket(AF_INET, SOCK_STREAM, 0);
-            overseer_addr.sin_family = AF_INET;
-            overseer_addr.sin_port = htons(overseer_port);
-            overseer_addr.sin_addr.s_addr = inet_addr(overseer_addr_str);
-
-            if (sockfd < 0) {
-                perror("ERROR opening socket");
-                shared->response = 'N';
-                pthread_cond_signal(&(shared->response_cond));
-                pthread_mutex_unlock(&(shared->mutex)); // Ensure unlocking mutex before continuing.
-                continue;
-            }
-
-            if (connect(sockfd, (struct sockaddr *)&overseer_addr, sizeof(overseer_addr)) < 0) {
-                perror("ERROR connecting");
-                close(sockfd); // Ensure socket is closed to release the resource.
-                shared->response = 'N';
-                pthread_cond_signal(&(shared->response_cond));
-                pthread_mutex_unlock(&(shared->mutex)); // Ensure unlocking mutex before continuing.
-                continue;
-            }
-
-            ssize_t bytes_sent = send(sockfd, message, strlen(message), 0);
-            if (bytes_sent < 0 || bytes_sent != strlen(message)) {
-                perror("ERROR sending message");
-                close(sockfd); // Ensure socket is closed to release the resource.
-                shared->response = 'N';
-                pthread_cond_signal(&(shared->response_cond));
-                pthread_mutex_unlock(&(shared->mutex)); // Ensure unlocking mutex before continuing.
-                continue;
-            }
-
-            ssize_t bytes_read = read(sockfd, response, sizeof(response)-1);
-            if (bytes_read < 0) {
-                perror("ERROR reading from socket");
-                close(sockfd); // Ensure socket is closed to release the resource.
-                shared->response = 'N';
-                pthread_cond_signal(&(shared->response_cond));
-                pthread_mutex_unlock(&(shared->mutex)); // Ensure unlocking mutex before continuing.
-                continue;
-            }
-
-            if (connect(sockfd, (struct sockaddr *)&overseer_addr, sizeof(overseer_addr)) == 0) {
-                send(sockfd, message, strlen(message), 0);
-                read(sockfd, response, sizeof(response));
-                close(sockfd);
-
-                if (strncmp(response, "ALLOWED#", 8) == 0) {
-                    shared->response = 'Y';
-                } else {
-                    shared->response = 'N';
-                }
-                pthread_cond_signal(&(shared->response_cond));
-            } else {
-                shared->response = 'N';
-                pthread_cond_signal(&(shared->response_cond));
-            }
+            shared->response = request_access(id, shared->scanned, overseer_addr_str, overseer_port);
+            pthread_cond_signal(&(shared->response_cond));
 
             memset(shared->scanned, 0, sizeof(shared->scanned));
-
-            pthread_mutex_unlock(&(shared->mutex));
-
         }
         pthread_cond_wait(&shared->scanned_cond, &shared->mutex); // Wait until scanned_cond is updated
     }
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "detection.h"
+
+#define DETECTION_INITIAL_SENSORS 64
+#define DETECTION_INITIAL_EXPIRIES 256
+
+static uint64_t cutoff_for(const DetectionWindow* window, uint64_t now_us) {
+    return now_us > window->period_us ? now_us - window->period_us : 0;
+}
+
+int detection_init(DetectionWindow* window, int min_detections, uint64_t period_us) {
+    memset(window, 0, sizeof(*window));
+    window->period_us = period_us;
+    window->capacity = min_detections > 0 ? (size_t)min_detections : 1;
+    window->sensors = calloc(DETECTION_INITIAL_SENSORS, sizeof(SensorWindow));
+    window->expiries = malloc(DETECTION_INITIAL_EXPIRIES * sizeof(DetectionExpiry));
+    if (!window->sensors || !window->expiries) {
+        perror("Failed to allocate detection window");
+        detection_free(window);
+        return -1;
+    }
+    window->sensor_mask = DETECTION_INITIAL_SENSORS - 1;
+    window->expiry_mask = DETECTION_INITIAL_EXPIRIES - 1;
+    return 0;
+}
+
+void detection_free(DetectionWindow* window) {
+    if (window->sensors) {
+        for (size_t i = 0; i <= window->sensor_mask; i++) {
+            free(window->sensors[i].ring);
+        }
+    }
+    free(window->sensors);
+    free(window->expiries);
+    memset(window, 0, sizeof(*window));
+}
+
+static SensorWindow* slot_for(SensorWindow* sensors, size_t mask, uint16_t id) {
+    size_t slot = (id * 0x9E3779B1u) & mask;
+    while (sensors[slot].used && sensors[slot].id != id) {
+        slot = (slot + 1) & mask;
+    }
+    return &sensors[slot];
+}
+
+static int grow(DetectionWindow* window) {
+    size_t capacity = (window->sensor_mask + 1) * 2;
+    SensorWindow* sensors = calloc(capacity, sizeof(SensorWindow));
+    if (!sensors) {
+        return -1;
+    }
+    for (size_t i = 0; i <= window->sensor_mask; i++) {
+        if (window->sensors[i].used) {
+            *slot_for(sensors, capacity - 1, window->sensors[i].id) = window->sensors[i];
+        }
+    }
+    free(window->sensors);
+    window->sensors = sensors;
+    window->sensor_mask = capacity - 1;
+    return 0;
+}
+
+static SensorWindow* find_or_add_sensor(DetectionWindow* window, uint16_t id) {
+    SensorWindow* sensor = slot_for(window->sensors, window->sensor_mask, id);
+    if (sensor->used) {
+        return sensor;
+    }
+    // Keep the table at most half full
+    if ((window->sensor_count + 1) * 2 > window->sensor_mask + 1) {
+        if (grow(window) == -1) {
+            return NULL;
+        }
+        sensor = slot_for(window->sensors, window->sensor_mask, id);
+    }
+    sensor->ring = malloc(window->capacity * sizeof(uint64_t));
+    if (!sensor->ring) {
+        return NULL;
+    }
+    sensor->id = id;
+    sensor->used = 1;
+    window->sensor_count++;
+    return sensor;
+}
+
+static void drop_oldest(DetectionWindow* window, SensorWindow* sensor) {
+    sensor->head = (sensor->head + 1) % window->capacity;
+    sensor->count--;
+    window->total--;
+}
+
+// Pop every reading that has left the period off the front of the FIFO
+static void expire(DetectionWindow* window, uint64_t now_us) {
+    uint64_t cutoff = cutoff_for(window, now_us);
+    while (window->expiry_count && window->expiries[window->expiry_head].timestamp_us < cutoff) {
+        const DetectionExpiry* expiry = &window->expiries[window->expiry_head];
+        SensorWindow* sensor = slot_for(window->sensors, window->sensor_mask, expiry->sensor);
+        // Otherwise the sensor already pushed this reading out of its full ring
+        if (sensor->count && sensor->ring[sensor->head] == expiry->timestamp_us) {
+            drop_oldest(window, sensor);
+        }
+        window->expiry_head = (window->expiry_head + 1) & window->expiry_mask;
+        window->expiry_count--;
+    }
+}
+
+static int queue_expiry(DetectionWindow* window, uint16_t sensor, uint64_t timestamp_us) {
+    if (window->expiry_count == window->expiry_mask + 1) {
+        size_t size = (window->expiry_mask + 1) * 2;
+        DetectionExpiry* expiries = malloc(size * sizeof(DetectionExpiry));
+        if (!expiries) {
+            return -1;
+        }
+        for (size_t i = 0; i < window->expiry_count; i++) {
+            expiries[i] = window->expiries[(window->expiry_head + i) & window->expiry_mask];
+        }
+        free(window->expiries);
+        window->expiries = expiries;
+        window->expiry_head = 0;
+        window->expiry_mask = size - 1;
+    }
+
+    // Usually the newest reading and appended; a late one moves back past the newer ones
+    size_t position = window->expiry_count;
+    while (position > 0) {
+        DetectionExpiry* before = &window->expiries[(window->expiry_head + position - 1) & window->expiry_mask];
+        if (before->timestamp_us <= timestamp_us) {
+            break;
+        }
+        window->expiries[(window->expiry_head + position) & window->expiry_mask] = *before;
+        position--;
+    }
+    DetectionExpiry* expiry = &window->expiries[(window->expiry_head + position) & window->expiry_mask];
+    expiry->sensor = sensor;
+    expiry->timestamp_us = timestamp_us;
+    window->expiry_count++;
+    return 0;
+}
+
+long detection_record(DetectionWindow* window, uint16_t sensor_id, uint64_t timestamp_us, uint64_t now_us) {
+    expire(window, now_us);
+    if (timestamp_us < cutoff_for(window, now_us)) {
+        window->stale++;
+        return window->total;
+    }
+
+    SensorWindow* sensor = find_or_add_sensor(window, sensor_id);
+    if (!sensor) {
+        perror("Failed to track temperature sensor");
+        return -1;
+    }
+    // A sensor's readings are taken in order: anything not newer is a forwarded copy or arrived late
+    if (timestamp_us <= sensor->newest_us) {
+        window->stale++;
+        return window->total;
+    }
+    if (queue_expiry(window, sensor_id, timestamp_us) == -1) {
+        perror("Failed to queue temperature reading");
+        return -1;
+    }
+    sensor->newest_us = timestamp_us;
+
+    if (sensor->count == window->capacity) {
+        // This sensor alone already fills its share; its newest readings are the ones worth keeping
+        drop_oldest(window, sensor);
+    }
+    sensor->ring[(sensor->head + sensor->count) % window->capacity] = timestamp_us;
+    sensor->count++;
+    window->total++;
+    return window->total;
+}
@@ -0,0 +1,67 @@
+#ifndef DETECTION_H
+#define DETECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One sensor's recent hot readings, oldest first, in a ring of min_detections slots
+typedef struct {
+    uint16_t id;
+    int used;
+    uint64_t* ring;     // reading timestamps in microseconds
+    size_t head;        // oldest reading
+    size_t count;       // readings still inside the detection period
+    uint64_t newest_us; // latest reading taken, so copies and stale readings are not counted twice
+} SensorWindow;
+
+// A counted reading waiting to leave the period
+typedef struct {
+    uint16_t sensor;
+    uint64_t timestamp_us;
+} DetectionExpiry;
+
+/*
+ * Sliding-window detection counter over every temperature sensor. Each
+ * sensor keeps its own ring, so one sensor reporting at a high rate only
+ * ever holds min_detections slots and cannot push out other sensors'
+ * readings. A running total across all sensors is what the alarm checks.
+ *
+ * Every counted reading is also queued in one FIFO ordered by timestamp,
+ * and expiry pops from its front, so each reading is queued and popped
+ * once: amortised O(1) per reading whatever the number of sensors.
+ * Readings mostly arrive in timestamp order and are appended; one that
+ * arrives behind newer readings is moved back past them. A reading its
+ * sensor has already pushed out of its ring is skipped when it is popped.
+ */
+typedef struct {
+    uint64_t period_us;
+    size_t capacity; // ring slots per sensor: min_detections
+    SensorWindow* sensors; // open-addressing table keyed by sensor ID
+    size_t sensor_count;
+    size_t sensor_mask;
+    size_t total;            // readings inside the period, over every sensor
+    DetectionExpiry* expiries; // counted readings in timestamp order, oldest at expiry_head
+    size_t expiry_head;
+    size_t expiry_count;
+    size_t expiry_mask;      // ring size - 1, a power of two
+    unsigned long stale;     // older than the period on arrival, or not newer than the sensor's last
+} DetectionWindow;
+
+/**
+ * @param min_detections Readings needed within the period; also each sensor's ring size.
+ * @param period_us Detection period in microseconds.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int detection_init(DetectionWindow* window, int min_detections, uint64_t period_us);
+
+void detection_free(DetectionWindow* window);
+
+/**
+ * Count a hot reading from a sensor and expire whatever has left the period.
+ * @param timestamp_us When the sensor took the reading.
+ * @param now_us The current time, on the same clock.
+ * @return Readings inside the period over every sensor, or -1 on allocation failure.
+ */
+long detection_record(DetectionWindow* window, uint16_t sensor, uint64_t timestamp_us, uint64_t now_us);
+
+#endif // DETECTION_H
@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include "frame.h"
 
 #define BUFFER_SIZE 1024
 
@@ -26,6 +27,17 @@ const char *security_mode;
 const char *overseer_addr; 
 int overseer_port;
 
+typedef enum { NORMAL_MODE, EMERGENCY_MODE, SECURE_MODE } DoorMode;
+
+// Emergency and secure mode apply to every connection, not just the one that set them
+volatile DoorMode door_mode = NORMAL_MODE;
+pthread_mutex_t operation_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    int client_sock;
+    SharedMemory *sharedMem;
+} ConnectionArgs;
+
 int send_init_message(const char *id, const char *addr_port, const char *security_mode, const char *overseer_addr, int overseer_port) {
     int sockfd;
     struct sockaddr_in overseer_addr_struct;
@@ -52,102 +64,87 @@ int send_init_message(const char *id, const char *addr_port, const char *securit
     return 0;
 }
 
-int send_message(const char* x) {
-    int sockfd;
-    struct sockaddr_in overseer_addr_struct;
+int send_message(int client_sock, const char* x) {
     char message[BUFFER_SIZE];
 
     snprintf(message, sizeof(message), "%s#", x);
-
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        perror("Socket creation error");
-        return -1;
-    }
-
-    overseer_addr_struct.sin_family = AF_INET;
-    overseer_addr_struct.sin_port = htons(overseer_port);
-    overseer_addr_struct.sin_addr.s_addr = inet_addr(overseer_addr);
-
-    if (connect(sockfd, (struct sockaddr *)&overseer_addr_struct, sizeof(overseer_addr_struct)) < 0) {
-        perror("Connection failed");
+    if (send(client_sock, message, strlen(message), MSG_NOSIGNAL) < 0) {
+        perror("Failed to send reply");
         return -1;
     }
-
-    send(sockfd, message, strlen(message), 0);
-    close(sockfd);
     return 0;
 }
 
-void handle_door_operations(int client_sock, SharedMemory *sharedMem, char *buffer, size_t bufferSize) {
+// Drive the simulated door to the target state ('O' or 'C') through its transitional state
+void move_door(SharedMemory *sharedMem, char transitional) {
+    pthread_mutex_lock(&sharedMem->mutex);
+    sharedMem->status = transitional;
+    pthread_cond_signal(&sharedMem->cond_start);
+    pthread_cond_wait(&sharedMem->cond_end, &sharedMem->mutex);
+    pthread_mutex_unlock(&sharedMem->mutex);
+}
+
+void handle_door_operations(int client_sock, SharedMemory *sharedMem, const char *command) {
+    // Connections are served concurrently but the door itself moves for one command at a time
+    pthread_mutex_lock(&operation_mutex);
+
     pthread_mutex_lock(&sharedMem->mutex);
     char door_status = sharedMem->status;
     pthread_mutex_unlock(&sharedMem->mutex);
 
-    if (strncmp(buffer, "OPEN#", 5) == 0) {
-        if (door_status == 'O') {
-            send_message("ALREADY");
+    if (strcmp(command, "OPEN") == 0) {
+        if (door_mode == SECURE_MODE) {
+            send_message(client_sock, "SECURE_MODE");
+        } else if (door_status == 'O') {
+            send_message(client_sock, "ALREADY");
         } else {
-            send_message("OPENING");
-            
-            pthread_mutex_lock(&sharedMem->mutex);
-            sharedMem->status = 'o';
-            pthread_cond_signal(&sharedMem->cond_start);
-            pthread_cond_wait(&sharedMem->cond_end, &sharedMem->mutex);
-            pthread_mutex_unlock(&sharedMem->mutex);
-            send_message("OPENED");
-            
+            send_message(client_sock, "OPENING");
+            move_door(sharedMem, 'o');
+            send_message(client_sock, "OPENED");
         }
-    } else if (strncmp(buffer, "CLOSE#", 6) == 0) {
-            if (door_status == 'C') {
-            send_message("ALREADY");
+    } else if (strcmp(command, "CLOSE") == 0) {
+        if (door_mode == EMERGENCY_MODE) {
+            send_message(client_sock, "EMERGENCY_MODE");
+        } else if (door_status == 'C') {
+            send_message(client_sock, "ALREADY");
         } else {
-            send_message("CLOSING");           
-            pthread_mutex_lock(&(sharedMem->mutex));
-            sharedMem->status = 'c';
-            pthread_cond_signal(&(sharedMem->cond_start));
-            pthread_cond_wait(&(sharedMem->cond_end), &(sharedMem->mutex));
-            pthread_mutex_unlock(&(sharedMem->mutex));
-            send_message("CLOSED");
-        }
-    } else if (strncmp(buffer, "OPEN_EMERG#", 11) == 0) {
-        pthread_mutex_lock(&(sharedMem->mutex));
-        if (sharedMem->status != 'O') {
-            sharedMem->status = 'o'; // Set status to opening
-            pthread_cond_signal(&(sharedMem->cond_start));
-            pthread_cond_wait(&sharedMem->cond_end, &sharedMem->mutex); // Wait for the door to open
+            send_message(client_sock, "CLOSING");
+            move_door(sharedMem, 'c');
+            send_message(client_sock, "CLOSED");
         }
-        pthread_mutex_unlock(&(sharedMem->mutex));
-        send_message("EMERGENCY_MODE");        
+    } else if (strcmp(command, "OPEN_EMERG") == 0) {
         // From this point, the door will not respond to CLOSE# commands
-        while (1) {
-            ssize_t n = read(client_sock, buffer, bufferSize - 1);
-            if (n < 0) break;
-            buffer[n] = '\0';
-            if (strncmp(buffer, "CLOSE#", 6) == 0) {
-                send_message("EMERGENCY_MODE");
-            }
+        door_mode = EMERGENCY_MODE;
+        if (door_status != 'O') {
+            move_door(sharedMem, 'o');
         }
-        
-    } else if (strncmp(buffer, "CLOSE_SECURE#", 13) == 0) {
-        pthread_mutex_lock(&(sharedMem->mutex));
-        if (sharedMem->status != 'C') {
-            sharedMem->status = 'c'; // Set status to closing
-            pthread_cond_signal(&(sharedMem->cond_start));
-            pthread_cond_wait(&sharedMem->cond_end, &sharedMem->mutex); // Wait for the door to close
-        }
-        pthread_mutex_unlock(&(sharedMem->mutex));
-        send_message("SECURE_MODE");
+        send_message(client_sock, "EMERGENCY_MODE");
+    } else if (strcmp(command, "CLOSE_SECURE") == 0) {
         // From this point, the door will not respond to OPEN# commands
-        while (1) {
-            ssize_t n = read(client_sock, buffer, bufferSize - 1);
-            if (n <= 0) break;
-            buffer[n] = '\0';
-            if (strncmp(buffer, "OPEN#", 5) == 0) {
-                send_message("SECURE_MODE");
-            }
+        door_mode = SECURE_MODE;
+        if (door_status != 'C') {
+            move_door(sharedMem, 'c');
         }
+        send_message(client_sock, "SECURE_MODE");
+    }
+
+    pthread_mutex_unlock(&operation_mutex);
+}
+
+// Serve every command on one connection; the overseer keeps its connection open between commands
+void *connection_thread(void *arg) {
+    ConnectionArgs *args = (ConnectionArgs *)arg;
+    FrameReader reader;
+    char *command;
+
+    frame_reader_init(&reader);
+    while ((command = frame_read(&reader, args->client_sock, NULL)) != NULL) {
+        handle_door_operations(args->client_sock, args->sharedMem, command);
     }
-    close(client_sock);
+
+    close(args->client_sock);
+    free(args);
+    return NULL;
 }
 
 int main(int argc, char *argv[]) {
@@ -187,11 +184,6 @@ int main(int argc, char *argv[]) {
     sharedMem->status = 'C';
     pthread_mutex_unlock(&(sharedMem->mutex));
 
-    if (send_init_message(id, addr_port, security_mode, overseer_addr, overseer_port) != 0) {
-        fprintf(stderr, "Failed to send initialization message.\n");
-        exit(EXIT_FAILURE);
-    }
-
     //bind and listen to the specified TCP port
     int sockfd, newsockfd;
     struct sockaddr_in server_addr, client_addr;
@@ -207,6 +199,9 @@ int main(int argc, char *argv[]) {
 
     sscanf(addr_port, "%15[^:]:%d", ip, &port); //extract IP and port
 
+    int reuse = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
@@ -218,6 +213,12 @@ int main(int argc, char *argv[]) {
     }
     listen(sockfd, 5);
 
+    // Register only once the port is listening, the overseer may connect straight away
+    if (send_init_message(id, addr_port, security_mode, overseer_addr, overseer_port) != 0) {
+        fprintf(stderr, "Failed to send initialization message.\n");
+        exit(EXIT_FAILURE);
+    }
+
     while (1) {
         newsockfd = accept(sockfd, (struct sockaddr *)&client_addr, &clientlen);
         if (newsockfd < 0) {
@@ -225,20 +226,18 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        char buffer[1024] = {0};
-        ssize_t total_bytes_read = 0;
-        char current_byte;
-        //read byte-by-byte to find the end of the message or till buffer is full
-        while (recv(newsockfd, &current_byte, 1, 0) == 1) { 
-            buffer[total_bytes_read] = current_byte;
-            total_bytes_read++;
-            if (current_byte == '#' || total_bytes_read >= sizeof(buffer) - 1) { 
-                break;
-            }
+        ConnectionArgs *args = malloc(sizeof(ConnectionArgs));
+        args->client_sock = newsockfd;
+        args->sharedMem = sharedMem;
+
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, connection_thread, args) != 0) {
+            perror("ERROR creating connection thread");
+            close(newsockfd);
+            free(args);
+            continue;
         }
-        buffer[total_bytes_read] = '\0'; 
-        handle_door_operations(newsockfd, sharedMem, buffer, sizeof(buffer));
-        close(newsockfd);
+        pthread_detach(tid);
     }
 
     munmap(sharedMem, sizeof(SharedMemory));
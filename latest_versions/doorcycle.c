@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "doorcycle.h"
+#include "latency.h"
+
+#define CYCLE_MAX_EVENTS 64
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void update_max(atomic_ulong* max, unsigned long value) {
+    unsigned long seen = atomic_load_explicit(max, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak(max, &seen, value)) {
+    }
+}
+
+// Queue a request for the engine thread and wake it
+static int post(DoorCycleEngine* engine, const CycleRequest* request) {
+    pthread_mutex_lock(&engine->lock);
+    if (engine->pending_count == engine->pending_capacity) {
+        size_t capacity = engine->pending_capacity ? engine->pending_capacity * 2 : 16;
+        CycleRequest* grown = realloc(engine->pending, capacity * sizeof(CycleRequest));
+        if (!grown) {
+            pthread_mutex_unlock(&engine->lock);
+            perror("Failed to queue door cycle");
+            return -1;
+        }
+        engine->pending = grown;
+        engine->pending_capacity = capacity;
+    }
+    engine->pending[engine->pending_count++] = *request;
+    pthread_mutex_unlock(&engine->lock);
+
+    uint64_t one = 1;
+    if (write(engine->wake_fd, &one, sizeof(one)) == -1) {
+        perror("eventfd write failed");
+    }
+    return 0;
+}
+
+// Runs on the timer thread: hand the deadline to the engine thread, which owns the cycle
+static void cycle_timer_fired(void* arg) {
+    DoorCycle* cycle = arg;
+    CycleRequest request = { .kind = CYCLE_DEADLINE, .slot = cycle->slot };
+    if (post(cycle->engine, &request) == -1) {
+        fprintf(stderr, "Door %s: lost a cycle deadline\n", cycle->link->id);
+    }
+}
+
+// Runs on the thread releasing the link: the cycle waiting for it can go ahead
+static void cycle_link_released(void* arg) {
+    DoorCycle* cycle = arg;
+    CycleRequest request = { .kind = CYCLE_LINK_FREE, .slot = cycle->slot };
+    if (post(cycle->engine, &request) == -1) {
+        fprintf(stderr, "Door %s: lost a link release\n", cycle->link->id);
+    }
+}
+
+// Stop watching the link's connection; it stays open for the link's next command
+static void detach(DoorCycleEngine* engine, DoorCycle* cycle) {
+    if (cycle->fd != -1) {
+        epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, cycle->fd, NULL);
+        cycle->fd = -1;
+    }
+    cycle->connecting = 0;
+}
+
+// Close the connection, e.g. to redial, keeping hold of the link
+static void drop(DoorCycleEngine* engine, DoorCycle* cycle) {
+    detach(engine, cycle);
+    door_link_disconnect(cycle->link);
+}
+
+static void release(DoorCycleEngine* engine, DoorCycle* cycle, int answered) {
+    if (cycle->owned) {
+        detach(engine, cycle);
+        door_link_release(cycle->link, answered);
+        cycle->owned = 0;
+    }
+}
+
+static void set_deadline(DoorCycleEngine* engine, DoorCycle* cycle, uint64_t delay_ns) {
+    cycle->deadline_ns = now_ns() + delay_ns;
+    timer_arm(engine->wheel, &cycle->timer, (delay_ns + 999) / 1000, 0);
+}
+
+static void finish(DoorCycleEngine* engine, DoorCycle* cycle) {
+    cycle->state = CYCLE_IDLE;
+    cycle->reopen = 0;
+    cycle->deadline_ns = 0;
+    timer_cancel(engine->wheel, &cycle->timer);
+    atomic_fetch_sub(&engine->active, 1);
+}
+
+static void fail(DoorCycleEngine* engine, DoorCycle* cycle, const char* why) {
+    fprintf(stderr, "Door %s at %s:%d: %s while %s\n", cycle->link->id, cycle->link->address, cycle->link->port, why,
+            cycle->state == CYCLE_CLOSING ? "closing" : "opening");
+    release(engine, cycle, 0);
+    atomic_fetch_add(&engine->failed, 1);
+    finish(engine, cycle);
+}
+
+static const char* command_for(CycleState state) {
+    return state == CYCLE_CLOSING ? "CLOSE#" : "OPEN#";
+}
+
+// Send the outstanding command on the owned link, connecting first if needed
+static void send_command(DoorCycleEngine* engine, DoorCycle* cycle) {
+    if (cycle->fd == -1) {
+        int reused, connecting;
+        int sockfd = door_link_connection(cycle->link, &reused, &connecting);
+        if (sockfd == -1) {
+            fail(engine, cycle, "connect failed");
+            return;
+        }
+
+        struct epoll_event event = { .events = connecting ? EPOLLOUT : EPOLLIN | EPOLLRDHUP, .data.ptr = cycle };
+        if (epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+            perror("epoll_ctl failed");
+            fail(engine, cycle, "connect failed");
+            return;
+        }
+        cycle->fd = sockfd;
+        cycle->connecting = connecting;
+        cycle->reused = reused;
+        if (connecting) {
+            set_deadline(engine, cycle, (uint64_t)DOOR_CONNECT_TIMEOUT_MS * 1000000ULL);
+            return;
+        }
+    }
+    if (cycle->connecting) {
+        return; // sent once the connect completes
+    }
+
+    const char* command = command_for(cycle->state);
+    size_t len = strlen(command);
+    if (send(cycle->fd, command, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        drop(engine, cycle);
+        if (cycle->reused && !cycle->redialled) {
+            // The door may have restarted since the last command: dial once more
+            cycle->redialled = 1;
+            send_command(engine, cycle);
+        } else {
+            fail(engine, cycle, "send failed");
+        }
+        return;
+    }
+    cycle->sent_ns = now_ns();
+    if (cycle->state == CYCLE_CLOSING && cycle->last_scan_ns) {
+        latency_record(STAGE_DOOR_CLOSE_SENT, cycle->sent_ns - cycle->last_scan_ns);
+    }
+    set_deadline(engine, cycle, (uint64_t)DOOR_REPLY_TIMEOUT_MS * 1000000ULL);
+}
+
+// Put the cycle into `state` and send its command once it has the door's link
+static void start_command(DoorCycleEngine* engine, DoorCycle* cycle, CycleState state) {
+    cycle->state = state;
+    if (door_link_try_acquire(cycle->link, cycle_link_released, cycle) == -1) {
+        // A manual command has the connection, bounded by the link's timeouts; its release posts CYCLE_LINK_FREE
+        cycle->waiting = 1;
+        timer_cancel(engine->wheel, &cycle->timer);
+        return;
+    }
+    cycle->waiting = 0;
+    cycle->owned = 1;
+    cycle->redialled = 0;
+    send_command(engine, cycle);
+}
+
+static void connected(DoorCycleEngine* engine, DoorCycle* cycle) {
+    if (door_link_connected(cycle->link) == -1) {
+        fail(engine, cycle, "connect failed");
+        return;
+    }
+
+    cycle->connecting = 0;
+    struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = cycle };
+    epoll_ctl(engine->epoll_fd, EPOLL_CTL_MOD, cycle->fd, &event);
+    send_command(engine, cycle);
+}
+
+static void on_reply(DoorCycleEngine* engine, DoorCycle* cycle, const char* reply) {
+    if (strcmp(reply, "OPENING") == 0 || strcmp(reply, "CLOSING") == 0) {
+        return;
+    }
+
+    switch (cycle->state) {
+    case CYCLE_OPENING:
+        release(engine, cycle, 1);
+        if (strcmp(reply, "OPENED") == 0) {
+            if (cycle->open_scan_ns) {
+                latency_record(STAGE_DOOR_OPENED, now_ns() - cycle->open_scan_ns);
+            }
+            cycle->state = CYCLE_HOLDING;
+            set_deadline(engine, cycle, engine->hold_ns);
+        } else {
+            // ALREADY, EMERGENCY_MODE or SECURE_MODE: the door is not ours to close
+            atomic_fetch_add(&engine->refused, 1);
+            finish(engine, cycle);
+        }
+        break;
+    case CYCLE_CLOSING:
+        release(engine, cycle, 1);
+        if (cycle->reopen) {
+            cycle->reopen = 0;
+            cycle->open_scan_ns = cycle->last_scan_ns;
+            atomic_fetch_add(&engine->reopened, 1);
+            start_command(engine, cycle, CYCLE_OPENING);
+        } else {
+            atomic_fetch_add(&engine->completed, 1);
+            finish(engine, cycle);
+        }
+        break;
+    default:
+        break; // nothing outstanding: stray frame
+    }
+}
+
+// The connection is only watched while a command is outstanding
+static void on_readable(DoorCycleEngine* engine, DoorCycle* cycle) {
+    FrameReader* reader = &cycle->link->reader;
+    ssize_t n = frame_reader_fill(reader, cycle->fd);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        drop(engine, cycle);
+        if (cycle->reused && !cycle->redialled) {
+            cycle->redialled = 1;
+            send_command(engine, cycle);
+        } else {
+            fail(engine, cycle, "connection lost");
+        }
+        return;
+    }
+
+    char* frame;
+    while (cycle->fd != -1 && (frame = frame_reader_next(reader, NULL)) != NULL) {
+        if (cycle->sent_ns) {
+            door_link_record_rtt(cycle->link, now_ns() - cycle->sent_ns);
+            cycle->sent_ns = 0;
+        }
+        on_reply(engine, cycle, frame);
+    }
+}
+
+static void on_deadline(DoorCycleEngine* engine, DoorCycle* cycle) {
+    if (cycle->waiting) {
+        return; // fired just as the timer was cancelled: nothing is due until the link is released
+    } else if (cycle->state == CYCLE_HOLDING) {
+        start_command(engine, cycle, CYCLE_CLOSING);
+    } else {
+        fail(engine, cycle, cycle->connecting ? "connect timed out" : "no reply");
+    }
+}
+
+static DoorCycle* cycle_for(DoorCycleEngine* engine, const CycleRequest* request) {
+    if ((size_t)request->slot >= engine->cycle_capacity) {
+        size_t capacity = engine->cycle_capacity ? engine->cycle_capacity : 64;
+        while (capacity <= (size_t)request->slot) capacity *= 2;
+
+        DoorCycle** grown = realloc(engine->cycles, capacity * sizeof(DoorCycle*));
+        if (!grown) {
+            perror("Failed to grow door cycles");
+            return NULL;
+        }
+        memset(grown + engine->cycle_capacity, 0, (capacity - engine->cycle_capacity) * sizeof(DoorCycle*));
+        engine->cycles = grown;
+        engine->cycle_capacity = capacity;
+    }
+
+    DoorCycle* cycle = engine->cycles[request->slot];
+    if (!cycle) {
+        cycle = calloc(1, sizeof(DoorCycle));
+        if (!cycle) {
+            perror("Failed to allocate door cycle");
+            return NULL;
+        }
+        cycle->fd = -1;
+        cycle->slot = request->slot;
+        cycle->engine = engine;
+        cycle->link = request->link;
+        timer_init(&cycle->timer, cycle_timer_fired, cycle);
+        engine->cycles[request->slot] = cycle;
+    }
+    return cycle;
+}
+
+static void handle_request(DoorCycleEngine* engine, const CycleRequest* request) {
+    if (request->kind == CYCLE_DEADLINE) {
+        DoorCycle* cycle = engine->cycles[request->slot];
+        // A timer that fired just before being re-armed is stale: the deadline has moved on
+        if (cycle->state != CYCLE_IDLE && cycle->deadline_ns <= now_ns()) {
+            on_deadline(engine, cycle);
+        }
+        return;
+    }
+    if (request->kind == CYCLE_LINK_FREE) {
+        DoorCycle* cycle = engine->cycles[request->slot];
+        if (cycle->waiting) {
+            start_command(engine, cycle, cycle->state);
+        }
+        return;
+    }
+
+    DoorCycle* cycle = cycle_for(engine, request);
+    if (!cycle) {
+        atomic_fetch_add(&engine->failed, 1);
+        return;
+    }
+
+    switch (cycle->state) {
+    case CYCLE_IDLE:
+        cycle->open_scan_ns = cycle->last_scan_ns = request->scanned_ns;
+
+        atomic_fetch_add(&engine->started, 1);
+        update_max(&engine->peak_active, atomic_fetch_add(&engine->active, 1) + 1);
+        start_command(engine, cycle, CYCLE_OPENING);
+        break;
+    case CYCLE_OPENING:
+        // The hold starts once the door reports OPENED, which already covers this scan
+        cycle->last_scan_ns = request->scanned_ns;
+        atomic_fetch_add(&engine->extended, 1);
+        break;
+    case CYCLE_HOLDING:
+        set_deadline(engine, cycle, engine->hold_ns); // O(1) move on the wheel
+        cycle->last_scan_ns = request->scanned_ns;
+        atomic_fetch_add(&engine->extended, 1);
+        break;
+    case CYCLE_CLOSING:
+        cycle->reopen = 1;
+        cycle->last_scan_ns = request->scanned_ns;
+        break;
+    }
+}
+
+static void take_pending(DoorCycleEngine* engine) {
+    uint64_t count;
+    if (read(engine->wake_fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        perror("eventfd read failed");
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    size_t pending_count = engine->pending_count;
+    CycleRequest* pending = engine->pending;
+    engine->pending = NULL;
+    engine->pending_count = 0;
+    engine->pending_capacity = 0;
+    pthread_mutex_unlock(&engine->lock);
+
+    for (size_t i = 0; i < pending_count; i++) {
+        handle_request(engine, &pending[i]);
+    }
+    free(pending);
+}
+
+static void* engine_thread(void* arg) {
+    DoorCycleEngine* engine = arg;
+    struct epoll_event events[CYCLE_MAX_EVENTS];
+
+    while (!atomic_load(&engine->stop)) {
+        int ready = epoll_wait(engine->epoll_fd, events, CYCLE_MAX_EVENTS, -1);
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            DoorCycle* cycle = events[i].data.ptr;
+            if (cycle == NULL) {
+                take_pending(engine);
+            } else if (cycle->fd == -1) {
+                continue; // closed earlier in this batch
+            } else if (cycle->connecting) {
+                connected(engine, cycle);
+            } else {
+                on_readable(engine, cycle);
+            }
+        }
+    }
+    return NULL;
+}
+
+DoorCycleEngine* door_cycle_engine_create(unsigned int hold_us, TimerWheel* wheel) {
+    DoorCycleEngine* engine = calloc(1, sizeof(DoorCycleEngine));
+    if (!engine) {
+        perror("Failed to allocate door cycle engine");
+        return NULL;
+    }
+    pthread_mutex_init(&engine->lock, NULL);
+    engine->wheel = wheel;
+    engine->hold_ns = (uint64_t)hold_us * 1000;
+
+    engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    engine->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (engine->epoll_fd == -1 || engine->wake_fd == -1 ||
+        epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, engine->wake_fd, &event) == -1) {
+        perror("Failed to set up door cycle engine");
+        door_cycle_engine_destroy(engine);
+        return NULL;
+    }
+
+    if (pthread_create(&engine->thread, NULL, engine_thread, engine) != 0) {
+        perror("Failed to start door cycle engine");
+        door_cycle_engine_destroy(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+int door_cycle_request(DoorCycleEngine* engine, int slot, DoorLink* link, const struct timespec* scanned_at) {
+    if (slot < 0 || !link) return -1;
+
+    CycleRequest request = { .kind = CYCLE_SCAN, .slot = slot, .link = link };
+    if (scanned_at) {
+        request.scanned_ns = (uint64_t)scanned_at->tv_sec * 1000000000ULL + scanned_at->tv_nsec;
+    }
+    if (post(engine, &request) == -1) {
+        return -1;
+    }
+    atomic_fetch_add(&engine->requested, 1);
+    return 0;
+}
+
+void door_cycle_print_stats(DoorCycleEngine* engine) {
+    printf("Door cycles:\n");
+    printf("  requests: %lu, cycles started: %lu, extended: %lu, reopened: %lu\n",
+           atomic_load(&engine->requested), atomic_load(&engine->started),
+           atomic_load(&engine->extended), atomic_load(&engine->reopened));
+    printf("  completed: %lu, refused by door: %lu, failed: %lu\n",
+           atomic_load(&engine->completed), atomic_load(&engine->refused), atomic_load(&engine->failed));
+    printf("  in progress: %lu, peak in progress: %lu\n",
+           atomic_load(&engine->active), atomic_load(&engine->peak_active));
+}
+
+void door_cycle_engine_destroy(DoorCycleEngine* engine) {
+    if (engine->thread) {
+        atomic_store(&engine->stop, 1);
+        uint64_t one = 1;
+        if (write(engine->wake_fd, &one, sizeof(one)) == -1) {
+            perror("eventfd write failed");
+        }
+        pthread_join(engine->thread, NULL);
+    }
+
+    for (size_t i = 0; i < engine->cycle_capacity; i++) {
+        if (engine->cycles[i]) {
+            timer_cancel_sync(engine->wheel, &engine->cycles[i]->timer);
+            door_link_cancel_release_callback(engine->cycles[i]->link, engine->cycles[i]);
+            release(engine, engine->cycles[i], 0);
+            free(engine->cycles[i]);
+        }
+    }
+    if (engine->epoll_fd != -1) close(engine->epoll_fd);
+    if (engine->wake_fd != -1) close(engine->wake_fd);
+    free(engine->cycles);
+    free(engine->pending);
+    pthread_mutex_destroy(&engine->lock);
+    free(engine);
+}
@@ -0,0 +1,117 @@
+#ifndef DOORCYCLE_H
+#define DOORCYCLE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "doorpool.h"
+#include "timerwheel.h"
+
+typedef enum {
+    CYCLE_IDLE,    // door closed (or left alone), its link's connection kept open for the next cycle
+    CYCLE_OPENING, // OPEN# sent (or waiting for the link or to connect), expecting OPENED#
+    CYCLE_HOLDING, // door open, CLOSE# goes out when the hold timer expires
+    CYCLE_CLOSING  // CLOSE# sent (or waiting for the link or to connect), expecting CLOSED#
+} CycleState;
+
+/*
+ * One door's open -> hold -> close cycle, driven entirely by socket
+ * readiness and deadlines on the engine thread. Each command borrows the
+ * door's DoorLink, so cycles and manual commands share one connection and
+ * one dial/backoff policy; the link is given back as soon as the door
+ * answers, and is free for other commands while the door is held open.
+ */
+typedef struct {
+    int slot;
+    struct DoorCycleEngine* engine;
+    DoorLink* link; // never freed
+
+    int fd;         // the link's connection while watched for the outstanding command, -1 otherwise
+    int connecting; // non-blocking connect in progress
+    int owned;      // the link is held for the outstanding command
+    int waiting;    // a manual command has the link: try again when it is released
+    int reused;     // the outstanding command went out on an already open connection
+    int redialled;  // a fresh connection was already tried for the outstanding command
+    int reopen;     // scanned again while closing: open again once closed
+    uint64_t sent_ns; // when the command was written, 0 once its first reply is in
+
+    CycleState state;
+    uint64_t deadline_ns; // connect/reply timeout, or end of the hold while CYCLE_HOLDING
+    Timer timer;          // wakes the engine at deadline_ns
+
+    uint64_t open_scan_ns; // when the scan behind the current open was read (0 if unknown)
+    uint64_t last_scan_ns; // when the latest scan of the cycle was read; the close follows it
+} DoorCycle;
+
+typedef enum {
+    CYCLE_SCAN,    // a card was accepted at the door
+    CYCLE_DEADLINE, // the cycle's timer fired
+    CYCLE_LINK_FREE // the link the cycle is waiting for was released
+} CycleRequestKind;
+
+typedef struct {
+    CycleRequestKind kind;
+    int slot; // the door's interned registry ID
+    DoorLink* link;
+    uint64_t scanned_ns; // CLOCK_MONOTONIC time the scan was read, for the latency histograms
+} CycleRequest;
+
+/*
+ * Runs every door's open/close cycle on one thread. Scan workers hand
+ * requests over through a mutex-protected list and an eventfd, and
+ * return at once instead of sleeping through the open interval. Timeouts
+ * and holds are timers on the process's timer wheel, whose callbacks
+ * post back through the same list, as does a door link released by a
+ * manual command a cycle is waiting on.
+ */
+typedef struct DoorCycleEngine {
+    TimerWheel* wheel;
+    int epoll_fd;
+    int wake_fd;
+    pthread_t thread;
+    atomic_int stop;
+    uint64_t hold_ns;
+
+    pthread_mutex_t lock; // guards the pending list
+    CycleRequest* pending;
+    size_t pending_count;
+    size_t pending_capacity;
+
+    DoorCycle** cycles; // indexed by slot, owned by the engine thread
+    size_t cycle_capacity;
+
+    atomic_ulong requested;
+    atomic_ulong started;
+    atomic_ulong extended;  // scans that only pushed out the close of a cycle in progress
+    atomic_ulong reopened;
+    atomic_ulong completed;
+    atomic_ulong refused;   // door answered OPEN# with something other than OPENED#
+    atomic_ulong failed;
+    atomic_ulong active;
+    atomic_ulong peak_active;
+} DoorCycleEngine;
+
+/**
+ * Start the engine thread.
+ * @param hold_us How long a door stays open after OPENED#, in microseconds.
+ * @param wheel The timer wheel driving hold and reply timeouts; must outlive the engine.
+ * @return The engine, or NULL on failure.
+ */
+DoorCycleEngine* door_cycle_engine_create(unsigned int hold_us, TimerWheel* wheel);
+
+/**
+ * Ask for a door to be opened and closed again after the hold time.
+ * A door that is already open has its hold extended; a door that is
+ * closing opens again once it has closed.
+ * @param slot The door's interned registry ID.
+ * @param link The door's link, which must outlive the engine.
+ * @param scanned_at When the scan was read, or NULL; door OPENED and CLOSE sent latencies are measured from it.
+ * @return 0 if the request was queued, -1 otherwise.
+ */
+int door_cycle_request(DoorCycleEngine* engine, int slot, DoorLink* link, const struct timespec* scanned_at);
+
+void door_cycle_print_stats(DoorCycleEngine* engine);
+
+void door_cycle_engine_destroy(DoorCycleEngine* engine);
+
+#endif // DOORCYCLE_H
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "doorpool.h"
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static uint64_t timespec_ns(const struct timespec* ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void disconnect(DoorLink* link) {
+    if (link->fd != -1) {
+        close(link->fd);
+        link->fd = -1;
+    }
+    frame_reader_init(&link->reader);
+}
+
+static void back_off(DoorLink* link) {
+    uint64_t next = now_ns() + (uint64_t)link->backoff_us * 1000;
+    link->next_attempt.tv_sec = next / 1000000000ULL;
+    link->next_attempt.tv_nsec = next % 1000000000ULL;
+
+    link->backoff_us = link->backoff_us ? link->backoff_us * 2 : DOOR_BACKOFF_MIN_US;
+    if (link->backoff_us > DOOR_BACKOFF_MAX_US) {
+        link->backoff_us = DOOR_BACKOFF_MAX_US;
+    }
+}
+
+// Start a non-blocking connect; *in_progress is set if it has not completed yet
+static int begin_dial(DoorLink* link, int* in_progress) {
+    struct sockaddr_in door_address;
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd == -1) {
+        perror("Could not create socket");
+        return -1;
+    }
+
+    memset(&door_address, 0, sizeof(door_address));
+    door_address.sin_family = AF_INET;
+    door_address.sin_addr.s_addr = inet_addr(link->address);
+    door_address.sin_port = htons(link->port);
+
+    *in_progress = 0;
+    if (connect(sockfd, (struct sockaddr*)&door_address, sizeof(door_address)) == -1) {
+        if (errno != EINPROGRESS) {
+            close(sockfd);
+            return -1;
+        }
+        *in_progress = 1;
+    }
+
+    int nodelay = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return sockfd;
+}
+
+static int connect_failed(int sockfd) {
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    return getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &error_len) == -1 || error != 0;
+}
+
+// Blocking connect bounded by DOOR_CONNECT_TIMEOUT_MS
+static int dial(DoorLink* link) {
+    int in_progress;
+    int sockfd = begin_dial(link, &in_progress);
+    if (sockfd == -1 || !in_progress) {
+        return sockfd;
+    }
+
+    struct pollfd pfd = { sockfd, POLLOUT, 0 };
+    if (poll(&pfd, 1, DOOR_CONNECT_TIMEOUT_MS) != 1 || connect_failed(sockfd)) {
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+// A pooled connection is healthy if the door has neither closed it nor left stray data on it
+static int is_healthy(DoorLink* link) {
+    char byte;
+    ssize_t n = recv(link->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 1;
+    }
+    return 0;
+}
+
+// 0 if the open connection can be reused, 1 if a new one may be dialled, -1 while backing off
+static int check_connection(DoorLink* link) {
+    if (link->fd != -1) {
+        if (is_healthy(link)) {
+            return 0;
+        }
+        disconnect(link);
+    }
+
+    if (now_ns() < timespec_ns(&link->next_attempt)) {
+        return -1; // still backing off from the last failure
+    }
+    return 1;
+}
+
+static void connection_up(DoorLink* link) {
+    frame_reader_init(&link->reader);
+    link->dialled = 1;
+    link->backoff_us = 0;
+}
+
+static int ensure_connected(DoorLink* link) {
+    int status = check_connection(link);
+    if (status != 1) {
+        return status;
+    }
+
+    link->fd = dial(link);
+    if (link->fd == -1) {
+        back_off(link);
+        return -1;
+    }
+    connection_up(link);
+    return 1;
+}
+
+static int is_final_reply(const char* reply) {
+    return strcmp(reply, "OPENING") != 0 && strcmp(reply, "CLOSING") != 0;
+}
+
+// Write the command and read replies until the final one; returns -1 on any I/O failure
+static int exchange(DoorLink* link, const char* command, char* reply, size_t reply_size) {
+    size_t len = strlen(command);
+    if (send(link->fd, command, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        return -1;
+    }
+
+    uint64_t sent_at = now_ns();
+    uint64_t deadline = sent_at + (uint64_t)DOOR_REPLY_TIMEOUT_MS * 1000000ULL;
+    int first = 1;
+    char* frame;
+
+    while (1) {
+        while ((frame = frame_reader_next(&link->reader, NULL)) == NULL) {
+            uint64_t now = now_ns();
+            if (now >= deadline) {
+                return -1;
+            }
+
+            struct pollfd pfd = { link->fd, POLLIN, 0 };
+            int ready = poll(&pfd, 1, (int)((deadline - now) / 1000000ULL) + 1);
+            if (ready == -1 && errno == EINTR) continue;
+            if (ready != 1) {
+                return -1;
+            }
+
+            ssize_t n = frame_reader_fill(&link->reader, link->fd);
+            if (n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return -1;
+            }
+        }
+
+        if (first) {
+            door_link_record_rtt(link, now_ns() - sent_at);
+            first = 0;
+        }
+
+        if (is_final_reply(frame)) {
+            if (reply) {
+                snprintf(reply, reply_size, "%s", frame);
+            }
+            return 0;
+        }
+    }
+}
+
+DoorLink* door_link_create(const char* id, const char* address, int port) {
+    DoorLink* link = calloc(1, sizeof(DoorLink));
+    if (!link) {
+        perror("Failed to allocate door link");
+        return NULL;
+    }
+
+    pthread_mutex_init(&link->lock, NULL);
+    pthread_cond_init(&link->released, NULL);
+    snprintf(link->id, sizeof(link->id), "%s", id);
+    snprintf(link->address, sizeof(link->address), "%s", address);
+    link->port = port;
+    link->fd = -1;
+    frame_reader_init(&link->reader);
+    return link;
+}
+
+// The lock must be held and the link free
+static void apply_address(DoorLink* link, const char* address, int port) {
+    if (strcmp(link->address, address) != 0 || link->port != port) {
+        disconnect(link);
+        snprintf(link->address, sizeof(link->address), "%s", address);
+        link->port = port;
+    }
+    // A fresh registration means the door is up, so stop backing off
+    link->backoff_us = 0;
+    memset(&link->next_attempt, 0, sizeof(link->next_attempt));
+}
+
+void door_link_set_address(DoorLink* link, const char* address, int port) {
+    pthread_mutex_lock(&link->lock);
+    if (link->busy) {
+        snprintf(link->pending_address, sizeof(link->pending_address), "%s", address);
+        link->pending_port = port;
+        link->readdressed = 1;
+    } else {
+        apply_address(link, address, port);
+    }
+    pthread_mutex_unlock(&link->lock);
+}
+
+int door_link_try_acquire(DoorLink* link, void (*on_release)(void*), void* arg) {
+    pthread_mutex_lock(&link->lock);
+    int taken = !link->busy;
+    if (!taken) {
+        link->on_release = on_release;
+        link->on_release_arg = arg;
+    }
+    link->busy = 1;
+    pthread_mutex_unlock(&link->lock);
+    return taken ? 0 : -1;
+}
+
+void door_link_cancel_release_callback(DoorLink* link, void* arg) {
+    pthread_mutex_lock(&link->lock);
+    if (link->on_release_arg == arg) {
+        link->on_release = NULL;
+        link->on_release_arg = NULL;
+    }
+    pthread_mutex_unlock(&link->lock);
+}
+
+static void acquire(DoorLink* link) {
+    pthread_mutex_lock(&link->lock);
+    while (link->busy) {
+        pthread_cond_wait(&link->released, &link->lock);
+    }
+    link->busy = 1;
+    pthread_mutex_unlock(&link->lock);
+}
+
+int door_link_connection(DoorLink* link, int* reused, int* connecting) {
+    *reused = 0;
+    *connecting = 0;
+    int status = check_connection(link);
+    if (status == 0) {
+        *reused = 1;
+        return link->fd;
+    }
+    if (status == -1) {
+        return -1;
+    }
+
+    int in_progress;
+    link->fd = begin_dial(link, &in_progress);
+    if (link->fd == -1) {
+        back_off(link);
+        return -1;
+    }
+    if (in_progress) {
+        link->connecting = 1;
+        *connecting = 1;
+    } else {
+        connection_up(link);
+    }
+    return link->fd;
+}
+
+int door_link_connected(DoorLink* link) {
+    if (connect_failed(link->fd)) {
+        return -1; // backed off and closed when the link is released
+    }
+    link->connecting = 0;
+    connection_up(link);
+    return 0;
+}
+
+void door_link_disconnect(DoorLink* link) {
+    disconnect(link);
+}
+
+void door_link_record_rtt(DoorLink* link, uint64_t rtt_ns) {
+    pthread_mutex_lock(&link->lock);
+    link->rtt_last_ns = rtt_ns;
+    link->rtt_total_ns += rtt_ns;
+    link->rtt_samples++;
+    if (rtt_ns > link->rtt_max_ns) link->rtt_max_ns = rtt_ns;
+    pthread_mutex_unlock(&link->lock);
+}
+
+void door_link_release(DoorLink* link, int answered) {
+    if (link->connecting) {
+        back_off(link); // the connect failed or timed out
+        link->connecting = 0;
+    }
+    if (!answered) {
+        disconnect(link);
+    }
+
+    pthread_mutex_lock(&link->lock);
+    link->commands++;
+    if (link->dialled) link->connects++;
+    if (answered && !link->dialled) link->reused++;
+    if (!answered) link->failures++;
+    link->dialled = 0;
+    if (link->readdressed) {
+        apply_address(link, link->pending_address, link->pending_port);
+        link->readdressed = 0;
+    }
+    link->busy = 0;
+    pthread_cond_broadcast(&link->released);
+    if (link->on_release) {
+        // Under the lock, so a cancelled callback can never run late
+        void (*on_release)(void*) = link->on_release;
+        link->on_release = NULL;
+        on_release(link->on_release_arg);
+        link->on_release_arg = NULL;
+    }
+    pthread_mutex_unlock(&link->lock);
+}
+
+int door_link_command(DoorLink* link, const char* command, char* reply, size_t reply_size) {
+    acquire(link);
+
+    int answered = 0;
+    int status = ensure_connected(link);
+    if (status == 0) {
+        answered = exchange(link, command, reply, reply_size) == 0;
+        if (!answered) {
+            // The door may have restarted since the last command: dial once more
+            disconnect(link);
+            status = ensure_connected(link);
+        }
+    }
+    if (status == 1) {
+        answered = exchange(link, command, reply, reply_size) == 0;
+    }
+
+    if (!answered) {
+        fprintf(stderr, "Door %s at %s:%d did not answer %s\n", link->id, link->address, link->port, command);
+    }
+    door_link_release(link, answered);
+    return answered ? 0 : -1;
+}
+
+void door_link_print_stats(DoorLink* link) {
+    pthread_mutex_lock(&link->lock);
+    printf("%s\t%s\t%lu\t%lu\t%lu\t%.2f\t%lu\t%.1f\t%.1f\t%.1f\n",
+           link->id, link->busy ? "busy" : link->fd != -1 ? "up" : "down",
+           link->commands, link->connects, link->failures,
+           link->commands ? (double)link->reused / link->commands : 0.0,
+           link->rtt_samples,
+           link->rtt_last_ns / 1000.0,
+           link->rtt_samples ? link->rtt_total_ns / 1000.0 / link->rtt_samples : 0.0,
+           link->rtt_max_ns / 1000.0);
+    pthread_mutex_unlock(&link->lock);
+}
+
+void door_link_destroy(DoorLink* link) {
+    disconnect(link);
+    pthread_cond_destroy(&link->released);
+    pthread_mutex_destroy(&link->lock);
+    free(link);
+}
@@ -0,0 +1,133 @@
+#ifndef DOORPOOL_H
+#define DOORPOOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "frame.h"
+
+#define DOOR_CONNECT_TIMEOUT_MS 1000
+#define DOOR_REPLY_TIMEOUT_MS 10000
+#define DOOR_BACKOFF_MIN_US 50000
+#define DOOR_BACKOFF_MAX_US 5000000
+#define DOOR_REPLY_SIZE 32
+
+/*
+ * Long-lived connection from the overseer to one door controller, shared
+ * by every command sent to that door.
+ *
+ * A command is one write on the open connection followed by reading the
+ * door's replies up to the final one (OPENING# then OPENED#, or ALREADY#
+ * and so on). One command owns the link at a time: door_link_command()
+ * waits its turn and blocks, while the door cycle engine takes the link
+ * only if it is free and drives the same connection without blocking,
+ * asking to be called back when the link is released if it is not. A
+ * dead connection is re-dialled with exponential backoff either way.
+ *
+ * The lock guards ownership and the counters and is never held across
+ * I/O; the connection itself belongs to the owner.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+    int busy; // a command owns the link
+    char id[50];
+    char address[50];
+    int port;
+    int readdressed;             // a re-registration came in while busy, applied on release
+    char pending_address[50];
+    int pending_port;
+    void (*on_release)(void*);   // a non-blocking owner waiting for the link, called once on release
+    void* on_release_arg;
+
+    int fd; // -1 while disconnected
+    FrameReader reader;
+    struct timespec next_attempt; // no dialling before this while backing off
+    unsigned int backoff_us;
+    int connecting; // non-blocking connect started for the owner, not yet completed
+    int dialled;    // the owner's command needed a new connection
+
+    unsigned long commands;
+    unsigned long reused;      // commands answered on an already open connection
+    unsigned long connects;
+    unsigned long failures;
+    unsigned long rtt_samples;
+    uint64_t rtt_last_ns;      // command written -> first reply
+    uint64_t rtt_total_ns;
+    uint64_t rtt_max_ns;
+} DoorLink;
+
+/**
+ * Create an idle link; nothing is dialled until the first command.
+ * @return The link, or NULL if allocation failed.
+ */
+DoorLink* door_link_create(const char* id, const char* address, int port);
+
+/**
+ * Point the link at a (possibly new) address after the door re-registers.
+ * Never waits: while a command has the link the address is kept pending
+ * and applied when the link is released. An open connection to a
+ * different address is dropped.
+ */
+void door_link_set_address(DoorLink* link, const char* address, int port);
+
+/**
+ * Send a command and wait for the door's final reply, after any command already in progress.
+ * @param link The door's link.
+ * @param command The frame to send, including its '#'.
+ * @param reply Receives the final reply without its '#' (may be NULL).
+ * @param reply_size Size of the reply buffer.
+ * @return 0 on success, -1 if the door could not be reached or did not answer.
+ */
+int door_link_command(DoorLink* link, const char* command, char* reply, size_t reply_size);
+
+/**
+ * Take the link for a command without waiting.
+ * @param on_release If another command has the link, called once with `arg`
+ *        when it is released, from the releasing thread with the link's lock
+ *        held; it must not use the link. Replaces any earlier callback. May be NULL.
+ * @return 0 if the caller now owns the link, -1 if another command has it.
+ */
+int door_link_try_acquire(DoorLink* link, void (*on_release)(void*), void* arg);
+
+/**
+ * Forget the callback door_link_try_acquire() left for `arg`, if it has not run yet.
+ */
+void door_link_cancel_release_callback(DoorLink* link, void* arg);
+
+/**
+ * The owned link's connection, dialled without blocking if it has none.
+ * @param reused Set to 1 if the connection was already open.
+ * @param connecting Set to 1 if the connect is still in progress; once the
+ *        socket is writable, door_link_connected() finishes it.
+ * @return The socket, or -1 if it could not be dialled or the link is backing off.
+ */
+int door_link_connection(DoorLink* link, int* reused, int* connecting);
+
+/**
+ * @return 0 if the connect started by door_link_connection() succeeded, -1 otherwise.
+ */
+int door_link_connected(DoorLink* link);
+
+/**
+ * Close the owned link's connection, so the next door_link_connection() dials afresh.
+ */
+void door_link_disconnect(DoorLink* link);
+
+/**
+ * @param rtt_ns Time from writing a command to its first reply.
+ */
+void door_link_record_rtt(DoorLink* link, uint64_t rtt_ns);
+
+/**
+ * Give the link back once its command is over.
+ * @param answered 1 if the door gave its final reply, 0 if the command failed
+ *        (the connection is closed).
+ */
+void door_link_release(DoorLink* link, int answered);
+
+void door_link_print_stats(DoorLink* link);
+
+void door_link_destroy(DoorLink* link);
+
+#endif // DOORPOOL_H
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "doorset.h"
+
+#define DOORSET_INITIAL_CAPACITY 64
+
+static uint64_t mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static size_t hash_door(struct in_addr addr, in_port_t port) {
+    uint64_t key = ((uint64_t)addr.s_addr << 16) ^ port;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+// Fields rather than raw bytes, so the padding in an entry never matters
+static uint64_t entry_checksum(size_t position, const DoorSetEntry* entry) {
+    return mix(((uint64_t)entry->addr.s_addr << 16 | entry->port) ^ (position + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+static uint16_t entry_check(size_t position, const DoorSetEntry* entry) {
+    return (uint16_t)(entry_checksum(position, entry) >> 48);
+}
+
+static uint64_t file_checksum(const DoorSetFileHeader* header, uint64_t entries_checksum) {
+    uint64_t sum = mix(header->format ^ mix(header->capacity ^ mix(header->count ^ mix(header->sync_epoch ^ mix(header->sync_version)))));
+    return sum + entries_checksum;
+}
+
+static void seal(DoorSet* set) {
+    set->file->checksum = file_checksum(set->file, set->entries_checksum);
+}
+
+int doorset_init(DoorSet* set) {
+    memset(set, 0, sizeof(*set));
+    set->fd = -1;
+    set->entries = malloc(DOORSET_INITIAL_CAPACITY * sizeof(DoorSetEntry));
+    set->index = calloc(DOORSET_INITIAL_CAPACITY * 2, sizeof(uint32_t));
+    if (!set->entries || !set->index) {
+        perror("Failed to allocate door set");
+        doorset_free(set);
+        return -1;
+    }
+    set->capacity = DOORSET_INITIAL_CAPACITY;
+    set->index_mask = DOORSET_INITIAL_CAPACITY * 2 - 1;
+    return 0;
+}
+
+void doorset_free(DoorSet* set) {
+    if (set->file) {
+        munmap(set->file, set->map_size);
+    } else {
+        free(set->entries);
+    }
+    if (set->fd != -1) {
+        close(set->fd);
+    }
+    free(set->index);
+    memset(set, 0, sizeof(*set));
+    set->fd = -1;
+}
+
+static size_t file_size_for(size_t capacity) {
+    return sizeof(DoorSetFileHeader) + capacity * sizeof(DoorSetEntry);
+}
+
+static int map_file(DoorSet* set, size_t size) {
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, set->fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    set->file = map;
+    set->map_size = size;
+    set->entries = (DoorSetEntry*)(set->file + 1);
+    return 0;
+}
+
+// A header that could be this format at all; anything else is a foreign file
+static int header_usable(const DoorSetFileHeader* header, size_t file_size) {
+    return file_size >= sizeof(DoorSetFileHeader) && memcmp(header->magic, "DSET", 4) == 0 &&
+           header->format == DOORSET_FILE_FORMAT && header->capacity != 0 &&
+           header->capacity <= (file_size - sizeof(DoorSetFileHeader)) / sizeof(DoorSetEntry);
+}
+
+// Entries from the first on that pass their own checks, up to `limit`
+static size_t checked_prefix(const DoorSetFileHeader* header, size_t limit) {
+    const DoorSetEntry* entries = (const DoorSetEntry*)(header + 1);
+    size_t count = 0;
+    while (count < limit && (entries[count].addr.s_addr != 0 || entries[count].port != 0) &&
+           entries[count].check == entry_check(count, &entries[count])) {
+        count++;
+    }
+    return count;
+}
+
+static uint64_t sum_entries(const DoorSetEntry* entries, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += entry_checksum(i, &entries[i]);
+    }
+    return sum;
+}
+
+static void index_entries(DoorSet* set) {
+    for (size_t i = 0; i < set->count; i++) {
+        size_t slot = hash_door(set->entries[i].addr, set->entries[i].port) & set->index_mask;
+        while (set->index[slot]) slot = (slot + 1) & set->index_mask;
+        set->index[slot] = (uint32_t)(i + 1);
+    }
+}
+
+int doorset_open(DoorSet* set, const char* path) {
+    memset(set, 0, sizeof(*set));
+    set->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (set->fd == -1) {
+        perror("Failed to open door set file");
+        return -1;
+    }
+
+    struct stat file_stat;
+    if (fstat(set->fd, &file_stat) == -1) {
+        perror("Failed to stat door set file");
+        doorset_free(set);
+        return -1;
+    }
+
+    int valid = 0;
+    if ((size_t)file_stat.st_size >= sizeof(DoorSetFileHeader)) {
+        if (map_file(set, file_stat.st_size) == -1) {
+            perror("Failed to map door set file");
+            doorset_free(set);
+            return -1;
+        }
+        DoorSetFileHeader* header = set->file;
+        valid = header_usable(header, file_stat.st_size);
+        if (valid && header->count <= header->capacity) {
+            set->entries_checksum = sum_entries(set->entries, header->count);
+        }
+        if (!valid) {
+            fprintf(stderr, "Door set file %s is not a door set, starting empty\n", path);
+            munmap(set->file, set->map_size);
+            set->file = NULL;
+        } else if (header->count > header->capacity || file_checksum(header, set->entries_checksum) != header->checksum) {
+            // Torn: the count and sync can no longer be trusted, the checked entries can
+            size_t kept = checked_prefix(header, header->capacity);
+            fprintf(stderr, "Door set file %s failed validation, keeping the first %zu doors\n", path, kept);
+            header->count = kept;
+            header->sync_epoch = 0;
+            header->sync_version = 0;
+            set->entries_checksum = sum_entries(set->entries, kept);
+            seal(set);
+        }
+    }
+
+    if (!valid) {
+        size_t size = file_size_for(DOORSET_INITIAL_CAPACITY);
+        if (ftruncate(set->fd, size) == -1 || map_file(set, size) == -1) {
+            perror("Failed to set up door set file");
+            doorset_free(set);
+            return -1;
+        }
+        memset(set->file, 0, sizeof(DoorSetFileHeader));
+        memcpy(set->file->magic, "DSET", 4);
+        set->file->format = DOORSET_FILE_FORMAT;
+        set->file->capacity = DOORSET_INITIAL_CAPACITY;
+        set->entries_checksum = 0;
+        seal(set);
+    }
+
+    set->count = set->file->count;
+    set->capacity = set->file->capacity;
+    set->index_mask = set->capacity * 2 - 1;
+    set->index = calloc(set->capacity * 2, sizeof(uint32_t));
+    if (!set->index) {
+        perror("Failed to allocate door set index");
+        doorset_free(set);
+        return -1;
+    }
+    index_entries(set);
+    return valid;
+}
+
+long doorset_find(const DoorSet* set, struct in_addr addr, in_port_t port) {
+    for (size_t slot = hash_door(addr, port) & set->index_mask; set->index[slot]; slot = (slot + 1) & set->index_mask) {
+        const DoorSetEntry* entry = &set->entries[set->index[slot] - 1];
+        if (entry->addr.s_addr == addr.s_addr && entry->port == port) {
+            return set->index[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+static int grow_entries(DoorSet* set, size_t capacity) {
+    if (!set->file) {
+        DoorSetEntry* entries = realloc(set->entries, capacity * sizeof(DoorSetEntry));
+        if (!entries) {
+            return -1;
+        }
+        set->entries = entries;
+        return 0;
+    }
+
+    // The entries keep their offset, so growing the file and mapping it again keeps them in place
+    size_t size = file_size_for(capacity);
+    if (ftruncate(set->fd, size) == -1) {
+        return -1;
+    }
+    DoorSetFileHeader* old_file = set->file;
+    size_t old_size = set->map_size;
+    if (map_file(set, size) == -1) {
+        return -1; // the old mapping is still in place
+    }
+    munmap(old_file, old_size);
+    set->file->capacity = capacity;
+    seal(set);
+    return 0;
+}
+
+// Double the entries and rebuild the index at twice the entry capacity
+static int grow(DoorSet* set) {
+    size_t capacity = set->capacity * 2;
+    uint32_t* index = calloc(capacity * 2, sizeof(uint32_t));
+    if (!index || grow_entries(set, capacity) == -1) {
+        free(index);
+        return -1;
+    }
+
+    free(set->index);
+    set->index = index;
+    set->index_mask = capacity * 2 - 1;
+    set->capacity = capacity;
+    index_entries(set);
+    return 0;
+}
+
+int doorset_add(DoorSet* set, struct in_addr addr, in_port_t port) {
+    if (doorset_find(set, addr, port) != -1) {
+        return 0;
+    }
+    if (set->count == set->capacity && grow(set) == -1) {
+        perror("Failed to grow door set");
+        return -1;
+    }
+
+    size_t slot = hash_door(addr, port) & set->index_mask;
+    while (set->index[slot]) slot = (slot + 1) & set->index_mask;
+    DoorSetEntry* entry = &set->entries[set->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->addr = addr;
+    entry->port = port;
+    set->index[slot] = (uint32_t)(set->count + 1);
+
+    if (set->file) {
+        // The entry is in place before the header counts it
+        entry->check = entry_check(set->count, entry);
+        set->entries_checksum += entry_checksum(set->count, entry);
+        set->file->count = set->count + 1;
+        seal(set);
+    }
+    set->count++;
+    return 1;
+}
+
+size_t doorset_count(const DoorSet* set) {
+    return set->count;
+}
+
+const DoorSetEntry* doorset_at(const DoorSet* set, size_t position) {
+    return position < set->count ? &set->entries[position] : NULL;
+}
+
+void doorset_set_sync(DoorSet* set, uint64_t epoch, uint64_t version) {
+    if (set->file) {
+        set->file->sync_epoch = epoch;
+        set->file->sync_version = version;
+        seal(set);
+    }
+}
+
+void doorset_get_sync(const DoorSet* set, uint64_t* epoch, uint64_t* version) {
+    *epoch = set->file ? set->file->sync_epoch : 0;
+    *version = set->file ? set->file->sync_version : 0;
+}
@@ -0,0 +1,115 @@
+#ifndef DOORSET_H
+#define DOORSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+typedef struct {
+    struct in_addr addr;
+    in_port_t port; // host order, as carried in DOOR datagrams
+    uint16_t check; // set opened from a file: check over the entry and its position, 0 otherwise
+} DoorSetEntry;
+
+#define DOORSET_FILE_FORMAT 2
+
+/*
+ * Header of a door set kept in a file. The entries follow it directly;
+ * the hash index is rebuilt in memory on load. The checksum covers the
+ * header fields and every entry up to `count`. When it does not match,
+ * each entry's own check still vouches for it, so a torn write only
+ * costs the entries from the first bad one on; a foreign file is
+ * rejected rather than trusted.
+ */
+typedef struct {
+    char magic[4]; // {'D', 'S', 'E', 'T'}
+    uint32_t format;
+    uint64_t capacity;     // entries the file has room for
+    uint64_t count;        // entries in use; written after the entry itself
+    uint64_t sync_epoch;   // overseer door set epoch last confirmed by DVER, 0 if none
+    uint64_t sync_version; // overseer door set version held for that epoch
+    uint64_t checksum;
+    uint64_t reserved;
+} DoorSetFileHeader;
+
+/*
+ * Set of doors known by address/port, kept in the order they were added.
+ * The order doubles as the change log: the door at position i was added
+ * in version i + 1, so the set's version is its size and the changes
+ * since version v are the entries from position v on.
+ *
+ * Entries are found through an open-addressing table of positions rather
+ * than pointers, so the whole set can be copied or mapped as plain data.
+ * Doors are never removed; the fire alarm has no way to forget one.
+ */
+typedef struct {
+    DoorSetEntry* entries;
+    uint32_t* index; // entry position + 1, 0 for an empty slot
+    size_t count;
+    size_t capacity;
+    size_t index_mask;
+
+    // Only for a set opened from a file: the entries then live in the mapping
+    int fd;                     // -1 for an in-memory set
+    DoorSetFileHeader* file;    // start of the mapping
+    size_t map_size;
+    uint64_t entries_checksum;  // running sum over the entries, so an add updates the checksum in O(1)
+} DoorSet;
+
+/*
+ * DVER: the overseer tells a fire alarm that it holds every door up to
+ * `version` of the overseer's door set `epoch`. The fire alarm sends
+ * both back in its HELLO, and the overseer only announces the doors
+ * added since.
+ */
+typedef struct {
+    char header[4]; // {'D', 'V', 'E', 'R'}
+    uint32_t reserved;
+    uint64_t epoch;
+    uint64_t version;
+} DoorSetVersion;
+
+int doorset_init(DoorSet* set);
+
+/**
+ * Open a door set kept in a file, mapped read-write so every add is
+ * persisted as it happens. An existing file is validated against its
+ * checksum and kept. A torn one keeps the longest run of entries that
+ * pass their checks, from the first on, and forgets its overseer sync so
+ * every door is announced again. A missing or foreign one is started afresh.
+ * @return 1 if doors were loaded from the file, 0 if it was started empty, -1 on failure.
+ */
+int doorset_open(DoorSet* set, const char* path);
+
+void doorset_free(DoorSet* set);
+
+/**
+ * Add a door unless it is already in the set.
+ * @return 1 if added (the set's version moves on by one), 0 if already present, -1 on allocation failure.
+ */
+int doorset_add(DoorSet* set, struct in_addr addr, in_port_t port);
+
+/**
+ * @return The door's position (its version minus one), or -1 if it is not in the set.
+ */
+long doorset_find(const DoorSet* set, struct in_addr addr, in_port_t port);
+
+/**
+ * @return The number of doors, which is also the set's version.
+ */
+size_t doorset_count(const DoorSet* set);
+
+const DoorSetEntry* doorset_at(const DoorSet* set, size_t position);
+
+/**
+ * Record the overseer's door set version the set now matches. Persisted
+ * for a set opened from a file; ignored for an in-memory one.
+ */
+void doorset_set_sync(DoorSet* set, uint64_t epoch, uint64_t version);
+
+/**
+ * The overseer's door set version last recorded with doorset_set_sync(), 0/0 if none.
+ */
+void doorset_get_sync(const DoorSet* set, uint64_t* epoch, uint64_t* version);
+
+#endif // DOORSET_H
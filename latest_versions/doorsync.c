@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "doorsync.h"
+
+#define SYNC_INITIAL_BUCKETS 256
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static size_t hash_key(const struct sockaddr_in* alarm, const DoorDatagram* datagram) {
+    uint64_t key = ((uint64_t)alarm->sin_addr.s_addr << 32) ^ ((uint64_t)alarm->sin_port << 48) ^
+                   datagram->door_addr.s_addr ^ ((uint64_t)datagram->door_port << 16);
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+static int same_door(const SyncEntry* entry, const struct sockaddr_in* alarm, const DoorDatagram* datagram) {
+    return entry->fire_alarm.sin_addr.s_addr == alarm->sin_addr.s_addr &&
+           entry->fire_alarm.sin_port == alarm->sin_port &&
+           entry->datagram.door_addr.s_addr == datagram->door_addr.s_addr &&
+           entry->datagram.door_port == datagram->door_port;
+}
+
+static void queue_push(SyncQueue* queue, SyncEntry* entry) {
+    entry->next = NULL;
+    entry->prev = queue->tail;
+    if (queue->tail) queue->tail->next = entry; else queue->head = entry;
+    queue->tail = entry;
+    queue->count++;
+}
+
+static void queue_remove(SyncQueue* queue, SyncEntry* entry) {
+    if (entry->prev) entry->prev->next = entry->next; else queue->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else queue->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+    queue->count--;
+}
+
+static int grow_buckets(DoorSync* sync) {
+    size_t count = (sync->bucket_mask + 1) * 2;
+    SyncEntry** buckets = calloc(count, sizeof(SyncEntry*));
+    if (!buckets) {
+        return -1;
+    }
+    for (size_t i = 0; i <= sync->bucket_mask; i++) {
+        SyncEntry* entry = sync->buckets[i];
+        while (entry) {
+            SyncEntry* next = entry->hash_next;
+            size_t bucket = hash_key(&entry->fire_alarm, &entry->datagram) & (count - 1);
+            entry->hash_next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(sync->buckets);
+    sync->buckets = buckets;
+    sync->bucket_mask = count - 1;
+    return 0;
+}
+
+static void unhash(DoorSync* sync, SyncEntry* entry) {
+    SyncEntry** link = &sync->buckets[hash_key(&entry->fire_alarm, &entry->datagram) & sync->bucket_mask];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    sync->entries--;
+}
+
+static void send_datagram(DoorSync* sync, SyncEntry* entry, uint64_t now) {
+    // A full socket buffer is no different from a lost datagram: the resend covers both
+    if (sendto(sync->sockfd, &entry->datagram, sizeof(entry->datagram), 0,
+               (struct sockaddr*)&entry->fire_alarm, sizeof(entry->fire_alarm)) == -1 && errno != EAGAIN) {
+        perror("DOOR datagram send failed");
+    }
+    if (entry->sends++ == 0) sync->sent++; else sync->resent++;
+    entry->resend_ns = now + sync->resend_ns;
+}
+
+// Fill the window from the waiting queue and arm the timer for the oldest datagram in flight
+static void pump(DoorSync* sync, uint64_t now) {
+    while (sync->in_flight.count < sync->window && sync->waiting.head) {
+        SyncEntry* entry = sync->waiting.head;
+        queue_remove(&sync->waiting, entry);
+        send_datagram(sync, entry, now);
+        queue_push(&sync->in_flight, entry);
+    }
+    if (sync->in_flight.count > sync->peak_in_flight) {
+        sync->peak_in_flight = sync->in_flight.count;
+    }
+
+    if (sync->in_flight.head && !sync->stopping) {
+        uint64_t due = sync->in_flight.head->resend_ns;
+        timer_arm(sync->wheel, &sync->timer, due > now ? (due - now + 999) / 1000 : 0, 0);
+    }
+}
+
+// Runs on the timer thread: resend whatever has gone unconfirmed for a full resend delay
+static void resend_due(void* arg) {
+    DoorSync* sync = arg;
+    uint64_t now = now_ns();
+
+    pthread_mutex_lock(&sync->lock);
+    while (sync->in_flight.head && sync->in_flight.head->resend_ns <= now) {
+        SyncEntry* entry = sync->in_flight.head;
+        queue_remove(&sync->in_flight, entry);
+        if (entry->sends >= sync->attempts) {
+            char address[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &entry->datagram.door_addr, address, sizeof(address));
+            printf("Failed to get confirmation for door at %s:%d after %d attempts.\n",
+                   address, entry->datagram.door_port, entry->sends);
+            sync->given_up++;
+            if (sync->on_result) sync->on_result(sync->result_arg, &entry->fire_alarm, &entry->datagram, 0);
+            unhash(sync, entry);
+            free(entry);
+            continue;
+        }
+        send_datagram(sync, entry, now);
+        queue_push(&sync->in_flight, entry);
+    }
+    pump(sync, now);
+    pthread_mutex_unlock(&sync->lock);
+}
+
+int door_sync_announce(DoorSync* sync, const struct sockaddr_in* fire_alarm, struct in_addr door_addr, in_port_t door_port) {
+    DoorDatagram datagram;
+    memcpy(datagram.header, "DOOR", 4);
+    datagram.door_addr = door_addr;
+    datagram.door_port = door_port;
+
+    pthread_mutex_lock(&sync->lock);
+    size_t hash = hash_key(fire_alarm, &datagram);
+    for (SyncEntry* entry = sync->buckets[hash & sync->bucket_mask]; entry; entry = entry->hash_next) {
+        if (same_door(entry, fire_alarm, &datagram)) {
+            sync->duplicates++;
+            pthread_mutex_unlock(&sync->lock);
+            return 0;
+        }
+    }
+
+    if (sync->entries > sync->bucket_mask && grow_buckets(sync) == -1) {
+        pthread_mutex_unlock(&sync->lock);
+        perror("Failed to grow door sync table");
+        return -1;
+    }
+    SyncEntry* entry = calloc(1, sizeof(SyncEntry));
+    if (!entry) {
+        pthread_mutex_unlock(&sync->lock);
+        perror("Failed to queue door for the fire alarm");
+        return -1;
+    }
+    entry->fire_alarm = *fire_alarm;
+    entry->datagram = datagram;
+    entry->queued_ns = now_ns();
+
+    size_t bucket = hash & sync->bucket_mask;
+    entry->hash_next = sync->buckets[bucket];
+    sync->buckets[bucket] = entry;
+    sync->entries++;
+    sync->queued++;
+
+    queue_push(&sync->waiting, entry);
+    pump(sync, entry->queued_ns);
+    pthread_mutex_unlock(&sync->lock);
+    return 1;
+}
+
+void door_sync_ack(DoorSync* sync, const struct sockaddr_in* from, const DoorDatagram* ack) {
+    pthread_mutex_lock(&sync->lock);
+    SyncEntry* entry = sync->buckets[hash_key(from, ack) & sync->bucket_mask];
+    while (entry && !same_door(entry, from, ack)) {
+        entry = entry->hash_next;
+    }
+    if (!entry) {
+        sync->stray_acks++; // late duplicate of a DREG already matched, or not ours
+        pthread_mutex_unlock(&sync->lock);
+        return;
+    }
+
+    uint64_t now = now_ns();
+    unhash(sync, entry);
+    queue_remove(entry->sends ? &sync->in_flight : &sync->waiting, entry);
+    sync->confirmed++;
+    sync->confirm_ns_total += now - entry->queued_ns;
+    if (sync->on_result) sync->on_result(sync->result_arg, &entry->fire_alarm, &entry->datagram, 1);
+    free(entry);
+
+    pump(sync, now);
+    pthread_mutex_unlock(&sync->lock);
+}
+
+static void* receive_thread(void* arg) {
+    DoorSync* sync = arg;
+    struct pollfd fds[2] = {
+        { sync->sockfd, POLLIN, 0 },
+        { sync->stop_fd, POLLIN, 0 },
+    };
+
+    while (1) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll()");
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+
+        DoorDatagram ack;
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len;
+        while ((len = recvfrom(sync->sockfd, &ack, sizeof(ack), MSG_DONTWAIT, (struct sockaddr*)&from, &from_len)) > 0) {
+            if (len == sizeof(ack) && strncmp(ack.header, "DREG", 4) == 0) {
+                door_sync_ack(sync, &from, &ack);
+            }
+            from_len = sizeof(from);
+        }
+    }
+    return NULL;
+}
+
+DoorSync* door_sync_create(TimerWheel* wheel, unsigned int resend_us, int attempts, size_t window,
+                           DoorSyncResult on_result, void* result_arg) {
+    DoorSync* sync = calloc(1, sizeof(DoorSync));
+    if (!sync) {
+        perror("Failed to allocate door sync");
+        return NULL;
+    }
+    pthread_mutex_init(&sync->lock, NULL);
+    sync->wheel = wheel;
+    sync->resend_ns = (uint64_t)resend_us * 1000;
+    sync->attempts = attempts > 0 ? attempts : 1;
+    sync->window = window > 0 ? window : DOOR_SYNC_DEFAULT_WINDOW;
+    sync->on_result = on_result;
+    sync->result_arg = result_arg;
+    timer_init(&sync->timer, resend_due, sync);
+
+    sync->buckets = calloc(SYNC_INITIAL_BUCKETS, sizeof(SyncEntry*));
+    sync->bucket_mask = SYNC_INITIAL_BUCKETS - 1;
+    sync->sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sync->stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (!sync->buckets || sync->sockfd == -1 || sync->stop_fd == -1) {
+        perror("Failed to set up door sync");
+        if (sync->sockfd != -1) close(sync->sockfd);
+        if (sync->stop_fd != -1) close(sync->stop_fd);
+        free(sync->buckets);
+        free(sync);
+        return NULL;
+    }
+
+    if (pthread_create(&sync->thread, NULL, receive_thread, sync) != 0) {
+        perror("Failed to start door sync");
+        close(sync->sockfd);
+        close(sync->stop_fd);
+        free(sync->buckets);
+        free(sync);
+        return NULL;
+    }
+    return sync;
+}
+
+size_t door_sync_pending(DoorSync* sync) {
+    pthread_mutex_lock(&sync->lock);
+    size_t pending = sync->entries;
+    pthread_mutex_unlock(&sync->lock);
+    return pending;
+}
+
+void door_sync_print_stats(DoorSync* sync) {
+    pthread_mutex_lock(&sync->lock);
+    printf("Fire alarm door sync (window %zu, %d attempts):\n", sync->window, sync->attempts);
+    printf("  doors queued: %lu (duplicates skipped: %lu), waiting: %zu, in flight: %zu, peak in flight: %lu\n",
+           sync->queued, sync->duplicates, sync->waiting.count, sync->in_flight.count, sync->peak_in_flight);
+    printf("  DOOR datagrams sent: %lu, resent: %lu\n", sync->sent, sync->resent);
+    printf("  confirmed: %lu, gave up: %lu, stray DREGs: %lu, avg queued to confirmed: %lu us\n",
+           sync->confirmed, sync->given_up, sync->stray_acks,
+           sync->confirmed ? (unsigned long)(sync->confirm_ns_total / sync->confirmed / 1000) : 0);
+    pthread_mutex_unlock(&sync->lock);
+}
+
+void door_sync_destroy(DoorSync* sync) {
+    uint64_t one = 1;
+    if (write(sync->stop_fd, &one, sizeof(one)) == -1) {
+        perror("eventfd write failed");
+    }
+    pthread_join(sync->thread, NULL);
+
+    // A resend in progress could otherwise re-arm the timer behind the cancel
+    pthread_mutex_lock(&sync->lock);
+    sync->stopping = 1;
+    pthread_mutex_unlock(&sync->lock);
+    timer_cancel_sync(sync->wheel, &sync->timer);
+
+    for (size_t i = 0; i <= sync->bucket_mask; i++) {
+        SyncEntry* entry = sync->buckets[i];
+        while (entry) {
+            SyncEntry* next = entry->hash_next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(sync->buckets);
+    close(sync->sockfd);
+    close(sync->stop_fd);
+    pthread_mutex_destroy(&sync->lock);
+    free(sync);
+}
@@ -0,0 +1,121 @@
+#ifndef DOORSYNC_H
+#define DOORSYNC_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "timerwheel.h"
+
+#define DOOR_SYNC_DEFAULT_WINDOW 64 // DOOR datagrams outstanding at once
+
+typedef struct {
+    char header[4]; // {'D', 'O', 'O', 'R'} or {'D', 'R', 'E', 'G'}
+    struct in_addr door_addr;
+    in_port_t door_port;
+} DoorDatagram;
+
+/*
+ * Told how each announced door ended: confirmed by a DREG, or given up on.
+ * Runs with the sync's lock held, so it must not call back into the sync.
+ */
+typedef void (*DoorSyncResult)(void* arg, const struct sockaddr_in* fire_alarm, const DoorDatagram* door, int confirmed);
+
+// One door announced to one fire alarm, waiting to be sent or for its DREG
+typedef struct SyncEntry {
+    struct sockaddr_in fire_alarm;
+    DoorDatagram datagram;
+    int sends;
+    uint64_t queued_ns;
+    uint64_t resend_ns; // when the DOOR datagram goes out again if still unconfirmed
+    struct SyncEntry* hash_next;
+    struct SyncEntry* prev;
+    struct SyncEntry* next;
+} SyncEntry;
+
+typedef struct {
+    SyncEntry* head;
+    SyncEntry* tail;
+    size_t count;
+} SyncQueue;
+
+/*
+ * Windowed DOOR/DREG handshake with the fire alarm units. Up to `window`
+ * DOOR datagrams are outstanding at once; the rest wait their turn in
+ * FIFO order. Unconfirmed datagrams are kept in send order, so one timer
+ * on the wheel, armed for the oldest, finds every datagram due for a
+ * resend without scanning the rest. A DREG is matched in O(1) through a
+ * hash table keyed by fire alarm address and door address/port.
+ *
+ * Callers never block: announcing only queues and sends. Confirmations
+ * arrive on the sync's own socket (fire alarms answering the sender) and
+ * through door_sync_ack() from the overseer's UDP server.
+ */
+typedef struct {
+    TimerWheel* wheel;
+    Timer timer;
+    uint64_t resend_ns;
+    int attempts;
+    size_t window;
+    int sockfd;
+    int stop_fd; // eventfd that ends the receive thread
+    pthread_t thread;
+    DoorSyncResult on_result;
+    void* result_arg;
+
+    pthread_mutex_t lock; // guards everything below
+    SyncEntry** buckets;
+    size_t bucket_mask;
+    size_t entries;
+    SyncQueue waiting;   // not sent yet, the window is full
+    SyncQueue in_flight; // sent, unconfirmed, ordered by resend_ns
+    int stopping;        // no more resends are scheduled
+
+    unsigned long queued;
+    unsigned long duplicates; // already waiting or in flight for the same fire alarm
+    unsigned long sent;
+    unsigned long resent;
+    unsigned long confirmed;
+    unsigned long stray_acks;
+    unsigned long given_up;
+    unsigned long peak_in_flight;
+    uint64_t confirm_ns_total; // queued -> DREG, over every confirmed door
+} DoorSync;
+
+/**
+ * Open the sync's socket and start its receive thread.
+ * @param wheel Timer wheel for resends; must outlive the sync.
+ * @param resend_us Time to wait for a DREG before sending the DOOR datagram again.
+ * @param attempts DOOR datagrams sent per door before giving up.
+ * @param window Most DOOR datagrams outstanding at once.
+ * @param on_result Called as each door is confirmed or given up on (may be NULL).
+ * @return The sync, or NULL on failure.
+ */
+DoorSync* door_sync_create(TimerWheel* wheel, unsigned int resend_us, int attempts, size_t window,
+                           DoorSyncResult on_result, void* result_arg);
+
+/**
+ * Queue a door for a fire alarm. Returns without waiting for the DREG.
+ * A door already queued or unconfirmed for the same fire alarm is not queued twice.
+ * @return 1 if queued, 0 if already pending (its result is reported once), -1 on failure.
+ */
+int door_sync_announce(DoorSync* sync, const struct sockaddr_in* fire_alarm, struct in_addr door_addr, in_port_t door_port);
+
+/**
+ * Match a DREG against the outstanding doors. The fire alarm confirms
+ * from the UDP port it was announced on, so the sender's address and port
+ * must both match.
+ * @param from Where the DREG came from.
+ */
+void door_sync_ack(DoorSync* sync, const struct sockaddr_in* from, const DoorDatagram* ack);
+
+/**
+ * @return Doors waiting to be sent or confirmed.
+ */
+size_t door_sync_pending(DoorSync* sync);
+
+void door_sync_print_stats(DoorSync* sync);
+
+void door_sync_destroy(DoorSync* sync);
+
+#endif // DOORSYNC_H
@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "emergency.h"
+
+#define EMERGENCY_MAX_EVENTS 64
+
+static const char emergency_command[] = "OPEN_EMERG#";
+
+uint64_t emergency_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void queue_push(EmergencyQueue* queue, EmergencyDoor* door) {
+    door->next = NULL;
+    door->prev = queue->tail;
+    if (queue->tail) queue->tail->next = door;
+    else queue->head = door;
+    queue->tail = door;
+    queue->count++;
+}
+
+static void queue_remove(EmergencyQueue* queue, EmergencyDoor* door) {
+    if (door->prev) door->prev->next = door->next;
+    else queue->head = door->next;
+    if (door->next) door->next->prev = door->prev;
+    else queue->tail = door->prev;
+    door->prev = door->next = NULL;
+    queue->count--;
+}
+
+/*
+ * Every attempt gets the same timeout and every retry the same delay, so
+ * in_flight and retrying stay ordered by deadline just by appending: the
+ * head of each is the next one due.
+ */
+typedef struct {
+    int epoll_fd;
+    uint64_t alarm_ns;
+    EmergencyQueue ready;     // waiting for a free slot
+    EmergencyQueue in_flight; // connecting or writing
+    EmergencyQueue retrying;  // waiting out the retry delay
+    EmergencyReport* report;
+} Fanout;
+
+static void end_attempt(Fanout* fanout, EmergencyDoor* door) {
+    queue_remove(&fanout->in_flight, door);
+    close(door->fd); // also removes it from the epoll set
+    door->fd = -1;
+}
+
+static void attempt_failed(Fanout* fanout, EmergencyDoor* door, uint64_t now) {
+    if (door->fd != -1) {
+        end_attempt(fanout, door);
+    }
+    if (door->attempts < EMERGENCY_ATTEMPTS) {
+        door->deadline_ns = now + (uint64_t)EMERGENCY_RETRY_DELAY_MS * 1000000ULL;
+        queue_push(&fanout->retrying, door);
+        return;
+    }
+
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &door->addr, address, sizeof(address));
+    fprintf(stderr, "Could not command door at %s:%d after %d attempts\n", address, door->port, door->attempts);
+    fanout->report->failed++;
+    fanout->report->finished_ns = now - fanout->alarm_ns;
+}
+
+static void commanded(Fanout* fanout, EmergencyDoor* door, uint64_t now) {
+    end_attempt(fanout, door);
+    EmergencyReport* report = fanout->report;
+    if (report->commanded++ == 0) {
+        report->first_ns = now - fanout->alarm_ns;
+    }
+    report->last_ns = report->finished_ns = now - fanout->alarm_ns;
+}
+
+// Write what is left of OPEN_EMERG#; the door is commanded once all of it is handed over
+static void write_command(Fanout* fanout, EmergencyDoor* door, uint64_t now) {
+    size_t len = sizeof(emergency_command) - 1;
+    while (door->sent < len) {
+        ssize_t written = send(door->fd, emergency_command + door->sent, len - door->sent, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return; // EPOLLOUT again when there is room
+            }
+            fanout->report->errors++;
+            attempt_failed(fanout, door, now);
+            return;
+        }
+        door->sent += written;
+    }
+    commanded(fanout, door, now);
+}
+
+static void start_attempt(Fanout* fanout, EmergencyDoor* door, uint64_t now) {
+    door->attempts++;
+    door->sent = 0;
+    fanout->report->attempts++;
+
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd == -1) {
+        perror("Cannot create TCP socket");
+        fanout->report->errors++;
+        attempt_failed(fanout, door, now);
+        return;
+    }
+
+    struct sockaddr_in door_address;
+    memset(&door_address, 0, sizeof(door_address));
+    door_address.sin_family = AF_INET;
+    door_address.sin_port = htons(door->port);
+    door_address.sin_addr = door->addr;
+
+    int nodelay = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    int result = connect(sockfd, (struct sockaddr*)&door_address, sizeof(door_address));
+    if (result == -1 && errno != EINPROGRESS) {
+        close(sockfd);
+        fanout->report->errors++;
+        attempt_failed(fanout, door, now);
+        return;
+    }
+
+    struct epoll_event event = { .events = EPOLLOUT, .data.ptr = door };
+    if (epoll_ctl(fanout->epoll_fd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+        perror("epoll_ctl failed");
+        close(sockfd);
+        fanout->report->errors++;
+        attempt_failed(fanout, door, now);
+        return;
+    }
+
+    door->fd = sockfd;
+    door->deadline_ns = now + (uint64_t)EMERGENCY_ATTEMPT_TIMEOUT_MS * 1000000ULL;
+    queue_push(&fanout->in_flight, door);
+    if (fanout->in_flight.count > fanout->report->peak_in_flight) {
+        fanout->report->peak_in_flight = fanout->in_flight.count;
+    }
+    if (result == 0) {
+        write_command(fanout, door, now); // loopback connects can complete at once
+    }
+}
+
+static void on_writable(Fanout* fanout, EmergencyDoor* door, uint64_t now) {
+    if (door->sent == 0) {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (getsockopt(door->fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == -1 || error != 0) {
+            fanout->report->errors++;
+            attempt_failed(fanout, door, now);
+            return;
+        }
+    }
+    write_command(fanout, door, now);
+}
+
+// Time until the next attempt times out or retry comes due, for epoll_wait
+static int next_timeout_ms(const Fanout* fanout, uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    if (fanout->in_flight.head) next = fanout->in_flight.head->deadline_ns;
+    if (fanout->retrying.head && fanout->retrying.head->deadline_ns < next) next = fanout->retrying.head->deadline_ns;
+    if (next == UINT64_MAX) return -1;
+    if (next <= now) return 0;
+    return (int)((next - now + 999999) / 1000000);
+}
+
+int emergency_open_doors(const DoorSet* doors, uint64_t alarm_ns, EmergencyReport* report) {
+    memset(report, 0, sizeof(*report));
+    size_t count = doorset_count(doors);
+    report->doors = count;
+    if (count == 0) {
+        return 0;
+    }
+
+    Fanout fanout;
+    memset(&fanout, 0, sizeof(fanout));
+    fanout.alarm_ns = alarm_ns ? alarm_ns : emergency_now_ns();
+    fanout.report = report;
+
+    EmergencyDoor* slots = calloc(count, sizeof(EmergencyDoor));
+    fanout.epoll_fd = epoll_create1(0);
+    if (!slots || fanout.epoll_fd == -1) {
+        perror("Failed to start the emergency fan-out");
+        free(slots);
+        if (fanout.epoll_fd != -1) close(fanout.epoll_fd);
+        report->failed = count;
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const DoorSetEntry* entry = doorset_at(doors, i);
+        slots[i].addr = entry->addr;
+        slots[i].port = entry->port;
+        slots[i].fd = -1;
+        queue_push(&fanout.ready, &slots[i]);
+    }
+
+    struct epoll_event events[EMERGENCY_MAX_EVENTS];
+    while (fanout.ready.count || fanout.in_flight.count || fanout.retrying.count) {
+        uint64_t now = emergency_now_ns();
+
+        while (fanout.retrying.head && fanout.retrying.head->deadline_ns <= now) {
+            EmergencyDoor* door = fanout.retrying.head;
+            queue_remove(&fanout.retrying, door);
+            queue_push(&fanout.ready, door);
+        }
+        while (fanout.in_flight.head && fanout.in_flight.head->deadline_ns <= now) {
+            report->timeouts++;
+            attempt_failed(&fanout, fanout.in_flight.head, now);
+        }
+        while (fanout.ready.head && fanout.in_flight.count < EMERGENCY_MAX_IN_FLIGHT) {
+            EmergencyDoor* door = fanout.ready.head;
+            queue_remove(&fanout.ready, door);
+            start_attempt(&fanout, door, now);
+        }
+        if (!fanout.in_flight.count && !fanout.retrying.count) {
+            continue; // anything left is ready to start
+        }
+
+        int ready = epoll_wait(fanout.epoll_fd, events, EMERGENCY_MAX_EVENTS, next_timeout_ms(&fanout, now));
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        now = emergency_now_ns();
+        for (int i = 0; i < ready; i++) {
+            on_writable(&fanout, events[i].data.ptr, now);
+        }
+    }
+
+    // Only reached early if epoll failed: whatever is left was not commanded
+    for (size_t i = 0; i < count; i++) {
+        if (slots[i].fd != -1) close(slots[i].fd);
+    }
+    report->failed = count - report->commanded;
+    close(fanout.epoll_fd);
+    free(slots);
+    return report->commanded == count ? 0 : -1;
+}
+
+void emergency_print_report(FILE* out, const EmergencyReport* report) {
+    fprintf(out, "Emergency: %zu of %zu doors commanded, first %.3f ms and last %.3f ms after the alarm, finished at %.3f ms\n",
+            report->commanded, report->doors, report->first_ns / 1e6, report->last_ns / 1e6, report->finished_ns / 1e6);
+    fprintf(out, "  attempts: %lu, timeouts: %lu, errors: %lu, failed doors: %zu, peak connecting: %zu\n",
+            report->attempts, report->timeouts, report->errors, report->failed, report->peak_in_flight);
+}
@@ -0,0 +1,64 @@
+#ifndef EMERGENCY_H
+#define EMERGENCY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "doorset.h"
+
+#define EMERGENCY_MAX_IN_FLIGHT 256   // connections being opened at once
+#define EMERGENCY_ATTEMPT_TIMEOUT_MS 250 // to connect and hand over OPEN_EMERG#
+#define EMERGENCY_RETRY_DELAY_MS 20
+#define EMERGENCY_ATTEMPTS 5          // per door before it is reported as failed
+
+// One door's OPEN_EMERG# delivery, in one of the fan-out's queues
+typedef struct EmergencyDoor {
+    struct in_addr addr;
+    in_port_t port; // host order
+    int fd;         // -1 unless an attempt is in flight
+    int attempts;
+    size_t sent;          // bytes of OPEN_EMERG# written on this attempt
+    uint64_t deadline_ns; // end of the attempt in flight, or when the retry may start
+    struct EmergencyDoor* prev;
+    struct EmergencyDoor* next;
+} EmergencyDoor;
+
+typedef struct {
+    EmergencyDoor* head;
+    EmergencyDoor* tail;
+    size_t count;
+} EmergencyQueue;
+
+typedef struct {
+    size_t doors;
+    size_t commanded;
+    size_t failed;
+    unsigned long attempts;
+    unsigned long timeouts;
+    unsigned long errors; // refused, reset or otherwise failed attempts
+    size_t peak_in_flight;
+    uint64_t first_ns;    // alarm -> first door commanded
+    uint64_t last_ns;     // alarm -> last door commanded
+    uint64_t finished_ns; // alarm -> last door commanded or given up on
+} EmergencyReport;
+
+/**
+ * Send OPEN_EMERG# to every door in the set. All connections are started
+ * non-blocking at once (up to EMERGENCY_MAX_IN_FLIGHT) and driven by one
+ * epoll loop, so a slow or dead door only costs its own deadline. Failed
+ * attempts go to a retry queue. Returns once every door has been commanded
+ * or has used up its attempts.
+ * @param alarm_ns CLOCK_MONOTONIC time the alarm was raised, which the report is timed from (0 for now).
+ * @return 0 if every door was commanded, -1 otherwise.
+ */
+int emergency_open_doors(const DoorSet* doors, uint64_t alarm_ns, EmergencyReport* report);
+
+void emergency_print_report(FILE* out, const EmergencyReport* report);
+
+/**
+ * @return The CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t emergency_now_ns();
+
+#endif // EMERGENCY_H
@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "doorset.h"
+
+// End-to-end evacuation latency. Launches the overseer, a fire alarm, N FAIL_SAFE
+// doors and the call points or temperature sensors, raises the alarm through shared
+// memory, and times how long until every door reports 'O'. Plays the simulator's part:
+// it owns the shared memory and completes each door's movement as soon as it starts.
+//
+// Every run is one JSON object per line, appended to the results file.
+
+#define DEFAULT_BASE_PORT 20000
+#define DEFAULT_SENSORS 1
+#define MAX_DOORS 5000
+#define MAX_SENSORS 20
+#define REGISTER_TIMEOUT_MS 60000
+#define OPEN_TIMEOUT_MS 10000
+
+#define DATAGRAM_RESEND_US 20000
+#define CALLPOINT_RESEND_US 50000
+#define TEMP_THRESHOLD 50
+#define TEMP_DETECTION_PERIOD_US 1000000
+#define TEMPSENSOR_CONDVAR_WAIT_US 100000
+#define TEMPSENSOR_UPDATE_WAIT_US 100000
+
+typedef struct {
+    char security_alarm;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} OverseerSlot;
+
+typedef struct {
+    char alarm;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} FireAlarmSlot;
+
+typedef struct {
+    char status;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_start;
+    pthread_cond_t cond_end;
+} DoorSlot;
+
+typedef struct {
+    char status;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} CallpointSlot;
+
+typedef struct {
+    float temperature;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} TempsensorSlot;
+
+// Everything the components map, laid out back to back; each is told its own offset
+typedef struct {
+    OverseerSlot overseer;
+    FireAlarmSlot firealarm;
+    CallpointSlot callpoints[MAX_SENSORS];
+    TempsensorSlot tempsensors[MAX_SENSORS];
+    DoorSlot doors[]; // one per door
+} BenchMemory;
+
+typedef enum { TRIGGER_CALLPOINT, TRIGGER_TEMPSENSOR } Trigger;
+
+typedef struct {
+    DoorSlot* slot;
+    uint64_t opened_ns; // 0 until the door starts opening
+} DoorWatch;
+
+static BenchMemory* memory;
+static char shm_name[64];
+static pthread_mutex_t opened_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t opened_cond = PTHREAD_COND_INITIALIZER;
+static long opened;
+static volatile int stopping;
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void init_shared(pthread_mutex_t* mutex, pthread_cond_t* cond1, pthread_cond_t* cond2) {
+    pthread_mutexattr_t mutex_attr;
+    pthread_condattr_t cond_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(mutex, &mutex_attr);
+    pthread_cond_init(cond1, &cond_attr);
+    if (cond2) pthread_cond_init(cond2, &cond_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+    pthread_condattr_destroy(&cond_attr);
+}
+
+static size_t memory_size(long doors) {
+    return sizeof(BenchMemory) + doors * sizeof(DoorSlot);
+}
+
+static int create_memory(long doors, int sensors) {
+    snprintf(shm_name, sizeof(shm_name), "/evacbench-%d", (int)getpid());
+    shm_unlink(shm_name);
+    int fd = shm_open(shm_name, O_CREAT | O_RDWR, 0666);
+    if (fd == -1 || ftruncate(fd, memory_size(doors)) == -1) {
+        perror("Failed to create shared memory");
+        return -1;
+    }
+    memory = mmap(NULL, memory_size(doors), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        perror("Failed to map shared memory");
+        return -1;
+    }
+
+    memset(memory, 0, memory_size(doors));
+    memory->overseer.security_alarm = '-';
+    init_shared(&memory->overseer.mutex, &memory->overseer.cond, NULL);
+    memory->firealarm.alarm = '-';
+    init_shared(&memory->firealarm.mutex, &memory->firealarm.cond, NULL);
+    for (int i = 0; i < sensors; i++) {
+        memory->callpoints[i].status = '-';
+        init_shared(&memory->callpoints[i].mutex, &memory->callpoints[i].cond, NULL);
+        memory->tempsensors[i].temperature = 20.0f;
+        init_shared(&memory->tempsensors[i].mutex, &memory->tempsensors[i].cond, NULL);
+    }
+    for (long i = 0; i < doors; i++) {
+        memory->doors[i].status = 'C';
+        init_shared(&memory->doors[i].mutex, &memory->doors[i].cond_start, &memory->doors[i].cond_end);
+    }
+    return 0;
+}
+
+static void destroy_memory(long doors) {
+    munmap(memory, memory_size(doors));
+    shm_unlink(shm_name);
+}
+
+// The simulator's side of a door: finish its movement the moment it starts
+static void* watch_door(void* arg) {
+    DoorWatch* watch = arg;
+    DoorSlot* slot = watch->slot;
+
+    pthread_mutex_lock(&slot->mutex);
+    while (slot->status != 'o' && slot->status != 'c' && !stopping) {
+        pthread_cond_wait(&slot->cond_start, &slot->mutex);
+    }
+    if (slot->status == 'o') {
+        watch->opened_ns = now_ns();
+        slot->status = 'O';
+        pthread_cond_signal(&slot->cond_end);
+        pthread_mutex_unlock(&slot->mutex);
+
+        pthread_mutex_lock(&opened_lock);
+        opened++;
+        pthread_cond_signal(&opened_cond);
+        pthread_mutex_unlock(&opened_lock);
+        return NULL;
+    }
+    if (slot->status == 'c') {
+        slot->status = 'C';
+        pthread_cond_signal(&slot->cond_end);
+    }
+    pthread_mutex_unlock(&slot->mutex);
+    return NULL;
+}
+
+static pid_t spawn(char* const argv[], int stdin_fd, const char* env_name, const char* env_value) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(stdin_fd != -1 ? stdin_fd : null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        if (!getenv("EVACBENCH_VERBOSE")) dup2(null_fd, STDERR_FILENO);
+        if (env_name) setenv(env_name, env_value, 1);
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int wait_for_listener(int port, int timeout_ms) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int waited = 0; waited < timeout_ms; waited++) {
+        int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        int connected = connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        close(sockfd);
+        if (connected) return 0;
+        usleep(1000);
+    }
+    return -1;
+}
+
+// Doors the fire alarm has confirmed, read from its registry file without disturbing it
+static long registered_doors(const char* registry_path) {
+    int fd = open(registry_path, O_RDONLY);
+    if (fd == -1) return -1;
+    DoorSetFileHeader header;
+    ssize_t len = pread(fd, &header, sizeof(header), 0);
+    close(fd);
+    return len == sizeof(header) ? (long)header.count : -1;
+}
+
+static void write_empty_file(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file) fclose(file);
+}
+
+typedef struct {
+    long doors;
+    int sensors;
+    Trigger trigger;
+    int run;
+    int base_port;
+    FILE* results;
+} RunConfig;
+
+// One launch of the whole site and one alarm; returns 0 if every door opened in time
+static int run_once(const RunConfig* config) {
+    long doors = config->doors;
+    int sensors = config->sensors;
+    int overseer_port = config->base_port;
+    int firealarm_port = config->base_port + 1;
+    char overseer_addr[32], firealarm_addr[32];
+    snprintf(overseer_addr, sizeof(overseer_addr), "127.0.0.1:%d", overseer_port);
+    snprintf(firealarm_addr, sizeof(firealarm_addr), "127.0.0.1:%d", firealarm_port);
+
+    char auth_path[64], conn_path[64], layout_path[64], registry_path[64];
+    snprintf(auth_path, sizeof(auth_path), "/tmp/evacbench-%d.auth", (int)getpid());
+    snprintf(conn_path, sizeof(conn_path), "/tmp/evacbench-%d.conn", (int)getpid());
+    snprintf(layout_path, sizeof(layout_path), "/tmp/evacbench-%d.layout", (int)getpid());
+    snprintf(registry_path, sizeof(registry_path), "/tmp/evacbench-%d.doors", (int)getpid());
+    write_empty_file(auth_path);
+    write_empty_file(conn_path);
+    write_empty_file(layout_path);
+    unlink(registry_path);
+
+    if (create_memory(doors, sensors) == -1) {
+        return -1;
+    }
+    pid_t* pids = calloc(doors + 2 * sensors + 2, sizeof(pid_t));
+    DoorWatch* watches = calloc(doors, sizeof(DoorWatch));
+    pthread_t* threads = calloc(doors, sizeof(pthread_t));
+    size_t pid_count = 0;
+    opened = 0;
+    stopping = 0;
+    int status = -1;
+    char offset[32], arg_a[32], arg_b[32];
+
+    // The overseer reads commands from stdin: keep it open and quiet until the end
+    int stdin_pipe[2];
+    if (pipe(stdin_pipe) == -1) {
+        perror("pipe");
+        goto teardown;
+    }
+    snprintf(arg_a, sizeof(arg_a), "%d", DATAGRAM_RESEND_US);
+    char* overseer_argv[] = { "./overseer", overseer_addr, "1000000", arg_a, auth_path, conn_path, layout_path,
+                              shm_name, "0", NULL };
+    pids[pid_count++] = spawn(overseer_argv, stdin_pipe[0], NULL, NULL);
+    close(stdin_pipe[0]);
+    if (wait_for_listener(overseer_port, 5000) == -1) {
+        fprintf(stderr, "The overseer did not start listening on %d\n", overseer_port);
+        goto teardown;
+    }
+
+    snprintf(offset, sizeof(offset), "%zu", offsetof(BenchMemory, firealarm));
+    snprintf(arg_a, sizeof(arg_a), "%d", TEMP_THRESHOLD);
+    snprintf(arg_b, sizeof(arg_b), "%d", TEMP_DETECTION_PERIOD_US);
+    char firealarm_arg[32];
+    strcpy(firealarm_arg, firealarm_addr);
+    char* firealarm_argv[] = { "./firealarm", firealarm_arg, arg_a, "1", arg_b, "0", shm_name, offset, overseer_addr, NULL };
+    pids[pid_count++] = spawn(firealarm_argv, -1, "FIREALARM_DOOR_FILE", registry_path);
+    for (int waited = 0; registered_doors(registry_path) == -1; waited++) {
+        if (waited == 5000) {
+            fprintf(stderr, "The fire alarm did not start\n");
+            goto teardown;
+        }
+        usleep(1000);
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    for (long i = 0; i < doors; i++) {
+        watches[i].slot = &memory->doors[i];
+        pthread_create(&threads[i], &attr, watch_door, &watches[i]);
+    }
+    pthread_attr_destroy(&attr);
+
+    uint64_t launched_ns = now_ns();
+    for (long i = 0; i < doors; i++) {
+        char id[32], door_addr[32], door_offset[32];
+        snprintf(id, sizeof(id), "%ld", 5000 + i);
+        snprintf(door_addr, sizeof(door_addr), "127.0.0.1:%ld", config->base_port + 2 + i);
+        snprintf(door_offset, sizeof(door_offset), "%zu", offsetof(BenchMemory, doors) + i * sizeof(DoorSlot));
+        char* door_argv[] = { "./door", id, door_addr, "FAIL_SAFE", shm_name, door_offset, overseer_addr, NULL };
+        pids[pid_count++] = spawn(door_argv, -1, NULL, NULL);
+    }
+    for (int i = 0; i < sensors; i++) {
+        char sensor_offset[32];
+        if (config->trigger == TRIGGER_CALLPOINT) {
+            snprintf(sensor_offset, sizeof(sensor_offset), "%zu", offsetof(BenchMemory, callpoints) + i * sizeof(CallpointSlot));
+            snprintf(arg_a, sizeof(arg_a), "%d", CALLPOINT_RESEND_US);
+            strcpy(firealarm_arg, firealarm_addr);
+            char* callpoint_argv[] = { "./callpoint", arg_a, shm_name, sensor_offset, firealarm_arg, NULL };
+            pids[pid_count++] = spawn(callpoint_argv, -1, NULL, NULL);
+        } else {
+            char id[16], sensor_addr[32];
+            snprintf(id, sizeof(id), "%d", 100 + i);
+            snprintf(sensor_addr, sizeof(sensor_addr), "127.0.0.1:%ld", config->base_port + 2 + doors + i);
+            snprintf(sensor_offset, sizeof(sensor_offset), "%zu", offsetof(BenchMemory, tempsensors) + i * sizeof(TempsensorSlot));
+            snprintf(arg_a, sizeof(arg_a), "%d", TEMPSENSOR_CONDVAR_WAIT_US);
+            snprintf(arg_b, sizeof(arg_b), "%d", TEMPSENSOR_UPDATE_WAIT_US);
+            strcpy(firealarm_arg, firealarm_addr);
+            char* tempsensor_argv[] = { "./tempsensor", id, sensor_addr, arg_a, arg_b, shm_name, sensor_offset, firealarm_arg, NULL };
+            pids[pid_count++] = spawn(tempsensor_argv, -1, NULL, NULL);
+        }
+    }
+
+    // Armed once the fire alarm has confirmed every door
+    long registered = 0;
+    while ((registered = registered_doors(registry_path)) < doors) {
+        if ((now_ns() - launched_ns) / 1000000 > REGISTER_TIMEOUT_MS) {
+            fprintf(stderr, "Only %ld of %ld doors reached the fire alarm\n", registered, doors);
+            goto teardown;
+        }
+        usleep(1000);
+    }
+    double registered_ms = (now_ns() - launched_ns) / 1e6;
+    usleep(200000); // let the sensors settle into their idle wait
+
+    // Raise the alarm the way the simulator does
+    uint64_t alarm_ns = now_ns();
+    for (int i = 0; i < sensors; i++) {
+        if (config->trigger == TRIGGER_CALLPOINT) {
+            pthread_mutex_lock(&memory->callpoints[i].mutex);
+            memory->callpoints[i].status = '*';
+            pthread_cond_broadcast(&memory->callpoints[i].cond);
+            pthread_mutex_unlock(&memory->callpoints[i].mutex);
+        } else {
+            pthread_mutex_lock(&memory->tempsensors[i].mutex);
+            memory->tempsensors[i].temperature = TEMP_THRESHOLD + 30.0f;
+            pthread_cond_broadcast(&memory->tempsensors[i].cond);
+            pthread_mutex_unlock(&memory->tempsensors[i].mutex);
+        }
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += OPEN_TIMEOUT_MS / 1000;
+    pthread_mutex_lock(&opened_lock);
+    while (opened < doors) {
+        if (pthread_cond_timedwait(&opened_cond, &opened_lock, &deadline) == ETIMEDOUT) break;
+    }
+    long opened_doors = opened;
+    pthread_mutex_unlock(&opened_lock);
+
+    uint64_t* open_ns = malloc(doors * sizeof(uint64_t));
+    long n = 0;
+    for (long i = 0; i < doors; i++) {
+        if (watches[i].opened_ns) open_ns[n++] = watches[i].opened_ns - alarm_ns;
+    }
+    qsort(open_ns, n, sizeof(uint64_t), compare_u64);
+
+    const char* trigger = config->trigger == TRIGGER_CALLPOINT ? "callpoint" : "tempsensor";
+    FILE* outputs[] = { stdout, config->results };
+    for (int o = 0; o < 2; o++) {
+        if (!outputs[o]) continue;
+        fprintf(outputs[o], "{\"benchmark\":\"evacuation\",\"trigger\":\"%s\",\"doors\":%ld,\"sensors\":%d,\"run\":%d,"
+                "\"registered_ms\":%.3f,\"opened\":%ld,", trigger, doors, sensors, config->run, registered_ms, opened_doors);
+        if (n > 0) {
+            fprintf(outputs[o], "\"first_open_ms\":%.3f,\"p50_open_ms\":%.3f,\"p99_open_ms\":%.3f,",
+                    open_ns[0] / 1e6, open_ns[n / 2] / 1e6, open_ns[(n - 1) * 99 / 100] / 1e6);
+        } else {
+            fprintf(outputs[o], "\"first_open_ms\":null,\"p50_open_ms\":null,\"p99_open_ms\":null,");
+        }
+        if (opened_doors == doors) {
+            fprintf(outputs[o], "\"all_open_ms\":%.3f}\n", open_ns[n - 1] / 1e6);
+        } else {
+            fprintf(outputs[o], "\"all_open_ms\":null}\n");
+        }
+        fflush(outputs[o]);
+    }
+    free(open_ns);
+    status = opened_doors == doors ? 0 : -1;
+
+teardown:
+    for (size_t i = 0; i < pid_count; i++) {
+        if (pids[i] > 0) kill(pids[i], SIGKILL);
+    }
+    for (size_t i = 0; i < pid_count; i++) {
+        if (pids[i] > 0) waitpid(pids[i], NULL, 0);
+    }
+    close(stdin_pipe[1]);
+
+    // Release the watchers of doors that never moved
+    stopping = 1;
+    for (long i = 0; i < doors; i++) {
+        if (!threads[i]) continue;
+        pthread_mutex_lock(&memory->doors[i].mutex);
+        pthread_cond_broadcast(&memory->doors[i].cond_start);
+        pthread_mutex_unlock(&memory->doors[i].mutex);
+        pthread_join(threads[i], NULL);
+    }
+    destroy_memory(doors);
+    unlink(auth_path);
+    unlink(conn_path);
+    unlink(layout_path);
+    unlink(registry_path);
+    free(pids);
+    free(watches);
+    free(threads);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 1;
+    int sensors = DEFAULT_SENSORS;
+    int base_port = DEFAULT_BASE_PORT;
+    const char* results_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:p:o:")) != -1) {
+        switch (opt) {
+        case 'r': runs = atoi(optarg); break;
+        case 's': sensors = atoi(optarg); break;
+        case 'p': base_port = atoi(optarg); break;
+        case 'o': results_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-r runs] [-s call points/sensors] [-p base port] [-o results.jsonl] [door counts...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (sensors < 1 || sensors > MAX_SENSORS) {
+        fprintf(stderr, "Between 1 and %d call points/sensors\n", MAX_SENSORS);
+        return 1;
+    }
+
+    long default_counts[] = { 10, 100, 1000 };
+    long counts[16];
+    int count_total = 0;
+    for (int i = optind; i < argc && count_total < 16; i++) {
+        counts[count_total++] = atol(argv[i]);
+    }
+    if (count_total == 0) {
+        memcpy(counts, default_counts, sizeof(default_counts));
+        count_total = 3;
+    }
+
+    FILE* results = NULL;
+    if (results_path && !(results = fopen(results_path, "a"))) {
+        perror(results_path);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int failures = 0;
+    for (int c = 0; c < count_total; c++) {
+        if (counts[c] < 1 || counts[c] > MAX_DOORS) {
+            fprintf(stderr, "Skipping %ld doors: between 1 and %d\n", counts[c], MAX_DOORS);
+            continue;
+        }
+        for (int t = 0; t < 2; t++) {
+            for (int r = 1; r <= runs; r++) {
+                RunConfig config = { counts[c], sensors, t == 0 ? TRIGGER_CALLPOINT : TRIGGER_TEMPSENSOR, r, base_port, results };
+                if (run_once(&config) != 0) failures++;
+                // Fresh ports every run, clear of the last run's lingering sockets
+                base_port += counts[c] + sensors + 8;
+                if (base_port > 60000 - MAX_DOORS) base_port = DEFAULT_BASE_PORT;
+            }
+        }
+    }
+    if (results) fclose(results);
+    return failures ? 1 : 0;
+}
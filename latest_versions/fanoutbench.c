@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "tempwire.h"
+#include "udpfanout.h"
+
+// Temperature sensor fan-out: a reading sent to every receiver with one sendto
+// each, against the same datagrams queued on a UdpFanout and sent with sendmmsg.
+// Both the sensor's own reading (one payload for all) and a forward (a header
+// per receiver over shared entries) are measured, with the syscalls each made.
+
+#define DEFAULT_ROUNDS 20000
+#define MAX_RECEIVERS 50
+#define PATH_ENTRIES 4
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int receivers[MAX_RECEIVERS];
+static struct sockaddr_in receiver_addrs[MAX_RECEIVERS];
+static TempWireAddr path[PATH_ENTRIES];
+
+// Receivers nobody reads: once full the kernel drops, which costs both variants the same
+static void open_receivers(int count) {
+    for (int i = 0; i < count; i++) {
+        socklen_t len = sizeof(receiver_addrs[i]);
+        memset(&receiver_addrs[i], 0, sizeof(receiver_addrs[i]));
+        receiver_addrs[i].sin_family = AF_INET;
+        receiver_addrs[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        receivers[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        if (receivers[i] == -1 || bind(receivers[i], (struct sockaddr*)&receiver_addrs[i], sizeof(receiver_addrs[i])) == -1 ||
+            getsockname(receivers[i], (struct sockaddr*)&receiver_addrs[i], &len) == -1) {
+            perror("Failed to open a receiver");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void reading_init(TempReading* reading) {
+    memset(reading, 0, sizeof(*reading));
+    reading->id = 7;
+    reading->temperature = 21.5f;
+    reading->timestamp_us = 1700000000000000ULL;
+    reading->address_count = PATH_ENTRIES;
+    reading->addresses = path;
+    reading->path_length = PATH_ENTRIES;
+}
+
+typedef struct {
+    double ns_per_fanout;
+    double syscalls_per_fanout;
+} Result;
+
+// forward: a header per receiver, as receive_and_forward builds them; otherwise one shared header
+static Result run_sendto(int sockfd, int count, int rounds, int forward) {
+    TempReading reading;
+    reading_init(&reading);
+    TempWireHeader headers[MAX_RECEIVERS];
+    TempWireAddr appended[MAX_RECEIVERS];
+    struct iovec iov[TEMP_WIRE_IOVECS];
+    unsigned long syscalls = 0;
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        int iovcnt = temp_wire_encode(&reading, NULL, 0, &headers[0], iov);
+        for (int i = 0; i < count; i++) {
+            if (forward) {
+                appended[i].sensor_addr = receiver_addrs[i].sin_addr;
+                appended[i].sensor_port = receiver_addrs[i].sin_port;
+                iovcnt = temp_wire_encode(&reading, appended, i + 1, &headers[i], iov);
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &receiver_addrs[i];
+            msg.msg_namelen = sizeof(receiver_addrs[i]);
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            sendmsg(sockfd, &msg, 0);
+            syscalls++;
+        }
+    }
+    Result result = { (double)(now_ns() - start) / rounds, (double)syscalls / rounds };
+    return result;
+}
+
+static Result run_fanout(int sockfd, int count, int rounds, int forward) {
+    TempReading reading;
+    reading_init(&reading);
+    TempWireHeader headers[MAX_RECEIVERS];
+    TempWireAddr appended[MAX_RECEIVERS];
+    struct iovec iov[TEMP_WIRE_IOVECS];
+    UdpFanout fanout;
+    if (udp_fanout_init(&fanout, sockfd, MAX_RECEIVERS) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        int iovcnt = temp_wire_encode(&reading, NULL, 0, &headers[0], iov);
+        for (int i = 0; i < count; i++) {
+            if (forward) {
+                appended[i].sensor_addr = receiver_addrs[i].sin_addr;
+                appended[i].sensor_port = receiver_addrs[i].sin_port;
+                iovcnt = temp_wire_encode(&reading, appended, i + 1, &headers[i], iov);
+            }
+            udp_fanout_add(&fanout, &receiver_addrs[i], iov, iovcnt);
+        }
+        udp_fanout_flush(&fanout);
+    }
+    Result result = { (double)(now_ns() - start) / rounds, (double)fanout.calls / rounds };
+    udp_fanout_free(&fanout);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    int counts[] = { 4, 16, MAX_RECEIVERS };
+    open_receivers(MAX_RECEIVERS);
+    for (int i = 0; i < PATH_ENTRIES; i++) {
+        path[i].sensor_addr.s_addr = htonl(INADDR_LOOPBACK);
+        path[i].sensor_port = htons(30000 + i);
+    }
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd == -1) {
+        perror("socket");
+        return 1;
+    }
+
+    printf("%d fan-outs per case, %d path entries carried\n", rounds, PATH_ENTRIES);
+    printf("%-9s %9s  %22s  %22s  %8s\n", "", "receivers", "sendto: syscalls  us", "sendmmsg: syscalls  us", "speedup");
+    const char* kinds[] = { "reading", "forward" };
+    for (int forward = 0; forward < 2; forward++) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            Result single = run_sendto(sockfd, counts[c], rounds, forward);
+            Result batched = run_fanout(sockfd, counts[c], rounds, forward);
+            printf("%-9s %9d  %13.1f %8.2f  %13.1f %8.2f  %7.2fx\n", kinds[forward], counts[c],
+                   single.syscalls_per_fanout, single.ns_per_fanout / 1000,
+                   batched.syscalls_per_fanout, batched.ns_per_fanout / 1000,
+                   single.ns_per_fanout / batched.ns_per_fanout);
+        }
+    }
+
+    close(sockfd);
+    for (int i = 0; i < MAX_RECEIVERS; i++) {
+        close(receivers[i]);
+    }
+    return 0;
+}
@@ -9,11 +9,23 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <stddef.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include "doorset.h"
+#include "emergency.h"
+#include "detection.h"
+#include "udpbatch.h"
+#include "spscring.h"
+#include "tempwire.h"
+#include <sys/eventfd.h>
 
 #define OVERSEER_PORT 8080
-#define MAX_DOORS 100
-#define MAX_DETECTIONS 50
 #define BUFFER_SIZE 512
+#define DATAGRAM_MAX 1024
+#define EVENT_QUEUE_CAPACITY 4096
 
 typedef struct {
     char header[4];
@@ -21,11 +33,38 @@ typedef struct {
     in_port_t door_port;
 } DoorDatagram;
 
+typedef enum {
+    EVENT_TEMP, // a reading at or above the threshold
+    EVENT_FIRE,
+    EVENT_DOOR,
+    EVENT_DVER
+} FireEventKind;
+
+// A parsed datagram, handed from the receive thread to the actuation thread
 typedef struct {
-    char header[4]; // {'D', 'O', 'O', 'R'}
-    struct in_addr door_addr;
-    in_port_t door_port;
-} Door;
+    FireEventKind kind;
+    union {
+        struct {
+            uint16_t sensor_id;
+            uint64_t timestamp_us;
+        } temp;
+        struct {
+            struct in_addr addr;
+            in_port_t port;
+        } door;
+        struct {
+            uint64_t epoch;
+            uint64_t version;
+        } version;
+    };
+} FireEvent;
+
+typedef struct {
+    int sockfd; // the bound UDP port, so the overseer can match DREGs on address and port
+    const char *overseer_addr;
+    int overseer_port;
+    int min_detections;
+} ActuationArgs;
 
 typedef struct {
     char alarm; // '-' if inactive, 'A' if active
@@ -35,16 +74,34 @@ typedef struct {
 
 shm_firealarm *shared;
 
-Door doors[MAX_DOORS];
-int door_count = 0;
-uint64_t detections[MAX_DETECTIONS];
-int detection_count = 0;
+DoorSet doors;
+// Door set version last confirmed by the overseer's DVER, sent back in HELLO
+uint64_t door_set_epoch = 0;
+uint64_t door_set_version = 0;
+DetectionWindow detections; // hot readings within the detection period, per sensor
+int alarm_raised = 0;
+UdpBatch batch; // recvmmsg buffers for the main loop
+// Receive thread -> actuation thread. Only the actuation thread touches the doors, detections and shm latch.
+SpscRing events;
+int events_fd; // eventfd: the receive thread has queued events
+atomic_ulong events_handled;
+atomic_ulong max_event_wait_ns;
+// A FIRE that found the ring full, latched for the actuation thread: when it was received, 0 if none
+atomic_ullong fire_latched_ns;
+atomic_ulong fires_latched;
+volatile sig_atomic_t stats_requested = 0;
 
 
 int send_init_message(const char *firealarm_addr, const char *addr, int port) {
   
     char message[BUFFER_SIZE]; // Write message
-    snprintf(message, sizeof(message), "FIREALARM %s HELLO#", firealarm_addr);
+    if (door_set_epoch != 0) {
+        // Only the doors added since this version are announced again
+        snprintf(message, sizeof(message), "FIREALARM %s HELLO %016llx:%llu#", firealarm_addr,
+                 (unsigned long long)door_set_epoch, (unsigned long long)door_set_version);
+    } else {
+        snprintf(message, sizeof(message), "FIREALARM %s HELLO#", firealarm_addr);
+    }
 
     int sockfd;
     struct sockaddr_in overseer_addr;
@@ -72,106 +129,175 @@ int send_init_message(const char *firealarm_addr, const char *addr, int port) {
     return 0;
 }
 
-void process_TEMP_datagram(char *buffer, int len, int temp_threshold, uint64_t detection_period, int min_detections) {
-    // Assuming the TEMP datagram format is known, extract temperature and timestamp
-    int temperature;
-    uint64_t timestamp;
-    // decode(buffer, &temperature, &timestamp); // placeholder
-    
-    if (temperature >= temp_threshold) {
-        uint64_t current_time = (uint64_t) time(NULL) * 1000000;  // convert to microseconds
+/**
+ * Check a TEMP datagram and pull out the reading.
+ * @return 0 if it is well formed, -1 if it is truncated or malformed.
+ */
+int decode_TEMP_datagram(const char *buffer, int len, float *temperature, uint16_t *sensor_id, uint64_t *timestamp_us) {
+    TempReading reading;
+    if (temp_wire_decode(buffer, len, &reading) == -1) {
+        return -1;
+    }
 
-        // Remove old detections
-        int idx = 0;
-        while (idx < detection_count && detections[idx] < current_time - detection_period) {
-            idx++;
+    *temperature = reading.temperature;
+    *sensor_id = reading.id;
+    *timestamp_us = reading.timestamp_us;
+    return 0;
+}
+
+// Receive thread: turn a datagram into an event; returns 0 if there is nothing to hand over
+int parse_datagram(const char *buffer, int len, int temp_threshold, FireEvent *event) {
+    if (len < 4) {
+        return 0;
+    }
+    if (strncmp(buffer, "TEMP", 4) == 0) {
+        float temperature;
+        event->kind = EVENT_TEMP;
+        if (decode_TEMP_datagram(buffer, len, &temperature, &event->temp.sensor_id, &event->temp.timestamp_us) == -1) {
+            return 0;
         }
-        if (idx > 0) {
-            memmove(detections, detections + idx, (detection_count - idx) * sizeof(uint64_t));
-            detection_count -= idx;
+        return temperature >= temp_threshold; // cold readings never count towards an alarm
+    } else if (strncmp(buffer, "FIRE", 4) == 0) {
+        event->kind = EVENT_FIRE;
+        return 1;
+    } else if (strncmp(buffer, "DOOR", 4) == 0) {
+        if (len < (int)sizeof(DoorDatagram)) {
+            return 0;
         }
-
-        // Add new detection
-        detections[detection_count++] = timestamp;
-
-        if (detection_count >= min_detections) {
-            // Trigger alarm
-            pthread_mutex_lock(&shared->mutex);
-            shared->alarm = 'A';
-            pthread_cond_signal(&shared->cond);
-            pthread_mutex_unlock(&shared->mutex);
-            // Send open door signal to all registered doors
-            for (int i = 0; i < door_count; i++) {
-                // send_open_door_signal(doors[i].addr, doors[i].port);
-            }
+        DoorDatagram datagram;
+        memcpy(&datagram, buffer, sizeof(datagram));
+        event->kind = EVENT_DOOR;
+        event->door.addr = datagram.door_addr;
+        event->door.port = datagram.door_port;
+        return 1;
+    } else if (strncmp(buffer, "DVER", 4) == 0) {
+        if (len < (int)sizeof(DoorSetVersion)) {
+            return 0;
         }
+        DoorSetVersion version;
+        memcpy(&version, buffer, sizeof(version));
+        event->kind = EVENT_DVER;
+        event->version.epoch = version.epoch;
+        event->version.version = version.version;
+        return 1;
     }
+    return 0; // unknown datagram type
 }
 
-void process_DOOR_datagram(char *buffer, int len, const char* overseer_addr, int overseer_port) {
-    DoorDatagram *datagram = (DoorDatagram *) buffer;
-    
-    // Check if door already registered
-    int found = 0;
-    for (int i = 0; i < door_count; i++) {
-        if (doors[i].door_addr.s_addr == datagram->door_addr.s_addr && doors[i].door_port == datagram->door_port) {
-            found = 1;
-            break;
-        }
-    }
+// Latch the alarm in shared memory and open every door
+void raise_alarm(uint64_t alarm_ns) {
+    alarm_raised = 1;
+    pthread_mutex_lock(&shared->mutex);
+    shared->alarm = 'A';
+    pthread_cond_signal(&shared->cond);
+    pthread_mutex_unlock(&shared->mutex);
 
-    if (!found) {
-        doors[door_count].door_addr = datagram->door_addr;
-        doors[door_count].door_port = datagram->door_port;
-        door_count++;
-
-        // Send confirmation to overseer
-        int udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
-        struct sockaddr_in overseer_address;
-        overseer_address.sin_family = AF_INET;
-        overseer_address.sin_port = htons(overseer_port);
-        inet_pton(AF_INET, overseer_addr, &(overseer_address.sin_addr));
-
-        DoorDatagram confirm = {.header = "DREG", .door_addr = datagram->door_addr, .door_port = datagram->door_port};
-        sendto(udp_socket, &confirm, sizeof(confirm), 0, (struct sockaddr*)&overseer_address, sizeof(overseer_address));
-        close(udp_socket);
-    }
+    // Open all registered doors at once
+    EmergencyReport report;
+    emergency_open_doors(&doors, alarm_ns, &report);
+    emergency_print_report(stdout, &report);
+    fflush(stdout);
 }
 
-void send_open_door_signal(struct in_addr addr, in_port_t port) {
-    int tcp_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (tcp_socket == -1) {
-        perror("Cannot create TCP socket");
-        return;
-    }
+void process_TEMP_event(const FireEvent *event, uint64_t received_ns, int min_detections) {
+    struct timeval now;
+    gettimeofday(&now, NULL); // the sensors' clock
+    uint64_t current_time = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
 
-    struct sockaddr_in door_address;
-    door_address.sin_family = AF_INET;
-    door_address.sin_port = port;
-    door_address.sin_addr = addr;
+    long detection_count = detection_record(&detections, event->temp.sensor_id, event->temp.timestamp_us, current_time);
+    if (detection_count >= min_detections && !alarm_raised) {
+        raise_alarm(received_ns);
+    }
+}
 
-    if (connect(tcp_socket, (struct sockaddr *)&door_address, sizeof(door_address)) != 0) {
-        perror("Cannot connect to door");
-        close(tcp_socket);
+void process_DOOR_event(const FireEvent *event, int sockfd, const char* overseer_addr, int overseer_port) {
+    // A door already in the set is not added again
+    if (doorset_add(&doors, event->door.addr, event->door.port) == -1) {
+        fprintf(stderr, "Could not grow the door set (allocation or file resize failed), not confirming door\n");
         return;
     }
 
-    const char *message = "OPEN_EMERG#";
-    send(tcp_socket, message, strlen(message), 0);
+    // Confirm repeats too: the overseer resends a DOOR datagram whose DREG was lost
+    struct sockaddr_in overseer_address;
+    overseer_address.sin_family = AF_INET;
+    overseer_address.sin_port = htons(overseer_port);
+    inet_pton(AF_INET, overseer_addr, &(overseer_address.sin_addr));
 
-    close(tcp_socket);
+    DoorDatagram confirm = {.header = "DREG", .door_addr = event->door.addr, .door_port = event->door.port};
+    sendto(sockfd, &confirm, sizeof(confirm), 0, (struct sockaddr*)&overseer_address, sizeof(overseer_address));
 }
 
-void process_FIRE_datagram() {
-    pthread_mutex_lock(&shared->mutex);
-    shared->alarm = 'A';
-    pthread_cond_signal(&shared->cond);
-    pthread_mutex_unlock(&shared->mutex);
+void process_DVER_event(const FireEvent *event) {
+    door_set_epoch = event->version.epoch;
+    door_set_version = event->version.version;
+    doorset_set_sync(&doors, door_set_epoch, door_set_version);
+}
 
-    // Open all registered doors
-    for (int i = 0; i < door_count; i++) {
-        send_open_door_signal(doors[i].door_addr, doors[i].door_port);
+// Owns the door set, the detection window and the shm latch; blocking door work only ever stalls this thread
+void *actuation_thread(void *arg) {
+    ActuationArgs *args = arg;
+    FireEvent event;
+    uint64_t received_ns;
+
+    while (1) {
+        while (1) {
+            // A latched FIRE goes ahead of everything still queued
+            uint64_t fire_ns = atomic_exchange(&fire_latched_ns, 0);
+            if (fire_ns) {
+                raise_alarm(fire_ns);
+            }
+            if (!spsc_pop(&events, &event, &received_ns)) {
+                break;
+            }
+
+            uint64_t waited = emergency_now_ns() - received_ns;
+            if (waited > atomic_load_explicit(&max_event_wait_ns, memory_order_relaxed)) {
+                atomic_store_explicit(&max_event_wait_ns, waited, memory_order_relaxed);
+            }
+
+            switch (event.kind) {
+            case EVENT_TEMP:
+                process_TEMP_event(&event, received_ns, args->min_detections);
+                break;
+            case EVENT_FIRE:
+                raise_alarm(received_ns);
+                break;
+            case EVENT_DOOR:
+                process_DOOR_event(&event, args->sockfd, args->overseer_addr, args->overseer_port);
+                break;
+            case EVENT_DVER:
+                process_DVER_event(&event);
+                break;
+            }
+            atomic_fetch_add_explicit(&events_handled, 1, memory_order_relaxed);
+        }
+
+        // Sleep until the receive thread queues more
+        uint64_t count;
+        if (read(events_fd, &count, sizeof(count)) == -1 && errno != EINTR) {
+            perror("eventfd read failed");
+            break;
+        }
     }
+    return NULL;
+}
+
+void print_stats() {
+    udp_batch_print_stats(&batch, stdout, "Fire alarm");
+    printf("Fire alarm event queue (capacity %zu):\n", events.mask + 1);
+    printf("  depth: %zu (peak %zu), oldest event waiting: %.3f ms, longest wait: %.3f ms\n",
+           spsc_depth(&events), events.peak_depth, spsc_oldest_age_ns(&events, emergency_now_ns()) / 1e6,
+           atomic_load_explicit(&max_event_wait_ns, memory_order_relaxed) / 1e6);
+    unsigned long latched = atomic_load_explicit(&fires_latched, memory_order_relaxed);
+    printf("  handled: %lu, dropped (queue full): %lu, FIRE latched past a full queue: %lu\n",
+           atomic_load_explicit(&events_handled, memory_order_relaxed), events.full - latched, latched);
+    fflush(stdout);
+}
+
+// SIGUSR1 asks for the receive and queue statistics; they are printed from the receive loop
+void request_stats(int signo) {
+    (void)signo;
+    stats_requested = 1;
 }
 
 int bind_udp_port(int port) {
@@ -201,6 +327,7 @@ int bind_udp_port(int port) {
 }
 
 int main(int argc, char *argv[]) {
+    uint64_t started_ns = emergency_now_ns();
 
     if (argc != 9) {
         fprintf(stderr, "Usage: %s {address:port} {temperature threshold} {min detections} {detection period (in microseconds)} {reserved argument} {shared memory path} {shared memory offset} {overseer address:port}\n", argv[0]);
@@ -220,6 +347,25 @@ int main(int argc, char *argv[]) {
     int overseer_port = atoi(strtok(NULL, ":"));
 
     
+    // The door registry is kept in a file, so a restart is armed with the doors it already knew
+    char default_path[64];
+    const char *registry_path = getenv("FIREALARM_DOOR_FILE");
+    if (!registry_path) {
+        snprintf(default_path, sizeof(default_path), "firealarm-%d.doors", port);
+        registry_path = default_path;
+    }
+    int warm = doorset_open(&doors, registry_path);
+    if (warm == -1) {
+        fprintf(stderr, "Keeping the door registry in memory only\n");
+        if (doorset_init(&doors) == -1) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    doorset_get_sync(&doors, &door_set_epoch, &door_set_version);
+    if (detection_init(&detections, min_detections, detection_period) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
     // Bind the UDP port
     int sockfd = bind_udp_port(port);
     if (sockfd < 0) {
@@ -248,32 +394,95 @@ int main(int argc, char *argv[]) {
     }
     shared = (shm_firealarm *)(shm + shm_offset);
 
+    if (udp_batch_init(&batch, sockfd, udp_batch_size_from_env("FIREALARM_UDP_BATCH"), DATAGRAM_MAX) == -1 ||
+        spsc_init(&events, EVENT_QUEUE_CAPACITY, sizeof(FireEvent)) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    events_fd = eventfd(0, 0);
+    if (events_fd == -1) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
     // Send init message
-    send_init_message(addr_str, overseer_addr_str, port);
+    char firealarm_addr[64];
+    snprintf(firealarm_addr, sizeof(firealarm_addr), "%s:%d", addr_str, port);
+    send_init_message(firealarm_addr, overseer_addr_str, overseer_port);
+
+    // No SA_RESTART: the signal interrupts recvmmsg so the stats are printed at once
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stats;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+
+    // The actuation thread starts with SIGUSR1 blocked, so it is always delivered to this one
+    ActuationArgs actuation_args = { sockfd, overseer_addr_str, overseer_port, min_detections };
+    sigset_t usr1, previous;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &usr1, &previous);
+    pthread_t actuation;
+    if (pthread_create(&actuation, NULL, actuation_thread, &actuation_args) != 0) {
+        fprintf(stderr, "Failed to start the actuation thread\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    printf("Armed with %zu FAIL_SAFE doors (%s start) %.3f ms after launch\n", doorset_count(&doors),
+           warm == 1 ? "warm" : "cold", (emergency_now_ns() - started_ns) / 1e6);
+    fflush(stdout);
 
-    // Main loop
-    char buffer[1024];
+    // Receive loop: drain every datagram already queued with each syscall, parse and hand over
     while (1) {
+        if (stats_requested) {
+            stats_requested = 0;
+            print_stats();
+        }
+
+        int received = udp_batch_receive(&batch);
+        if (received == -1) {
+            if (errno == EINTR) continue;
+            perror("recvmmsg failed");
+            break;
+        }
 
-        struct sockaddr_in sender_address;
-        socklen_t sender_len = sizeof(sender_address);
-        int len = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr *)&sender_address, &sender_len);
-        
-        if (len >= 4) {
-            if (strncmp(buffer, "TEMP", 4) == 0) {
-                process_TEMP_datagram(buffer, len, temp_threshold, detection_period, min_detections);
-            } else if (strncmp(buffer, "FIRE", 4) == 0) {
-                process_FIRE_datagram();
-            } else if (strncmp(buffer, "DOOR", 4) == 0) {
-                process_DOOR_datagram(buffer, len, overseer_addr_str, overseer_port);
+        uint64_t now = emergency_now_ns();
+        int queued = 0, dropped = 0;
+        for (int i = 0; i < received; i++) {
+            size_t len;
+            char *buffer = udp_batch_datagram(&batch, i, &len, NULL);
+            FireEvent event;
+            if (!buffer || !parse_datagram(buffer, (int)len, temp_threshold, &event)) {
+                continue;
+            }
+            if (spsc_push(&events, &event, now) == 0) {
+                queued++;
+            } else if (event.kind == EVENT_FIRE) {
+                // Never lose a FIRE: keep the first one latched until the actuation thread takes it
+                uint64_t none = 0;
+                atomic_compare_exchange_strong(&fire_latched_ns, &none, now);
+                atomic_fetch_add_explicit(&fires_latched, 1, memory_order_relaxed);
+                queued++;
             } else {
-                // Log or handle unknown datagram type
+                dropped++;
             }
         }
+        if (dropped) {
+            fprintf(stderr, "Fire alarm event queue full, dropped %d datagram(s)\n", dropped);
+        }
+        // One wakeup per batch
+        uint64_t one = 1;
+        if (queued && write(events_fd, &one, sizeof(one)) == -1) {
+            perror("eventfd write failed");
+        }
     }
 
     // Cleanup and exit
 
+    spsc_free(&events);
+    udp_batch_free(&batch);
+    detection_free(&detections);
+    doorset_free(&doors);
     munmap(shared, sizeof(shm_firealarm));
     close(sockfd);
     //close(shm_fd);
@@ -0,0 +1,86 @@
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "frame.h"
+
+void frame_reader_init(FrameReader* reader) {
+    reader->start = 0;
+    reader->scanned = 0;
+    reader->end = 0;
+}
+
+ssize_t frame_reader_fill(FrameReader* reader, int fd) {
+    // Leave room for the terminator that frame_reader_rest() may add
+    size_t capacity = sizeof(reader->data) - 1;
+
+    if (reader->start > 0) {
+        // Only the unfinished frame is moved, complete ones were already handed out
+        size_t pending = reader->end - reader->start;
+        memmove(reader->data, reader->data + reader->start, pending);
+        reader->scanned -= reader->start;
+        reader->end = pending;
+        reader->start = 0;
+    }
+
+    if (reader->end >= capacity) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(fd, reader->data + reader->end, capacity - reader->end, 0);
+    } while (n == -1 && errno == EINTR);
+
+    if (n > 0) {
+        reader->end += n;
+    }
+    return n;
+}
+
+char* frame_reader_next(FrameReader* reader, size_t* len) {
+    char* frame = reader->data + reader->start;
+    char* delimiter = memchr(reader->data + reader->scanned, FRAME_DELIMITER, reader->end - reader->scanned);
+
+    if (delimiter == NULL) {
+        reader->scanned = reader->end;
+        // A full buffer with no delimiter can never complete, hand it out as it is
+        if (reader->start == 0 && reader->end >= sizeof(reader->data) - 1) {
+            return frame_reader_rest(reader, len);
+        }
+        return NULL;
+    }
+
+    *delimiter = '\0';
+    if (len) *len = delimiter - frame;
+    reader->start = delimiter - reader->data + 1;
+    reader->scanned = reader->start;
+    return frame;
+}
+
+char* frame_reader_rest(FrameReader* reader, size_t* len) {
+    if (reader->start == reader->end) {
+        return NULL;
+    }
+
+    char* frame = reader->data + reader->start;
+    reader->data[reader->end] = '\0';
+    if (len) *len = reader->end - reader->start;
+    reader->start = reader->scanned = reader->end;
+    return frame;
+}
+
+char* frame_read(FrameReader* reader, int fd, size_t* len) {
+    char* frame;
+
+    while ((frame = frame_reader_next(reader, len)) == NULL) {
+        ssize_t n = frame_reader_fill(reader, fd);
+        if (n == 0) {
+            return frame_reader_rest(reader, len);
+        }
+        if (n < 0) {
+            return NULL;
+        }
+    }
+    return frame;
+}
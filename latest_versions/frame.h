@@ -0,0 +1,58 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define FRAME_BUFFER_SIZE 1024
+#define FRAME_DELIMITER '#'
+
+/*
+ * Buffered reader for '#'-terminated TCP messages.
+ *
+ * Bytes are read from the socket in bulk and frames are handed out as
+ * pointers into the reader's own buffer, with the '#' replaced by '\0'.
+ * A frame stays valid until the next call to frame_reader_fill().
+ */
+typedef struct {
+    size_t start;   // first byte not yet handed out
+    size_t scanned; // bytes before this offset are known not to contain '#'
+    size_t end;     // one past the last byte read
+    char data[FRAME_BUFFER_SIZE];
+} FrameReader;
+
+void frame_reader_init(FrameReader* reader);
+
+/**
+ * Read whatever the socket has available into the reader's buffer.
+ * Partial frames are moved to the front of the buffer first.
+ * @param reader The frame reader.
+ * @param fd The socket to read from (blocking or non-blocking).
+ * @return Bytes read, 0 on EOF, -1 on error with errno set
+ *         (EAGAIN/EWOULDBLOCK on an empty non-blocking socket).
+ */
+ssize_t frame_reader_fill(FrameReader* reader, int fd);
+
+/**
+ * Hand out the next complete frame, if one is buffered.
+ * A buffer completely filled without a delimiter is returned as one frame.
+ * @param reader The frame reader.
+ * @param len Set to the frame length (excluding the delimiter), may be NULL.
+ * @return The NUL-terminated frame without its '#', or NULL if none is complete.
+ */
+char* frame_reader_next(FrameReader* reader, size_t* len);
+
+/**
+ * Hand out the trailing bytes that never got a delimiter (e.g. after EOF).
+ * @return The NUL-terminated partial frame, or NULL if nothing is buffered.
+ */
+char* frame_reader_rest(FrameReader* reader, size_t* len);
+
+/**
+ * Blocking convenience wrapper: fill until a complete frame is available.
+ * On EOF any partial frame is returned instead.
+ * @return The frame, or NULL on EOF with nothing buffered or on error.
+ */
+char* frame_read(FrameReader* reader, int fd, size_t* len);
+
+#endif // FRAME_H
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include "frame.h"
+
+// Frames per second for the old byte-at-a-time recv() loop against FrameReader
+
+#define DEFAULT_FRAMES 200000
+#define WRITE_CHUNK 65536
+
+static const char *sample_frame = "CARDREADER 101 SCANNED db4ed0a0bfbb00ac#";
+
+typedef struct {
+    int fd;
+    long frames;
+} WriterArgs;
+
+static void *writer_thread(void *arg) {
+    WriterArgs *args = arg;
+    size_t frame_len = strlen(sample_frame);
+    char *chunk = malloc(WRITE_CHUNK);
+    size_t used = 0;
+
+    for (long i = 0; i < args->frames; i++) {
+        if (used + frame_len > WRITE_CHUNK) {
+            send(args->fd, chunk, used, 0);
+            used = 0;
+        }
+        memcpy(chunk + used, sample_frame, frame_len);
+        used += frame_len;
+    }
+    if (used > 0) {
+        send(args->fd, chunk, used, 0);
+    }
+    shutdown(args->fd, SHUT_WR);
+    free(chunk);
+    return NULL;
+}
+
+static long read_byte_at_a_time(int fd) {
+    long frames = 0;
+    char buffer[1024];
+    char current_byte;
+
+    while (1) {
+        ssize_t total_bytes_read = 0;
+        int got_any = 0;
+        while (recv(fd, &current_byte, 1, 0) == 1) {
+            got_any = 1;
+            if (current_byte == '#' || total_bytes_read >= (ssize_t)sizeof(buffer) - 1) {
+                break;
+            }
+            buffer[total_bytes_read++] = current_byte;
+        }
+        if (!got_any) break;
+        buffer[total_bytes_read] = '\0';
+        frames++;
+    }
+    return frames;
+}
+
+static long read_framed(int fd) {
+    long frames = 0;
+    FrameReader reader;
+    frame_reader_init(&reader);
+
+    while (frame_read(&reader, fd, NULL) != NULL) {
+        frames++;
+    }
+    return frames;
+}
+
+static double run(const char *name, long (*reader)(int), long frames) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        perror("socketpair()");
+        exit(1);
+    }
+
+    WriterArgs args = { fds[1], frames };
+    pthread_t writer;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&writer, NULL, writer_thread, &args);
+    long received = reader(fds[0]);
+    pthread_join(writer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double rate = received / seconds;
+    printf("%-18s %8ld frames in %.3f s: %12.0f frames/sec\n", name, received, seconds, rate);
+
+    close(fds[0]);
+    close(fds[1]);
+    return rate;
+}
+
+int main(int argc, char *argv[]) {
+    long frames = argc > 1 ? atol(argv[1]) : DEFAULT_FRAMES;
+
+    double byte_rate = run("byte-at-a-time", read_byte_at_a_time, frames);
+    double framed_rate = run("FrameReader", read_framed, frames);
+
+    printf("speedup: %.1fx\n", framed_rate / byte_rate);
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "latency.h"
+
+// One thread's counts. Only the owning thread writes; readers load.
+typedef struct LatencyShard {
+    atomic_ulong counts[STAGE_COUNT][LATENCY_BUCKETS];
+    struct LatencyShard* next;
+} LatencyShard;
+
+static _Atomic(LatencyShard*) shards;
+static __thread LatencyShard* own_shard;
+
+// Totals at the last reset, guarded by report_mutex along with reporting
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t baseline[STAGE_COUNT][LATENCY_BUCKETS];
+
+static const char* stage_names[STAGE_COUNT] = {
+    "frame received",
+    "auth lookup",
+    "route lookup",
+    "reader reply sent",
+    "door OPENED",
+    "door CLOSE sent",
+};
+
+static int bucket_for(uint64_t value) {
+    if (value < LATENCY_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb > LATENCY_MAX_BIT) {
+        return LATENCY_BUCKETS - 1;
+    }
+    int shift = msb - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)((value >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+// Highest value that lands in a bucket
+static uint64_t bucket_limit(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub = LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+static LatencyShard* claim_shard() {
+    LatencyShard* shard = calloc(1, sizeof(LatencyShard));
+    if (!shard) {
+        return NULL;
+    }
+    // Shards are never freed, so a thread's counts outlive it
+    LatencyShard* head = atomic_load(&shards);
+    do {
+        shard->next = head;
+    } while (!atomic_compare_exchange_weak(&shards, &head, shard));
+    return shard;
+}
+
+uint64_t latency_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void latency_record(LatencyStage stage, uint64_t ns) {
+    if (!own_shard && !(own_shard = claim_shard())) {
+        return;
+    }
+    // Single writer, so a relaxed load and store is enough; no locked add
+    atomic_ulong* count = &own_shard->counts[stage][bucket_for(ns)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void latency_record_since(LatencyStage stage, const struct timespec* start) {
+    uint64_t start_ns = (uint64_t)start->tv_sec * 1000000000ULL + start->tv_nsec;
+    uint64_t now = latency_now_ns();
+    latency_record(stage, now > start_ns ? now - start_ns : 0);
+}
+
+static void merge(uint64_t totals[STAGE_COUNT][LATENCY_BUCKETS]) {
+    memset(totals, 0, sizeof(uint64_t) * STAGE_COUNT * LATENCY_BUCKETS);
+    for (LatencyShard* shard = atomic_load(&shards); shard; shard = shard->next) {
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+                totals[stage][bucket] += atomic_load_explicit(&shard->counts[stage][bucket], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+static uint64_t percentile(const uint64_t* counts, uint64_t total, double percent) {
+    uint64_t target = (uint64_t)(percent / 100.0 * total + 0.5);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if (seen >= target) {
+            return bucket_limit(bucket);
+        }
+    }
+    return bucket_limit(LATENCY_BUCKETS - 1);
+}
+
+void latency_print(FILE* out) {
+    static uint64_t totals[STAGE_COUNT][LATENCY_BUCKETS];
+
+    pthread_mutex_lock(&report_mutex);
+    merge(totals);
+
+    fprintf(out, "%-18s %10s %10s %10s %10s %10s %10s\n", "Stage (us)", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        uint64_t total = 0;
+        int highest = -1;
+        for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            totals[stage][bucket] -= baseline[stage][bucket];
+            total += totals[stage][bucket];
+            if (totals[stage][bucket]) highest = bucket;
+        }
+
+        if (total == 0) {
+            fprintf(out, "%-18s %10d %10s %10s %10s %10s %10s\n", stage_names[stage], 0, "-", "-", "-", "-", "-");
+            continue;
+        }
+        fprintf(out, "%-18s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f\n", stage_names[stage], total,
+                percentile(totals[stage], total, 50) / 1e3,
+                percentile(totals[stage], total, 90) / 1e3,
+                percentile(totals[stage], total, 99) / 1e3,
+                percentile(totals[stage], total, 99.9) / 1e3,
+                bucket_limit(highest) / 1e3);
+    }
+    pthread_mutex_unlock(&report_mutex);
+}
+
+void latency_reset() {
+    pthread_mutex_lock(&report_mutex);
+    merge(baseline);
+    pthread_mutex_unlock(&report_mutex);
+}
@@ -0,0 +1,58 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Stages of a scan through the overseer. Each histogram records the time
+ * named in its comment.
+ */
+typedef enum {
+    STAGE_FRAME_RECEIVED,  // connection accepted -> its first complete frame read
+    STAGE_AUTH_LOOKUP,     // parsing the code and probing the authorisation index
+    STAGE_ROUTE_LOOKUP,    // routing the card reader to its door
+    STAGE_REPLY_SENT,      // SCANNED frame read -> ALLOWED#/DENIED# sent
+    STAGE_DOOR_OPENED,     // SCANNED frame read -> door answered OPENED#
+    STAGE_DOOR_CLOSE_SENT, // last SCANNED frame of the cycle read -> CLOSE# sent
+    STAGE_COUNT
+} LatencyStage;
+
+/*
+ * High-dynamic-range histogram layout: 32 linear sub-buckets per power of
+ * two, so every recorded value is kept to within about 3%, from 1 ns up
+ * to 2^40 ns (about 18 minutes). Larger values land in the last bucket.
+ */
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_BIT 40
+#define LATENCY_BUCKETS ((LATENCY_MAX_BIT - LATENCY_SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+/**
+ * Record one latency. Lock-free: each thread counts into its own buckets,
+ * which readers merge.
+ * @param stage The stage the value belongs to.
+ * @param ns The latency in nanoseconds.
+ */
+void latency_record(LatencyStage stage, uint64_t ns);
+
+/**
+ * Record the time elapsed since a CLOCK_MONOTONIC timestamp.
+ */
+void latency_record_since(LatencyStage stage, const struct timespec* start);
+
+uint64_t latency_now_ns();
+
+/**
+ * Merge every thread's buckets and print count and percentiles per stage.
+ */
+void latency_print(FILE* out);
+
+/**
+ * Start counting from zero again. Writers are never stopped: the current
+ * totals become a baseline that later reports subtract.
+ */
+void latency_reset();
+
+#endif // LATENCY_H
@@ -0,0 +1,642 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "frame.h"
+#include "authindex.h"
+#include "routes.h"
+
+// Synthetic card reader load for the overseer: registers virtual card readers and doors,
+// serves the door side, replays scans and reports throughput, errors and latency
+
+#define DEFAULT_DOOR_BASE_PORT 7000
+#define SCAN_TIMEOUT_NS 5000000000ULL // a scan with no verdict after 5 s is an error
+#define DRAIN_NS 5000000000ULL        // how long to wait for scans in flight once the run ends
+#define UNKNOWN_CARD_EVERY 10         // every tenth scan presents a card that is not in the file
+#define MAX_EVENTS 256
+
+typedef enum { NORMAL_MODE, EMERGENCY_MODE, SECURE_MODE } DoorMode;
+
+typedef struct {
+    int id;
+    int port;
+    char status; // 'O' or 'C'
+    DoorMode mode;
+} VirtualDoor;
+
+// A listening socket of a virtual door, or a connection the overseer opened to one
+typedef struct {
+    int fd;
+    int listening;
+    VirtualDoor* door;
+    FrameReader reader;
+} DoorEndpoint;
+
+typedef struct Scan {
+    int fd;
+    int connected;
+    int expect_allowed;
+    uint64_t intended_ns; // when the scan was due; latency is measured from here
+    char message[64];
+    char reply[32];
+    size_t reply_len;
+    struct Scan* prev;
+    struct Scan* next;
+} Scan;
+
+typedef struct {
+    unsigned long issued;
+    unsigned long not_issued; // open loop only: the client ran out of descriptors
+    unsigned long completed;
+    unsigned long allowed;
+    unsigned long denied;
+    unsigned long connect_failed;
+    unsigned long no_reply;
+    unsigned long timed_out;
+    unsigned long bad_reply;
+    unsigned long wrong_verdict;
+} ScanStats;
+
+static struct sockaddr_in overseer_addr;
+static AuthIndex* auth;
+static RouteTable* routes;
+
+static int* readers;
+static size_t reader_count;
+static VirtualDoor* doors;
+static size_t door_count;
+static uint64_t* codes;
+static size_t code_count;
+
+static atomic_int stop_doors;
+static atomic_ulong door_opens, door_closes, door_connections;
+
+static ScanStats stats;
+static Scan* inflight_head;
+static Scan* inflight_tail;
+static size_t inflight;
+static uint64_t* latencies;
+static size_t latency_count, latency_capacity;
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static uint64_t next_random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+// Send one registration frame on its own connection, as the real devices do
+static int send_registration(const char* message) {
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd == -1) {
+        perror("Socket creation error");
+        return -1;
+    }
+    if (connect(sockfd, (struct sockaddr*)&overseer_addr, sizeof(overseer_addr)) == -1) {
+        perror("Connection failed");
+        close(sockfd);
+        return -1;
+    }
+    if (send(sockfd, message, strlen(message), MSG_NOSIGNAL) == -1) {
+        perror("send failed");
+        close(sockfd);
+        return -1;
+    }
+    close(sockfd);
+    return 0;
+}
+
+// Pick the first `wanted` card readers wired to a door, and the doors they open
+static int choose_readers(size_t wanted) {
+    const RouteArray* array = &routes->doors;
+    readers = malloc(wanted * sizeof(int));
+    doors = calloc(wanted, sizeof(VirtualDoor));
+    if (!readers || !doors) {
+        perror("malloc failed");
+        return -1;
+    }
+
+    for (size_t i = 0; i < array->span && reader_count < wanted; i++) {
+        if (array->routes[i].kind != ROUTE_DOOR) continue;
+        readers[reader_count++] = array->min_id + (int)i;
+
+        int door_id = array->routes[i].target;
+        size_t d;
+        for (d = 0; d < door_count && doors[d].id != door_id; d++) {
+        }
+        if (d == door_count) {
+            doors[door_count].id = door_id;
+            doors[door_count].status = 'C';
+            door_count++;
+        }
+    }
+    return reader_count > 0 ? 0 : -1;
+}
+
+static int collect_codes() {
+    codes = malloc((auth->count ? auth->count : 1) * sizeof(uint64_t));
+    if (!codes) {
+        perror("malloc failed");
+        return -1;
+    }
+    for (size_t i = 0; i <= auth->mask; i++) {
+        if (auth->slots[i].grants != AUTH_EMPTY_SLOT) {
+            codes[code_count++] = auth->slots[i].code;
+        }
+    }
+    return 0;
+}
+
+static int listen_on(int port) {
+    struct sockaddr_in address;
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd == -1) {
+        perror("Socket creation error");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(sockfd, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(sockfd, 64) == -1) {
+        perror("Door bind/listen failed");
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+static void door_reply(int fd, const char* reply) {
+    if (send(fd, reply, strlen(reply), MSG_NOSIGNAL) == -1) {
+        perror("Failed to send door reply");
+    }
+}
+
+// Same answers as door.c, without the time the real door takes to move
+static void door_command(int fd, VirtualDoor* door, const char* command) {
+    if (strcmp(command, "OPEN") == 0) {
+        atomic_fetch_add(&door_opens, 1);
+        if (door->mode == SECURE_MODE) {
+            door_reply(fd, "SECURE_MODE#");
+        } else if (door->status == 'O') {
+            door_reply(fd, "ALREADY#");
+        } else {
+            door->status = 'O';
+            door_reply(fd, "OPENING#OPENED#");
+        }
+    } else if (strcmp(command, "CLOSE") == 0) {
+        atomic_fetch_add(&door_closes, 1);
+        if (door->mode == EMERGENCY_MODE) {
+            door_reply(fd, "EMERGENCY_MODE#");
+        } else if (door->status == 'C') {
+            door_reply(fd, "ALREADY#");
+        } else {
+            door->status = 'C';
+            door_reply(fd, "CLOSING#CLOSED#");
+        }
+    } else if (strcmp(command, "OPEN_EMERG") == 0) {
+        door->mode = EMERGENCY_MODE;
+        door->status = 'O';
+        door_reply(fd, "EMERGENCY_MODE#");
+    } else if (strcmp(command, "CLOSE_SECURE") == 0) {
+        door->mode = SECURE_MODE;
+        door->status = 'C';
+        door_reply(fd, "SECURE_MODE#");
+    }
+}
+
+static void door_event(int epoll_fd, DoorEndpoint* endpoint) {
+    if (endpoint->listening) {
+        int fd;
+        while ((fd = accept4(endpoint->fd, NULL, NULL, SOCK_NONBLOCK)) != -1) {
+            DoorEndpoint* conn = calloc(1, sizeof(DoorEndpoint));
+            if (!conn) {
+                close(fd);
+                continue;
+            }
+            conn->fd = fd;
+            conn->door = endpoint->door;
+            frame_reader_init(&conn->reader);
+            struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = conn };
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            atomic_fetch_add(&door_connections, 1);
+        }
+        return;
+    }
+
+    ssize_t n = frame_reader_fill(&endpoint->reader, endpoint->fd);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, endpoint->fd, NULL);
+        close(endpoint->fd);
+        free(endpoint);
+        return;
+    }
+    char* command;
+    while ((command = frame_reader_next(&endpoint->reader, NULL)) != NULL) {
+        door_command(endpoint->fd, endpoint->door, command);
+    }
+}
+
+// Serves every virtual door from one thread
+static void* door_thread(void* arg) {
+    int epoll_fd = *(int*)arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!atomic_load(&stop_doors)) {
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            door_event(epoll_fd, events[i].data.ptr);
+        }
+    }
+    return NULL;
+}
+
+static int start_doors(int base_port, int* epoll_fd, pthread_t* thread) {
+    *epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (*epoll_fd == -1) {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+
+    for (size_t i = 0; i < door_count; i++) {
+        doors[i].port = base_port + (int)i;
+        DoorEndpoint* endpoint = calloc(1, sizeof(DoorEndpoint));
+        if (!endpoint || (endpoint->fd = listen_on(doors[i].port)) == -1) {
+            free(endpoint);
+            return -1;
+        }
+        endpoint->listening = 1;
+        endpoint->door = &doors[i];
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = endpoint };
+        epoll_ctl(*epoll_fd, EPOLL_CTL_ADD, endpoint->fd, &event);
+    }
+
+    if (pthread_create(thread, NULL, door_thread, epoll_fd) != 0) {
+        perror("Failed to start door thread");
+        return -1;
+    }
+    return 0;
+}
+
+static int register_devices() {
+    char message[128];
+    for (size_t i = 0; i < door_count; i++) {
+        snprintf(message, sizeof(message), "DOOR %d 127.0.0.1:%d FAIL_SAFE#", doors[i].id, doors[i].port);
+        if (send_registration(message) == -1) return -1;
+    }
+    for (size_t i = 0; i < reader_count; i++) {
+        snprintf(message, sizeof(message), "CARDREADER %d HELLO#", readers[i]);
+        if (send_registration(message) == -1) return -1;
+    }
+    return 0;
+}
+
+// The verdict the overseer should reach, from the same files it loaded
+static int expect_allowed(int reader_id, uint64_t code) {
+    const uint64_t* grants = auth_index_lookup(auth, code);
+    const Route* route = route_lookup(routes, ROUTE_DOOR, reader_id);
+    return grants && route && auth_index_allows(auth, grants, AUTH_GRANT_DOOR, route->target);
+}
+
+static void record_latency(uint64_t ns) {
+    if (latency_count == latency_capacity) {
+        size_t capacity = latency_capacity ? latency_capacity * 2 : 4096;
+        uint64_t* grown = realloc(latencies, capacity * sizeof(uint64_t));
+        if (!grown) return;
+        latencies = grown;
+        latency_capacity = capacity;
+    }
+    latencies[latency_count++] = ns;
+}
+
+static void unlink_scan(Scan* scan) {
+    if (scan->prev) scan->prev->next = scan->next; else inflight_head = scan->next;
+    if (scan->next) scan->next->prev = scan->prev; else inflight_tail = scan->prev;
+    inflight--;
+}
+
+static void end_scan(int epoll_fd, Scan* scan, unsigned long* error) {
+    if (error) {
+        (*error)++;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, scan->fd, NULL);
+    close(scan->fd);
+    unlink_scan(scan);
+    free(scan);
+}
+
+static void start_scan(int epoll_fd, uint64_t intended_ns) {
+    Scan* scan = calloc(1, sizeof(Scan));
+    if (!scan) {
+        stats.connect_failed++;
+        return;
+    }
+
+    int reader_id = readers[next_random() % reader_count];
+    uint64_t code;
+    stats.issued++;
+    if (stats.issued % UNKNOWN_CARD_EVERY == 0 || code_count == 0) {
+        do {
+            code = next_random();
+        } while (auth_index_lookup(auth, code) != NULL);
+    } else {
+        code = codes[next_random() % code_count];
+    }
+    scan->expect_allowed = expect_allowed(reader_id, code);
+    scan->intended_ns = intended_ns;
+    snprintf(scan->message, sizeof(scan->message), "CARDREADER %d SCANNED %016llx#", reader_id, (unsigned long long)code);
+
+    scan->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (scan->fd == -1 ||
+        (connect(scan->fd, (struct sockaddr*)&overseer_addr, sizeof(overseer_addr)) == -1 && errno != EINPROGRESS)) {
+        if (scan->fd != -1) close(scan->fd);
+        free(scan);
+        stats.connect_failed++;
+        return;
+    }
+    struct epoll_event event = { .events = EPOLLOUT, .data.ptr = scan };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, scan->fd, &event);
+
+    scan->prev = inflight_tail;
+    if (inflight_tail) inflight_tail->next = scan; else inflight_head = scan;
+    inflight_tail = scan;
+    inflight++;
+}
+
+static void finish_scan(int epoll_fd, Scan* scan) {
+    uint64_t latency = now_ns() - scan->intended_ns;
+    scan->reply[scan->reply_len] = '\0';
+
+    int allowed = strcmp(scan->reply, "ALLOWED#") == 0;
+    if (!allowed && strcmp(scan->reply, "DENIED#") != 0) {
+        end_scan(epoll_fd, scan, &stats.bad_reply);
+        return;
+    }
+    stats.completed++;
+    if (allowed) stats.allowed++; else stats.denied++;
+    record_latency(latency);
+    end_scan(epoll_fd, scan, allowed != scan->expect_allowed ? &stats.wrong_verdict : NULL);
+}
+
+static void scan_event(int epoll_fd, Scan* scan) {
+    if (!scan->connected) {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (getsockopt(scan->fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == -1 || error != 0) {
+            end_scan(epoll_fd, scan, &stats.connect_failed);
+            return;
+        }
+        scan->connected = 1;
+        size_t len = strlen(scan->message);
+        if (send(scan->fd, scan->message, len, MSG_NOSIGNAL) != (ssize_t)len) {
+            end_scan(epoll_fd, scan, &stats.no_reply);
+            return;
+        }
+        struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = scan };
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, scan->fd, &event);
+        return;
+    }
+
+    while (scan->reply_len < sizeof(scan->reply) - 1) {
+        ssize_t n = recv(scan->fd, scan->reply + scan->reply_len, sizeof(scan->reply) - 1 - scan->reply_len, 0);
+        if (n > 0) {
+            scan->reply_len += n;
+            if (memchr(scan->reply, FRAME_DELIMITER, scan->reply_len)) break;
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        break; // closed by the overseer, or failed
+    }
+
+    if (scan->reply_len == 0) {
+        end_scan(epoll_fd, scan, &stats.no_reply);
+    } else {
+        finish_scan(epoll_fd, scan);
+    }
+}
+
+static void expire_scans(int epoll_fd, uint64_t now) {
+    // Scans start in due-time order, so the oldest is always at the head
+    while (inflight_head && now - inflight_head->intended_ns > SCAN_TIMEOUT_NS) {
+        end_scan(epoll_fd, inflight_head, &stats.timed_out);
+    }
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(double percent) {
+    if (latency_count == 0) return 0.0;
+    size_t rank = (size_t)(percent / 100.0 * latency_count + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > latency_count) rank = latency_count;
+    return latencies[rank - 1] / 1e3;
+}
+
+// Descriptors the client may hold for scans in flight
+static size_t raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        return 900;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    size_t reserved = door_count * 2 + 64;
+    return limit.rlim_cur > reserved + 100 ? limit.rlim_cur - reserved : 100;
+}
+
+static void report(const char* mode, double target, double seconds, double elapsed) {
+    unsigned long errors = stats.connect_failed + stats.no_reply + stats.timed_out + stats.bad_reply + stats.wrong_verdict;
+    unsigned long attempted = stats.issued + stats.not_issued;
+
+    qsort(latencies, latency_count, sizeof(uint64_t), compare_u64);
+    double mean = 0.0;
+    for (size_t i = 0; i < latency_count; i++) mean += latencies[i];
+    if (latency_count) mean /= latency_count;
+
+    if (strcmp(mode, "open") == 0) {
+        printf("Open loop at %.0f scans/s for %.1f s, %zu card readers, %zu doors\n", target, seconds, reader_count, door_count);
+    } else {
+        printf("Closed loop with %.0f scans in flight for %.1f s, %zu card readers, %zu doors\n", target, seconds, reader_count, door_count);
+    }
+    printf("scans issued: %lu, answered: %lu, not issued (client out of descriptors): %lu\n",
+           stats.issued, stats.completed, stats.not_issued);
+    printf("throughput: %.1f answered scans/s over %.3f s\n", elapsed > 0 ? stats.completed / elapsed : 0.0, elapsed);
+    printf("verdicts: ALLOWED %lu, DENIED %lu\n", stats.allowed, stats.denied);
+    printf("errors: %lu (%.2f%%): connect %lu, no reply %lu, timed out %lu, bad reply %lu, wrong verdict %lu\n",
+           errors, attempted ? 100.0 * (errors + stats.not_issued) / attempted : 0.0,
+           stats.connect_failed, stats.no_reply, stats.timed_out, stats.bad_reply, stats.wrong_verdict);
+    if (latency_count) {
+        printf("latency (us, from when the scan was due): min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+               latencies[0] / 1e3, mean / 1e3, percentile_us(50), percentile_us(90), percentile_us(99),
+               percentile_us(99.9), latencies[latency_count - 1] / 1e3);
+    }
+    printf("door side: %lu connections, OPEN %lu, CLOSE %lu\n",
+           atomic_load(&door_connections), atomic_load(&door_opens), atomic_load(&door_closes));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 8 || (strcmp(argv[6], "open") != 0 && strcmp(argv[6], "closed") != 0)) {
+        fprintf(stderr, "Usage: %s {overseer address:port} {authorisation file} {connections file} {card readers} {seconds} "
+                        "{open | closed} {scans per second | scans in flight} [door base port]\n", argv[0]);
+        return 1;
+    }
+
+    char* overseer_host = strtok(argv[1], ":");
+    char* overseer_port = strtok(NULL, ":");
+    size_t wanted = strtoul(argv[4], NULL, 10);
+    double seconds = atof(argv[5]);
+    const char* mode = argv[6];
+    double target = atof(argv[7]);
+    int base_port = argc > 8 ? atoi(argv[8]) : DEFAULT_DOOR_BASE_PORT;
+    if (!overseer_port || wanted == 0 || seconds <= 0 || target <= 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    memset(&overseer_addr, 0, sizeof(overseer_addr));
+    overseer_addr.sin_family = AF_INET;
+    overseer_addr.sin_port = htons(atoi(overseer_port));
+    if (inet_pton(AF_INET, overseer_host, &overseer_addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid overseer address\n");
+        return 1;
+    }
+
+    auth = auth_index_load(argv[2]);
+    routes = route_table_load(argv[3]);
+    if (!auth || !routes || collect_codes() == -1) {
+        return 1;
+    }
+    if (choose_readers(wanted) == -1) {
+        fprintf(stderr, "No card readers wired to doors in %s\n", argv[3]);
+        return 1;
+    }
+    if (reader_count < wanted) {
+        fprintf(stderr, "Only %zu card readers are wired to doors; using them all\n", reader_count);
+    }
+
+    int door_epoll;
+    pthread_t doors_thread;
+    if (start_doors(base_port, &door_epoll, &doors_thread) == -1 || register_devices() == -1) {
+        return 1;
+    }
+    usleep(200000); // let the overseer take in the registrations before the first scan
+
+    size_t max_inflight = raise_fd_limit();
+    int closed_loop = strcmp(mode, "closed") == 0;
+    size_t concurrency = closed_loop ? (size_t)target : 0;
+    if (closed_loop && concurrency > max_inflight) {
+        fprintf(stderr, "Limiting scans in flight to %zu (descriptor limit)\n", max_inflight);
+        concurrency = max_inflight;
+    }
+    uint64_t interval_ns = closed_loop ? 0 : (uint64_t)(1e9 / target);
+    if (!closed_loop && interval_ns == 0) interval_ns = 1;
+
+    // The tick paces the open loop and bounds every wait
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct itimerspec tick = { { 0, 200000 }, { 0, 200000 } };
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_fd == -1 || tick_fd == -1 || timerfd_settime(tick_fd, 0, &tick, NULL) == -1 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, tick_fd, &event) == -1) {
+        perror("Failed to set up scan loop");
+        return 1;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(seconds * 1e9);
+    uint64_t next_due = start;
+    uint64_t finished = 0;
+
+    while (1) {
+        uint64_t now = now_ns();
+        if (now < end) {
+            if (closed_loop) {
+                while (inflight < concurrency) start_scan(epoll_fd, now);
+            } else {
+                for (; next_due <= now && next_due < end; next_due += interval_ns) {
+                    if (inflight < max_inflight) {
+                        start_scan(epoll_fd, next_due);
+                    } else {
+                        stats.not_issued++;
+                    }
+                }
+            }
+        } else if (inflight == 0 || now > end + DRAIN_NS) {
+            finished = now;
+            break;
+        }
+        expire_scans(epoll_fd, now);
+
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.ptr == NULL) {
+                uint64_t ticks;
+                if (read(tick_fd, &ticks, sizeof(ticks)) == -1 && errno != EAGAIN) perror("timerfd read failed");
+            } else {
+                scan_event(epoll_fd, events[i].data.ptr);
+            }
+        }
+    }
+    if (!finished) finished = now_ns();
+
+    // Whatever is still in flight after the drain never got a verdict
+    while (inflight_head) {
+        end_scan(epoll_fd, inflight_head, &stats.timed_out);
+    }
+
+    report(mode, target, seconds, (finished - start) / 1e9);
+
+    atomic_store(&stop_doors, 1);
+    pthread_join(doors_thread, NULL);
+    close(tick_fd);
+    close(epoll_fd);
+    close(door_epoll);
+    auth_index_free(auth);
+    route_table_free(routes);
+    free(latencies);
+    free(codes);
+    free(readers);
+    free(doors);
+    return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -5,12 +6,11 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h> // for atoi function
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
 #include "overseer.h"
 
-#define MAX_DOORS 50
-#define MAX_CARD_READERS 50
-#define MAX_FIRE_ALARMS 50
-#define MAX_SIMULATORS 50
 #define MAX_TEMPSENSORS 50
 #define PORT 8080
 
@@ -23,10 +23,10 @@ char* layout_file;
 char* shared_memory_path;
 int shared_memory_offset;
 
-Door doors[MAX_DOORS];
-CardReader cardReaders[MAX_CARD_READERS];
-FireAlarm fireAlarms[MAX_FIRE_ALARMS];
-Simulator simulators[MAX_SIMULATORS];
+Registry door_registry;
+Registry cardreader_registry;
+Registry firealarm_registry;
+Registry simulator_registry;
 TempSensor tempSensors[MAX_TEMPSENSORS];
 
 struct SharedMemory {
@@ -41,6 +41,41 @@ struct SharedMemory shared_memory = {
     PTHREAD_COND_INITIALIZER, 
 };
 
+ReactorStats reactor_stats;
+WorkPool* scan_pool;
+DoorCycleEngine* cycle_engine;
+TimerWheel timer_wheel; // the process's one timerfd-driven timer service
+Timer fire_resend_timer;
+DoorSync* door_sync; // DOOR/DREG handshakes with the fire alarm units
+UdpBatch udp_batch;  // recvmmsg buffers of the UDP server thread
+atomic_ulong fire_fanout_calls;     // sendmmsg calls carrying FIRE datagrams
+atomic_ulong fire_fanout_datagrams; // FIRE datagrams they sent
+
+// FAIL_SAFE doors the fire alarms must know, versioned so a returning fire alarm only gets what it missed
+pthread_mutex_t fail_safe_lock = PTHREAD_MUTEX_INITIALIZER;
+DoorSet fail_safe_doors;
+uint64_t door_set_epoch; // tells this overseer's versions apart from a previous run's
+FireAlarmSync* fire_alarm_syncs;
+size_t fire_alarm_sync_count, fire_alarm_sync_capacity;
+
+static uint64_t elapsed_ns(const struct timespec* start, const struct timespec* end) {
+    return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000ULL + (end->tv_nsec - start->tv_nsec);
+}
+
+static void update_max(atomic_ulong* max, unsigned long value) {
+    unsigned long current = atomic_load_explicit(max, memory_order_relaxed);
+    while (value > current && !atomic_compare_exchange_weak_explicit(max, &current, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
 int init_overseer(const char* ip, int port) {
     int sockfd;
     struct sockaddr_in server_addr;
@@ -51,6 +86,10 @@ int init_overseer(const char* ip, int port) {
         return -1;
     }
 
+    // The overseer closes every client connection, so restarts would otherwise hit TIME_WAIT
+    int reuse = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = inet_addr(ip); // Use the given IP address
@@ -61,7 +100,7 @@ int init_overseer(const char* ip, int port) {
         return -1;
     }
 
-    if (listen(sockfd, 5) == -1) {
+    if (listen(sockfd, SOMAXCONN) == -1) {
         perror("Listen failed");
         return -1;
     }
@@ -108,220 +147,330 @@ int init_tcp_server(const char* address_port) {
 }
 
 void initialize_global_data() {
-    memset(doors, 0, sizeof(doors));
-    memset(cardReaders, 0, sizeof(cardReaders));
-    memset(fireAlarms, 0, sizeof(fireAlarms));
-    memset(simulators, 0, sizeof(simulators));
-    // Additional initialization code if necessary
+    if (registry_init(&door_registry, sizeof(Door), offsetof(Door, id)) == -1 ||
+        registry_init(&cardreader_registry, sizeof(CardReader), offsetof(CardReader, id)) == -1 ||
+        registry_init(&firealarm_registry, sizeof(FireAlarm), offsetof(FireAlarm, id)) == -1 ||
+        registry_init(&simulator_registry, sizeof(Simulator), offsetof(Simulator, id)) == -1 ||
+        doorset_init(&fail_safe_doors) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    door_set_epoch = ((uint64_t)now.tv_sec << 32 ^ (uint64_t)now.tv_nsec << 8 ^ (uint64_t)getpid()) | 1;
 }
 
 void* udp_server_thread(void* arg) {
-    int sockfd;
-    struct sockaddr_in server_addr, client_addr;
-    
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        perror("Error opening UDP socket");
+    UdpBatch* batch = arg;
+
+    while (1) {
+        int n = udp_batch_receive(batch);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("UDP receive failed");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            size_t len;
+            const struct sockaddr_in* client_addr;
+            char* buffer = udp_batch_datagram(batch, i, &len, &client_addr);
+            if (!buffer) {
+                continue;
+            }
+            if (len == sizeof(DoorDatagram) && strncmp(buffer, "DREG", 4) == 0) {
+                // Fire alarms confirm doors to the overseer's address
+                door_sync_ack(door_sync, client_addr, (DoorDatagram*)buffer);
+            } else if (len > 0) {
+                process_udp_message(buffer, len); // Function to handle the processing of the message
+            }
+        }
+    }
+    return NULL;
+}
+
+void* tcp_server_thread(void* arg) {
+    int sockfd = *(int*)arg;
+    struct epoll_event event, events[MAX_EPOLL_EVENTS];
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        perror("epoll_create1 failed");
         return NULL;
     }
 
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(PORT);
-    
-    if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Error binding UDP socket");
+    if (set_nonblocking(sockfd) == -1) {
+        perror("Failed to make listening socket non-blocking");
+        close(epoll_fd);
+        return NULL;
+    }
+
+    // The listener is the only registration with a NULL data pointer
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd, &event) == -1) {
+        perror("epoll_ctl listener failed");
+        close(epoll_fd);
         return NULL;
     }
 
     while (1) {
-        char buffer[1024];
-        socklen_t len = sizeof(client_addr);
-        int n = recvfrom(sockfd, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&client_addr, &len);
-        if (n > 0) {
-            buffer[n] = '\0'; // Ensure null-termination
-            process_udp_message(buffer); // Function to handle the processing of the message
+        int n = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        for (int i = 0; i < n; i++) {
+            Connection* conn = events[i].data.ptr;
+            if (conn == NULL) {
+                accept_connections(epoll_fd, sockfd, &now);
+            } else if (read_connection(conn)) {
+                close_connection(epoll_fd, conn);
+            }
         }
     }
+
+    close(epoll_fd);
     return NULL;
 }
 
-void* tcp_server_thread(void* arg) {
-    int sockfd = *(int*)arg;
-    int new_socket;
+void accept_connections(int epoll_fd, int listen_fd, const struct timespec* ready_at) {
     struct sockaddr_in client_addr;
-    socklen_t addr_len = sizeof(client_addr);
+    socklen_t addr_len;
+    struct epoll_event event;
 
+    // Edge-triggered: keep accepting until the backlog is empty
     while (1) {
-        new_socket = accept(sockfd, (struct sockaddr*)&client_addr, &addr_len);
+        addr_len = sizeof(client_addr);
+        int new_socket = accept4(listen_fd, (struct sockaddr*)&client_addr, &addr_len, SOCK_NONBLOCK);
         if (new_socket == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
             perror("Accept failed");
-            continue;
+            break;
         }
 
-        char buffer[1024] = {0};
-        ssize_t total_bytes_read = 0;
-        char current_byte;
-
-        // Read byte-by-byte to find the end of the message or till buffer is full
-        while (recv(new_socket, &current_byte, 1, 0) == 1) { 
-            if (current_byte == '#' || total_bytes_read >= sizeof(buffer) - 1) { 
-                break;
-            }
-            buffer[total_bytes_read] = current_byte;
-            total_bytes_read++;
+        Connection* conn = malloc(sizeof(Connection));
+        if (!conn) {
+            perror("Failed to allocate connection");
+            close(new_socket);
+            continue;
+        }
+        conn->fd = new_socket;
+        conn->frames = 0;
+        frame_reader_init(&conn->reader);
+        clock_gettime(CLOCK_MONOTONIC, &conn->accepted_at);
+
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_socket, &event) == -1) {
+            perror("epoll_ctl connection failed");
+            close(new_socket);
+            free(conn);
+            continue;
         }
-        buffer[total_bytes_read] = '\0'; 
 
-        if (strstr(buffer, "SCANNED") != NULL) {
-            ThreadArgs* args = malloc(sizeof(ThreadArgs));
-            // int new_socket_duplicate = dup(new_socket); // Duplicating the socket descriptor
-            // if(new_socket_duplicate == -1) {
-            //     perror("ERROR duplicating socket");
-            //     close(new_socket);
-            //     continue;
-            // }
-            args->socket = new_socket;
-            strncpy(args->message, buffer, sizeof(buffer));
+        uint64_t latency = elapsed_ns(ready_at, &conn->accepted_at);
+        atomic_fetch_add_explicit(&reactor_stats.accepted, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&reactor_stats.accept_latency_total_ns, latency, memory_order_relaxed);
+        update_max(&reactor_stats.accept_latency_max_ns, latency);
+        unsigned long active = atomic_fetch_add_explicit(&reactor_stats.active, 1, memory_order_relaxed) + 1;
+        update_max(&reactor_stats.peak_active, active);
 
-            pthread_t tid;
-            pthread_create(&tid, NULL, handle_scanned_message_thread, args);
-            pthread_detach(tid); 
-        } else if (total_bytes_read > 0) {
-            register_device(buffer);
+        // Data may already be queued; with EPOLLET we will not be told about it again
+        if (read_connection(conn)) {
+            close_connection(epoll_fd, conn);
         }
-
-        close(new_socket);
     }
-    return NULL;
 }
-// A basic structure for the function:
 
-void handle_scanned_message(int client_socket, char* message) {    
-    char reader[20], id[10], scanned[20], scanned_code[50];
-    sscanf(message, "%s %s %s %s", reader, id, scanned, scanned_code);
-    // Lookup scanned code in the 'authorisation.txt' file
-    char* access_list = lookup_authorisation(scanned_code); 
-    if (!access_list) {
-        // No entry found for the scanned code, access is denied
-        
-        send_command_to_reader(id, "DENIED#");
-        return;
+static void dispatch_frame(Connection* conn, char* frame, size_t len) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (conn->frames++ == 0) {
+        uint64_t latency = elapsed_ns(&conn->accepted_at, &now);
+        atomic_fetch_add_explicit(&reactor_stats.first_frame_total_ns, latency, memory_order_relaxed);
+        update_max(&reactor_stats.first_frame_max_ns, latency);
+        latency_record(STAGE_FRAME_RECEIVED, latency);
     }
-
-    // Lookup card reader's ID in the 'connections.txt' file
-    int int_reader_id = atoi(id);
-    int door_id = lookup_door_id(int_reader_id);
-    if (!door_id) {
-        // No door ID found for the card reader ID
-        send_command_to_reader(id, "DENIED#");
-        return;
+    atomic_fetch_add_explicit(&reactor_stats.frames, 1, memory_order_relaxed);
+
+    if (strstr(frame, "SCANNED") != NULL) {
+        WorkItem item;
+        // The job keeps its own descriptor so the reactor can close its copy straight away
+        item.socket = dup(conn->fd);
+        if (item.socket == -1) {
+            perror("ERROR duplicating socket");
+            return;
+        }
+        item.received_at = now;
+        strncpy(item.message, frame, sizeof(item.message) - 1);
+        item.message[sizeof(item.message) - 1] = '\0';
+
+        if (workpool_submit(scan_pool, &item) == -1) {
+            // Queue full: refuse the scan rather than let the backlog grow
+            send(item.socket, "DENIED#", 7, MSG_NOSIGNAL);
+            close(item.socket);
+        }
+    } else if (len > 0) {
+        register_device(frame);
     }
+}
 
-    char door_id_str[50]; // Ensure the buffer is large enough for the int and null terminator
-    sprintf(door_id_str, "%d", door_id);
-    if (has_access(access_list, door_id)) {
-        // Send the ALLOWED message
-        send_command_to_reader(id, "ALLOWED#");
-
-        // Connect to the door controller and send OPEN# command
-        send_command_to_door(door_id_str, "OPEN#");
-        int door_socket = get_door_sockfd(door_id_str);
-        char response[1024];
-        recv(door_socket, response, sizeof(response), 0);
-        if (strncmp(response, "OPENING#", 8) == 0) {
-            memset(response, 0, sizeof(response)); // Clear the buffer
-            recv(door_socket, response, sizeof(response), 0);
-            if (strncmp(response, "OPENED#", 7) == 0) {
-                
-                usleep(door_open_duration); // Wait for {door open duration} microseconds
-                
-                send_command_to_door(door_id_str, "CLOSE#");
-                close(door_socket);
+int read_connection(Connection* conn) {
+    char* frame;
+    size_t len;
+
+    while (1) {
+        ssize_t n = frame_reader_fill(&conn->reader, conn->fd);
+        if (n > 0) {
+            // Several frames may have arrived in one read
+            while ((frame = frame_reader_next(&conn->reader, &len)) != NULL) {
+                dispatch_frame(conn, frame, len);
             }
+        } else if (n == 0) {
+            // Peer closed: dispatch whatever arrived without a '#'
+            if ((frame = frame_reader_rest(&conn->reader, &len)) != NULL) {
+                dispatch_frame(conn, frame, len);
+            }
+            return 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return conn->frames > 0;
+        } else {
+            perror("recv failed");
+            return 1;
         }
-    } else {
-        // Access is denied
-        send_command_to_door(door_id_str, "DENIED#");
     }
 }
 
-int get_door_sockfd(const char* door_id) {
-    struct sockaddr_in door_address;
-    int sockfd;
-    
-    // Search for the door by id
-    for (int i = 0; strlen(doors[i].id) > 0; i++) {  // Use the actual number of doors here
-        if (strcmp(doors[i].id, door_id) == 0) {
-            // Found the door, now create the socket
-            sockfd = socket(AF_INET, SOCK_STREAM, 0);
-            if (sockfd == -1) {
-                perror("Could not create socket");
-                return -1;
-            }
-
-            door_address.sin_family = AF_INET;
-            door_address.sin_addr.s_addr = inet_addr(doors[i].address);
-            door_address.sin_port = htons(doors[i].port);
+void close_connection(int epoll_fd, Connection* conn) {
+    // A scan job may still hold a dup of this socket, and epoll only drops a
+    // registration once every descriptor for the socket is closed
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn);
+    atomic_fetch_sub_explicit(&reactor_stats.active, 1, memory_order_relaxed);
+}
 
-            //connect to the door
-            if (connect(sockfd, (struct sockaddr *)&door_address, sizeof(door_address)) < 0) {
-                perror("Connection failed");
-                close(sockfd);
-                return -1;
-            }
+void print_reactor_stats() {
+    unsigned long accepted = atomic_load(&reactor_stats.accepted);
+    unsigned long frames = atomic_load(&reactor_stats.frames);
+
+    printf("TCP front end:\n");
+    printf("  connections accepted: %lu, active: %lu, peak active: %lu\n",
+           accepted, atomic_load(&reactor_stats.active), atomic_load(&reactor_stats.peak_active));
+    printf("  frames dispatched: %lu\n", frames);
+    printf("  accept latency: avg %lu ns, max %lu ns\n",
+           accepted ? atomic_load(&reactor_stats.accept_latency_total_ns) / accepted : 0,
+           atomic_load(&reactor_stats.accept_latency_max_ns));
+    printf("  accept to first frame: avg %lu ns, max %lu ns\n",
+           accepted ? atomic_load(&reactor_stats.first_frame_total_ns) / accepted : 0,
+           atomic_load(&reactor_stats.first_frame_max_ns));
+}
+// A basic structure for the function:
 
-            return sockfd;
-        }
+static void reply_to_reader(int client_socket, const char* reply) {
+    if (client_socket < 0) return;
+    if (send(client_socket, reply, strlen(reply), MSG_NOSIGNAL) < 0) {
+        perror("Error replying to card reader");
     }
+    close(client_socket);
+}
 
-    printf("Door with id %s not found.\n", door_id);
-    return -1;
+void handle_scanned_job(WorkItem* item) {
+    handle_scanned_message(item->socket, item->message, &item->received_at);
 }
 
-char* lookup_authorisation(const char* scanned_code) {
-    FILE* file = fopen(auth_file, "r");
-    if (!file) {
-        perror("Failed to open authorisation.txt");
-        return NULL;
+WorkPool* create_scan_pool() {
+    size_t threads = WORKPOOL_DEFAULT_THREADS;
+    size_t capacity = WORKPOOL_DEFAULT_CAPACITY;
+    OverflowPolicy policy = WORKPOOL_REJECT;
+    char* value;
+
+    if ((value = getenv("OVERSEER_WORKERS")) && atoi(value) > 0) {
+        threads = atoi(value);
+    }
+    if ((value = getenv("OVERSEER_QUEUE_DEPTH")) && atoi(value) > 0) {
+        capacity = atoi(value);
     }
+    if ((value = getenv("OVERSEER_OVERFLOW")) && strcmp(value, "caller-runs") == 0) {
+        policy = WORKPOOL_CALLER_RUNS;
+    }
+
+    return workpool_create(threads, capacity, handle_scanned_job, policy);
+}
 
-    static char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        if (strstr(line, scanned_code) != NULL) {
-            fclose(file);
-            return line; 
+// Decide a scan against the current site data; returns the door to open, or -1 to deny
+static int decide_scan(const char* reader_id, const char* scanned_code) {
+    const SiteData* site = site_data_acquire();
+    int door_id = -1;
+
+    // Lookup scanned code in the authorisation index
+    uint64_t code;
+    const uint64_t* grants = NULL;
+    uint64_t start = latency_now_ns();
+    if (auth_parse_code(scanned_code, &code) == 0) {
+        grants = auth_index_lookup(site->auth, code);
+    }
+    uint64_t looked_up = latency_now_ns();
+    latency_record(STAGE_AUTH_LOOKUP, looked_up - start);
+
+    if (grants) {
+        // Route the card reader to its door, then check the card holds that door
+        int reader_door = lookup_door_id(atoi(reader_id));
+        latency_record(STAGE_ROUTE_LOOKUP, latency_now_ns() - looked_up);
+        if (reader_door >= 0 && auth_index_allows(site->auth, grants, AUTH_GRANT_DOOR, reader_door)) {
+            door_id = reader_door;
         }
     }
-    fclose(file);
-    return NULL;
+
+    site_data_release();
+    return door_id;
 }
 
-int lookup_door_id(int card_reader_id) {
-    FILE* file = fopen(connections_file, "r");
-    if (!file) {
-        perror("Failed to open connections file");
-        return -1;
+void handle_scanned_message(int client_socket, char* message, const struct timespec* received_at) {    
+    char reader[20], id[10], scanned[20], scanned_code[50];
+    if (sscanf(message, "%19s %9s %19s %49s", reader, id, scanned, scanned_code) != 4) {
+        reply_to_reader(client_socket, "DENIED#");
+        latency_record_since(STAGE_REPLY_SENT, received_at);
+        return;
     }
 
-    char line[256];
-    int door_id;
-    while (fgets(line, sizeof(line), file)) {
-        if (sscanf(line, "DOOR %d %d", &door_id, &card_reader_id) == 2) {
-            fclose(file);
-            return door_id;
-        }
+    int door_id = decide_scan(id, scanned_code);
+    if (door_id < 0) {
+        // Unknown card, unconnected reader or no grant for this door
+        reply_to_reader(client_socket, "DENIED#");
+        latency_record_since(STAGE_REPLY_SENT, received_at);
+        return;
     }
 
-    fclose(file);
-    return -1;
+    // Send the ALLOWED message
+    reply_to_reader(client_socket, "ALLOWED#");
+    latency_record_since(STAGE_REPLY_SENT, received_at);
+
+    char door_id_str[50]; // Ensure the buffer is large enough for the int and null terminator
+    sprintf(door_id_str, "%d", door_id);
+
+    // Hand the open/hold/close cycle to the cycle engine rather than sleeping through it here
+    Door door;
+    int slot = registry_find(&door_registry, door_id_str);
+    if (registry_get(&door_registry, slot, &door) == -1) {
+        fprintf(stderr, "Error: Door %s is not registered.\n", door_id_str);
+        return;
+    }
+    door_cycle_request(cycle_engine, slot, door.link, received_at);
 }
 
-int has_access(const char* access_data, int door_id) {
-    char door_str[16];
-    snprintf(door_str, sizeof(door_str), "DOOR:%d", door_id);
-    return strstr(access_data, door_str) != NULL;
+int lookup_door_id(int card_reader_id) {
+    const SiteData* site = site_data_acquire();
+    const Route* route = route_lookup(site->routes, ROUTE_DOOR, card_reader_id);
+    int door_id = route ? route->target : -1;
+    site_data_release();
+    return door_id;
 }
 
 int send_tcp_message(const char* address, int port, const char* message) {
@@ -361,19 +510,29 @@ int send_tcp_message(const char* address, int port, const char* message) {
     return bytes_sent;
 }
 
+// Copy a device ID into its record, refusing one the record (and the registry key) would cut short
+static int copy_device_id(char* id, size_t size, const char* token) {
+    if (strlen(token) >= size) {
+        fprintf(stderr, "Error: device ID %.20s... is longer than %zu characters, not registered\n", token, size - 1);
+        return 0;
+    }
+    strcpy(id, token);
+    return 1;
+}
+
 void register_device(char* msg) {
     char* token = strtok(msg, " ");
     if (!token) return;
 
     if (strcmp(token, "DOOR") == 0) {
-        Door door;
+        Door door = {0};
 
         token = strtok(NULL, " ");
-        if (token) strncpy(door.id, token, sizeof(door.id));
+        if (!token || !copy_device_id(door.id, sizeof(door.id), token)) return;
 
         token = strtok(NULL, " ");
         if (token) {
-            sscanf(token, "%[^:]:%d", door.address, &door.port);
+            sscanf(token, "%49[^:]:%d", door.address, &door.port);
         }
 
         memset(door.type, 0, sizeof(door.type));        
@@ -384,275 +543,266 @@ void register_device(char* msg) {
         }
     
         pthread_mutex_lock(&shared_memory.mutex);
-        find_or_add_door(door);
-        if (is_fire_alarm_registered() && strncmp(door.type, "FAIL_SAFE", 9) == 0) {
-            send_door_to_fire_alarm(door); //assuming you have a function to send door to fire alarm
-        }
+        int index = find_or_add_door(door);
         pthread_mutex_unlock(&shared_memory.mutex);
+        if (index != -1) {
+            repoint_door_link(index, &door);
+        }
+
+        if (index != -1 && strncmp(door.type, "FAIL_SAFE", 9) == 0) {
+            send_door_to_fire_alarm(door);
+        }
     }
     else if (strcmp(token, "CARDREADER") == 0) {
-        CardReader cardReader;
+        CardReader cardReader = {0};
 
         token = strtok(NULL, " ");
-        if (token) strncpy(cardReader.id, token, sizeof(cardReader.id));
+        if (!token || !copy_device_id(cardReader.id, sizeof(cardReader.id), token)) return;
         
         pthread_mutex_lock(&shared_memory.mutex);
         find_or_add_cardReader(cardReader);
         pthread_mutex_unlock(&shared_memory.mutex);
     }
     else if (strcmp(token, "FIREALARM") == 0) {
-        FireAlarm fireAlarm;
+        FireAlarm fireAlarm = {0};
         
         token = strtok(NULL, " ");
         if (token) {
-            char* address_token = strtok(token, ":");
-            if(address_token) strncpy(fireAlarm.address, address_token, sizeof(fireAlarm.address));
-            
-            char* port_token = strtok(NULL, ":");
-            if(port_token) fireAlarm.port = atoi(port_token);
+            sscanf(token, "%49[^:]:%d", fireAlarm.address, &fireAlarm.port);
+        }
+        // Fire alarms register without an ID, their address identifies them
+        char id[sizeof(fireAlarm.address) + 12];
+        snprintf(id, sizeof(id), "%s:%d", fireAlarm.address, fireAlarm.port);
+        if (!copy_device_id(fireAlarm.id, sizeof(fireAlarm.id), id)) return;
+
+        // FIREALARM {address:port} HELLO [{door set epoch}:{version}]
+        unsigned long long epoch = 0, version = 0;
+        token = strtok(NULL, " ");
+        token = token ? strtok(NULL, " ") : NULL;
+        if (token && sscanf(token, "%llx:%llu", &epoch, &version) != 2) {
+            epoch = version = 0;
         }
 
         pthread_mutex_lock(&shared_memory.mutex);
-        find_or_add_fireAlarm(fireAlarm);
-        send_all_saved_doors_to_firealarm();
+        int index = find_or_add_fireAlarm(fireAlarm);
         pthread_mutex_unlock(&shared_memory.mutex);
+        if (index == -1) return;
+
+        send_all_saved_doors_to_firealarm(&fireAlarm, epoch, version);
     }
 }
 
 int is_fire_alarm_registered() {
-    return (strlen(fireAlarms[0].address) > 0 );
+    return registry_count(&firealarm_registry) > 0;
 }
 
-void send_all_saved_doors_to_firealarm() {
-    int sockfd;
-    struct sockaddr_in fire_alarm_addr;
-    fd_set readfds;
-    struct timeval tv;
-
-    struct {
-        char header[4];
-        struct in_addr door_addr;
-        in_port_t door_port;
-    } door_datagram, confirmation_datagram;
-
-    //create socket
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd == -1) {
-        printf("Could not create socket\n");
-        return;
+// Sync state of the fire alarm at `addr`, created on first use; fail_safe_lock must be held
+static FireAlarmSync* fire_alarm_sync_for(const struct sockaddr_in* addr) {
+    for (size_t i = 0; i < fire_alarm_sync_count; i++) {
+        if (fire_alarm_syncs[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            fire_alarm_syncs[i].addr.sin_port == addr->sin_port) {
+            return &fire_alarm_syncs[i];
+        }
     }
-
-    //prepare the sockaddr_in structure for the fire alarm system
-    
-    fire_alarm_addr.sin_family = AF_INET;
-    fire_alarm_addr.sin_addr.s_addr = inet_addr("127.0.0.1"); //assuming fire alarm system IP address
-    fire_alarm_addr.sin_port = htons(8888); //assuming fire alarm system port
-
-    for (int i = 0; strlen(doors[i].id) > 0; i++) {
-        if (strncmp(doors[i].type, "FAIL_SAFE", 9) == 0) {
-            strcpy(door_datagram.header, "DOOR");
-            inet_aton(doors[i].address, &door_datagram.door_addr);
-            door_datagram.door_port = doors[i].port;
-
-            int sent = 0;
-            int retries = 3; // Adjust based on desired retries
-
-            while (retries > 0) {
-                // Send door data to the fire alarm system
-                if (sendto(sockfd, &door_datagram, sizeof(door_datagram), 0, (struct sockaddr *)&fire_alarm_addr, sizeof(fire_alarm_addr)) < 0) {
-                    puts("Send failed");
-                    return;
-                }
-
-                // Initialize select parameters
-                FD_ZERO(&readfds);
-                FD_SET(sockfd, &readfds);
-                tv.tv_sec = 0;
-                tv.tv_usec = datagram_resend_delay;
-
-                int retval = select(sockfd + 1, &readfds, NULL, NULL, &tv);
-                if (retval == -1) {
-                    perror("select()");
-                    return;
-                } else if (retval) {
-                    ssize_t len = recvfrom(sockfd, &confirmation_datagram, sizeof(confirmation_datagram), 0, NULL, NULL);
-                    if (len > 0 && strncmp(confirmation_datagram.header, "DREG", 4) == 0 &&
-                        confirmation_datagram.door_addr.s_addr == door_datagram.door_addr.s_addr &&
-                        confirmation_datagram.door_port == door_datagram.door_port) {
-                        sent = 1;
-                        break;
-                    }
-                }
-                retries--;
-            }
-
-            if (!sent) {
-                printf("Failed to get confirmation for door with ID %s after multiple attempts.\n", doors[i].id);
-            }
+    if (fire_alarm_sync_count == fire_alarm_sync_capacity) {
+        size_t capacity = fire_alarm_sync_capacity ? fire_alarm_sync_capacity * 2 : 4;
+        FireAlarmSync* grown = realloc(fire_alarm_syncs, capacity * sizeof(FireAlarmSync));
+        if (!grown) {
+            perror("Failed to track fire alarm");
+            return NULL;
         }
+        fire_alarm_syncs = grown;
+        fire_alarm_sync_capacity = capacity;
     }
-
-    close(sockfd);
+    FireAlarmSync* sync = &fire_alarm_syncs[fire_alarm_sync_count++];
+    memset(sync, 0, sizeof(*sync));
+    sync->addr = *addr;
+    return sync;
 }
 
-void send_door_to_fire_alarm(Door door) {
-    int sockfd;
-    struct sockaddr_in fire_alarm_addr;
-    char message[1024];
-    fd_set readfds;
-    struct timeval tv;
-
-    struct {
-        char header[4];
-        struct in_addr door_addr;
-        in_port_t door_port;
-    } door_datagram, confirmation_datagram;
-
-    //create socket
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd == -1) {
-        printf("Could not create socket");
-        return;
+// Tell a fire alarm which door set version it now holds; fail_safe_lock must be held
+static void send_door_set_version(const FireAlarmSync* sync) {
+    DoorSetVersion message = { .header = {'D', 'V', 'E', 'R'}, .epoch = door_set_epoch, .version = sync->target };
+    if (sendto(door_sync->sockfd, &message, sizeof(message), 0, (struct sockaddr*)&sync->addr, sizeof(sync->addr)) == -1) {
+        perror("DVER send failed");
     }
+}
 
-    //prepare the sockaddr_in structure for the fire alarm system
-    fire_alarm_addr.sin_family = AF_INET;
-    fire_alarm_addr.sin_addr.s_addr = inet_addr("127.0.0.1"); // assuming fire alarm system IP address
-    fire_alarm_addr.sin_port = htons(8888); // assuming fire alarm system port
-
-    //initialize the door_datagram
-    strcpy(door_datagram.header, "DOOR");
-    inet_aton(door.address, &door_datagram.door_addr);
-    door_datagram.door_port = door.port;
-
-    int sent = 0;
-    int retries = 3; //you can adjust this number based on how many retries you want.
-    while (retries > 0) {
-        //send door data to the fire alarm system
-        if (sendto(sockfd, &door_datagram, sizeof(door_datagram), 0, (struct sockaddr *)&fire_alarm_addr, sizeof(fire_alarm_addr)) < 0) {
-            puts("Send failed");
-            return;
-        }
-
-        // Initialize select parameters
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
-        tv.tv_sec = 0;
-        tv.tv_usec = datagram_resend_delay; // assuming datagram_resend_delay is globally defined
-
-        // Waiting for a response for the given delay
-        int retval = select(sockfd + 1, &readfds, NULL, NULL, &tv);
-
-        if (retval == -1) {
-            perror("select()");
-            return;
-        } else if (retval) {
-            // Data is available now
-            ssize_t len = recvfrom(sockfd, &confirmation_datagram, sizeof(confirmation_datagram), 0, NULL, NULL);
-            if (len > 0 && strncmp(confirmation_datagram.header, "DREG", 4) == 0 &&
-                confirmation_datagram.door_addr.s_addr == door_datagram.door_addr.s_addr &&
-                confirmation_datagram.door_port == door_datagram.door_port) {
-                sent = 1;
-                break;
-            }
+// One announced door has been settled for a fire alarm; once all are, it learns its version
+static void fire_alarm_door_settled(const struct sockaddr_in* fire_alarm, int confirmed) {
+    pthread_mutex_lock(&fail_safe_lock);
+    FireAlarmSync* sync = fire_alarm_sync_for(fire_alarm);
+    if (sync) {
+        if (!confirmed) sync->incomplete = 1;
+        if (sync->outstanding > 0) sync->outstanding--;
+        if (sync->outstanding == 0 && !sync->incomplete) {
+            send_door_set_version(sync);
         }
-        retries--;
     }
-
-    if (!sent) {
-        puts("Failed to get confirmation after multiple attempts.");
-    }
-
-    close(sockfd);
+    pthread_mutex_unlock(&fail_safe_lock);
 }
 
-void* handle_scanned_message_thread(void* arg) {
-    ThreadArgs* thread_args = (ThreadArgs*) arg;
-    handle_scanned_message(thread_args->socket, thread_args->message);
-    free(thread_args);  //important to free allocated memory
-    pthread_exit(NULL); //properly exit thread when done
+// Called by the door sync as each DOOR datagram is confirmed or given up on
+void on_door_synced(void* arg, const struct sockaddr_in* fire_alarm, const DoorDatagram* door, int confirmed) {
+    (void)arg;
+    (void)door;
+    fire_alarm_door_settled(fire_alarm, confirmed);
 }
 
-int find_or_add_door(Door new_door) {
-    for (int i = 0; strlen(doors[i].id) > 0; i++) {
-        if (strcmp(doors[i].id, new_door.id) == 0) {
-            doors[i] = new_door; 
-            return i;
-        }
+static void announce_to_fire_alarm(const struct sockaddr_in* fire_alarm, const DoorSetEntry* door) {
+    int queued = door_sync_announce(door_sync, fire_alarm, door->addr, door->port);
+    if (queued != 1) {
+        // Already pending (its result is counted once) or not queued at all
+        fire_alarm_door_settled(fire_alarm, queued == 0);
     }
+}
 
-    for (int i = 0; MAX_DOORS; i++) {
-        if (strlen(doors[i].id) == 0) { // Empty slot
-            doors[i] = new_door; // Add new
-            return i;
-        }
+void send_all_saved_doors_to_firealarm(const FireAlarm* fire_alarm, uint64_t epoch, uint64_t version) {
+    struct sockaddr_in fire_alarm_addr;
+    memset(&fire_alarm_addr, 0, sizeof(fire_alarm_addr));
+    fire_alarm_addr.sin_family = AF_INET;
+    fire_alarm_addr.sin_port = htons(fire_alarm->port);
+    inet_pton(AF_INET, fire_alarm->address, &fire_alarm_addr.sin_addr);
+
+    // Work out the delta and copy it out, so nothing is locked while queueing
+    pthread_mutex_lock(&fail_safe_lock);
+    FireAlarmSync* sync = fire_alarm_sync_for(&fire_alarm_addr);
+    size_t count = doorset_count(&fail_safe_doors);
+    size_t from = epoch == door_set_epoch && version <= count ? version : 0;
+    DoorSetEntry* delta = malloc((count - from + 1) * sizeof(DoorSetEntry));
+    if (!sync || !delta) {
+        pthread_mutex_unlock(&fail_safe_lock);
+        free(delta);
+        return;
+    }
+    for (size_t i = from; i < count; i++) {
+        delta[i - from] = *doorset_at(&fail_safe_doors, i);
     }
+    sync->target = count;
+    sync->incomplete = 0;
+    sync->outstanding += count - from;
+    if (sync->outstanding == 0) {
+        send_door_set_version(sync); // already up to date
+    }
+    pthread_mutex_unlock(&fail_safe_lock);
 
-    fprintf(stderr, "Error: Door storage full!\n");
-    return -1;
+    printf("Fire alarm %s:%d is at door set version %zu of %zu: announcing %zu FAIL_SAFE doors\n",
+           fire_alarm->address, fire_alarm->port, from, count, count - from);
+    for (size_t i = 0; i < count - from; i++) {
+        announce_to_fire_alarm(&fire_alarm_addr, &delta[i]);
+    }
+    free(delta);
 }
 
-int find_or_add_cardReader(CardReader new_cardReader) {
-    for (int i = 0; i < MAX_CARD_READERS; i++) {
-        if (strcmp(cardReaders[i].id, new_cardReader.id) == 0) {
-            cardReaders[i] = new_cardReader;
-            return i;
-        }
+void send_door_to_fire_alarm(Door door) {
+    DoorSetEntry entry = { .port = door.port };
+    if (inet_aton(door.address, &entry.addr) == 0) {
+        fprintf(stderr, "Door %s: invalid address %s\n", door.id, door.address);
+        return;
     }
 
-    for (int i = 0; i < MAX_CARD_READERS; i++) {
-        if (strlen(cardReaders[i].id) == 0) {
-            cardReaders[i] = new_cardReader;
-            return i;
-        }
+    pthread_mutex_lock(&fail_safe_lock);
+    int added = doorset_add(&fail_safe_doors, entry.addr, entry.port);
+    size_t alarms = added == 1 ? fire_alarm_sync_count : 0;
+    struct sockaddr_in* targets = malloc((alarms + 1) * sizeof(struct sockaddr_in));
+    if (!targets) alarms = 0;
+    for (size_t i = 0; i < alarms; i++) {
+        fire_alarm_syncs[i].target = doorset_count(&fail_safe_doors);
+        fire_alarm_syncs[i].outstanding++;
+        targets[i] = fire_alarm_syncs[i].addr;
     }
+    pthread_mutex_unlock(&fail_safe_lock);
 
-    fprintf(stderr, "Error: CardReader storage full!\n");
-    return -1;
+    // A door already in the set (re-registered at the same address) is already known to every fire alarm
+    for (size_t i = 0; i < alarms; i++) {
+        announce_to_fire_alarm(&targets[i], &entry);
+    }
+    free(targets);
+}
 
+void print_fire_alarm_sync() {
+    pthread_mutex_lock(&fail_safe_lock);
+    printf("FAIL_SAFE door set %016llx, version %zu\n", (unsigned long long)door_set_epoch, doorset_count(&fail_safe_doors));
+    for (size_t i = 0; i < fire_alarm_sync_count; i++) {
+        char address[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &fire_alarm_syncs[i].addr.sin_addr, address, sizeof(address));
+        printf("  fire alarm %s:%d: syncing to version %llu, %zu doors outstanding%s\n", address,
+               ntohs(fire_alarm_syncs[i].addr.sin_port), (unsigned long long)fire_alarm_syncs[i].target,
+               fire_alarm_syncs[i].outstanding, fire_alarm_syncs[i].incomplete ? ", some unconfirmed" : "");
+    }
+    pthread_mutex_unlock(&fail_safe_lock);
 }
 
-int find_or_add_fireAlarm(FireAlarm new_fireAlarm) {
-    for (int i = 0; i < MAX_FIRE_ALARMS; i++) {
-        if (strcmp(fireAlarms[i].id, new_fireAlarm.id) == 0) {
-            fireAlarms[i] = new_fireAlarm;
-            return i;
-        }
+// Insert or overwrite a record by ID, returning its interned registry ID
+static int find_or_add(Registry* registry, const char* id, const void* record, const char* kind) {
+    int index = registry_find_or_insert(registry, id, NULL);
+    if (index == -1) {
+        fprintf(stderr, "Error: %s %s could not be registered\n", kind, id);
+        return -1;
     }
+    registry_set(registry, index, record);
+    return index;
+}
 
-    for (int i = 0; i < MAX_FIRE_ALARMS; i++) {
-        if (strlen(fireAlarms[i].id) == 0) {
-            fireAlarms[i] = new_fireAlarm;
-            return i;
-        }
+int find_or_add_door(Door new_door) {
+    int index = registry_find_or_insert(&door_registry, new_door.id, NULL);
+    if (index == -1) {
+        fprintf(stderr, "Error: Door %s could not be registered\n", new_door.id);
+        return -1;
     }
 
-    fprintf(stderr, "Error: FireAlarm storage full!\n");
-    return -1;
+    registry_write_lock(&door_registry);
+    Door* door = registry_at(&door_registry, index);
+    DoorLink* link = door->link;
+    *door = new_door;
+    door->link = link ? link : door_link_create(new_door.id, new_door.address, new_door.port);
+    registry_unlock(&door_registry);
+    return index;
 }
 
-int find_or_add_simulator(Simulator new_simulator) {
-    for (int i = 0; i < MAX_SIMULATORS; i++) {
-        if (strcmp(simulators[i].id, new_simulator.id) == 0) {
-            simulators[i] = new_simulator;
-            return i;
-        }
+void repoint_door_link(int index, const Door* door) {
+    Door current;
+    if (registry_get(&door_registry, index, &current) == 0 && current.link) {
+        door_link_set_address(current.link, door->address, door->port);
     }
+}
 
-    for (int i = 0; i < MAX_SIMULATORS; i++) {
-        if (strlen(simulators[i].id) == 0) {
-            simulators[i] = new_simulator;
-            return i;
-        }
-    }
+int find_or_add_cardReader(CardReader new_cardReader) {
+    return find_or_add(&cardreader_registry, new_cardReader.id, &new_cardReader, "CardReader");
+}
+
+int find_or_add_fireAlarm(FireAlarm new_fireAlarm) {
+    return find_or_add(&firealarm_registry, new_fireAlarm.id, &new_fireAlarm, "FireAlarm");
+}
 
-    fprintf(stderr, "Error: Simulator storage full!\n");
-    return -1;
+int find_or_add_simulator(Simulator new_simulator) {
+    return find_or_add(&simulator_registry, new_simulator.id, &new_simulator, "Simulator");
 }
 
 void cleanup_resources() {
     // Code to free up any dynamically allocated memory or resources
     // For example, closing any remaining socket connections
+    if (scan_pool) {
+        workpool_destroy(scan_pool);
+        scan_pool = NULL;
+    }
+    // After the pool, so no worker is still queueing cycles
+    if (cycle_engine) {
+        door_cycle_engine_destroy(cycle_engine);
+        cycle_engine = NULL;
+    }
+    if (door_sync) {
+        door_sync_destroy(door_sync);
+        door_sync = NULL;
+    }
+    // After the sync, whose results update the fire alarm sync state
+    doorset_free(&fail_safe_doors);
+    free(fire_alarm_syncs);
+    fire_alarm_syncs = NULL;
+    fire_alarm_sync_count = fire_alarm_sync_capacity = 0;
+    // Last: everything above arms timers on it
+    timer_cancel_sync(&timer_wheel, &fire_resend_timer);
+    timer_wheel_destroy(&timer_wheel);
 }
 
 void manual_access() {
@@ -683,10 +833,8 @@ void manual_access() {
             close_door(door_id);
         } 
         else if (strcmp(command, "FIRE ALARM") == 0) {
-            while (1) {
-                send_udp_datagram_to_fire_alarm_unit(); 
-                usleep(datagram_resend_delay);
-            }
+            // Send now and then every {datagram resend delay} from the timer thread
+            timer_arm(&timer_wheel, &fire_resend_timer, 0, datagram_resend_delay);
         }
         else if (strcmp(command, "SECURITY ALARM") == 0) {
             raise_security_alarm();
@@ -694,6 +842,52 @@ void manual_access() {
         else if (strcmp(command, "TEMPSENSOR LIST") == 0) {
             display_temperature_sensors();
         }
+        else if (strcmp(command, "TCP STATS") == 0) {
+            print_reactor_stats();
+        }
+        else if (strcmp(command, "RELOAD STATUS") == 0) {
+            site_data_print_status();
+        }
+        else if (strcmp(command, "RELOAD") == 0) {
+            long version = site_data_reload();
+            if (version > 0) {
+                printf("Reloaded authorisation and connections data (version %ld)\n", version);
+            }
+        }
+        else if (strcmp(command, "ROUTES") == 0) {
+            const SiteData* site = site_data_acquire();
+            route_table_dump(site->routes, stdout);
+            site_data_release();
+        }
+        else if (strcmp(command, "DOOR STATS") == 0) {
+            print_door_link_stats();
+        }
+        else if (strcmp(command, "POOL STATS") == 0) {
+            workpool_print_stats(scan_pool);
+        }
+        else if (strcmp(command, "CYCLE STATS") == 0) {
+            door_cycle_print_stats(cycle_engine);
+        }
+        else if (strcmp(command, "SYNC STATS") == 0) {
+            door_sync_print_stats(door_sync);
+            print_fire_alarm_sync();
+        }
+        else if (strcmp(command, "UDP STATS") == 0) {
+            udp_batch_print_stats(&udp_batch, stdout, "Overseer");
+            printf("Overseer FIRE fan-out: %lu datagrams in %lu sendmmsg calls\n",
+                   atomic_load_explicit(&fire_fanout_datagrams, memory_order_relaxed),
+                   atomic_load_explicit(&fire_fanout_calls, memory_order_relaxed));
+        }
+        else if (strcmp(command, "TIMER STATS") == 0) {
+            timer_wheel_print_stats(&timer_wheel);
+        }
+        else if (strcmp(command, "STATS") == 0) {
+            latency_print(stdout);
+        }
+        else if (strcmp(command, "STATS RESET") == 0) {
+            latency_reset();
+            printf("Latency histograms cleared\n");
+        }
         else if (strcmp(command, "EXIT") == 0) {
             running = 0;
         } 
@@ -706,47 +900,70 @@ void manual_access() {
 void list_doors() {
     printf("List of Doors:\n");
     printf("ID\tIP Address\tPort\tType\n");
-    for (int i = 0; strlen(doors[i].id) > 0; i++) {
-        printf("%s\t%s\t%d\t%s \n", doors[i].id, doors[i].address, doors[i].port, doors[i].type);
+    registry_read_lock(&door_registry);
+    for (size_t i = 0; i < door_registry.count; i++) {
+        Door* door = registry_at(&door_registry, i);
+        printf("%s\t%s\t%d\t%s \n", door->id, door->address, door->port, door->type);
     }
+    registry_unlock(&door_registry);
 }
 
 void open_door(char* door_id) {
-    send_command_to_door(door_id, "OPEN#");
+    char reply[DOOR_REPLY_SIZE];
+    if (send_command_to_door(door_id, "OPEN#", reply, sizeof(reply)) == 0) {
+        printf("Door %s: %s\n", door_id, reply);
+    }
 }
 
 void close_door(char* door_id) {
-    send_command_to_door(door_id, "CLOSE#");
+    char reply[DOOR_REPLY_SIZE];
+    if (send_command_to_door(door_id, "CLOSE#", reply, sizeof(reply)) == 0) {
+        printf("Door %s: %s\n", door_id, reply);
+    }
 }
 
-void process_udp_message(char* msg) {
-    struct datagram_format datagram;
-    memcpy(&datagram, msg, sizeof(datagram));
-    update_temperature(&datagram);
+void print_door_link_stats() {
+    printf("ID\tLink\tCmds\tDials\tFails\tReuse\tRTTs\tLast(us)\tAvg(us)\tMax(us)\n");
+    Door door;
+    for (int i = 0; registry_get(&door_registry, i, &door) == 0; i++) {
+        if (door.link) {
+            door_link_print_stats(door.link);
+        }
+    }
+}
 
+void process_udp_message(const char* msg, size_t len) {
+    TempReading reading;
+    if (temp_wire_decode(msg, len, &reading) == 0) {
+        update_temperature(&reading);
+    }
 }
 
-void update_temperature(struct datagram_format *datagram) {
-    for (int i = 0; i < datagram->address_count; i++) {
+void update_temperature(const TempReading *reading) {
+    struct timeval timestamp;
+    timestamp.tv_sec = reading->timestamp_us / 1000000;
+    timestamp.tv_usec = reading->timestamp_us % 1000000;
+
+    for (int i = 0; i < reading->address_count; i++) {
         char address[50];
-        int port = ntohs(datagram->address_list[i].sensor_port);
-        inet_ntop(AF_INET, &datagram->address_list[i].sensor_addr, address, sizeof(address));
+        int port = ntohs(reading->addresses[i].sensor_port);
+        inet_ntop(AF_INET, &reading->addresses[i].sensor_addr, address, sizeof(address));
         
         //find the matching sensor or an empty slot
         int j;
         for (j = 0; j < MAX_TEMPSENSORS; j++) {
             if (strcmp(tempSensors[j].address, address) == 0 && tempSensors[j].port == port) {
-                if (timercmp(&datagram->timestamp, &tempSensors[j].timestamp, >)) {
-                    tempSensors[j].temp = datagram->temperature;
-                    tempSensors[j].timestamp = datagram->timestamp;
+                if (timercmp(&timestamp, &tempSensors[j].timestamp, >)) {
+                    tempSensors[j].temp = reading->temperature;
+                    tempSensors[j].timestamp = timestamp;
                 }
                 break;
             } else if (strlen(tempSensors[j].id) == 0) {  //empty slot
-                strncpy(tempSensors[j].id, (char *)&datagram->id, sizeof(tempSensors[j].id));
+                snprintf(tempSensors[j].id, sizeof(tempSensors[j].id), "%u", reading->id);
                 strncpy(tempSensors[j].address, address, sizeof(tempSensors[j].address));
                 tempSensors[j].port = port;
-                tempSensors[j].temp = datagram->temperature;
-                tempSensors[j].timestamp = datagram->timestamp;
+                tempSensors[j].temp = reading->temperature;
+                tempSensors[j].timestamp = timestamp;
                 break;
             }
         }
@@ -771,29 +988,31 @@ void process_received_message(char* msg, char* source_address, int source_port)
     // Add more conditions to handle other types of messages
 }
 
-void send_command_to_door(char* door_id, char* command) {
-    for (int i = 0; strlen(doors[i].id) > 0; i++) {
-        if (strcmp(doors[i].id, door_id) == 0) {
-            // Assume send_tcp_message() is a function that sends a TCP message to a specific address and port
-            send_tcp_message(doors[i].address, doors[i].port, command);
-            return;
-        }
+int send_command_to_door(const char* door_id, const char* command, char* reply, size_t reply_size) {
+    Door door;
+    if (registry_get(&door_registry, registry_find(&door_registry, door_id), &door) == -1 || !door.link) {
+        fprintf(stderr, "Error: Door not found.\n");
+        return -1;
     }
-    fprintf(stderr, "Error: Door not found.\n");
+    // Links are never freed, so the command runs without holding the registry
+    return door_link_command(door.link, command, reply, reply_size);
 }
 
 void send_command_to_reader(char* reader_id, char* command) {
-    for (int i = 0; strlen(cardReaders[i].id) > 0; i++) {
-        if (strcmp(cardReaders[i].id, reader_id) == 0) {
-            // Assume send_tcp_message() is a function that sends a TCP message to a specific address and port
-            send_tcp_message(cardReaders[i].address, cardReaders[i].port, command);
-            return;
-        }
+    CardReader cardReader;
+    if (registry_get(&cardreader_registry, registry_find(&cardreader_registry, reader_id), &cardReader) == 0) {
+        send_tcp_message(cardReader.address, cardReader.port, command);
+        return;
     }
-    fprintf(stderr, "Error: Door not found.\n");
+    fprintf(stderr, "Error: Card reader not found.\n");
 }
 
 
+void send_fire_alarm_resend(void* arg) {
+    (void)arg;
+    send_udp_datagram_to_fire_alarm_unit();
+}
+
 void send_udp_datagram_to_fire_alarm_unit() {
     int sockfd;
     struct sockaddr_in servaddr;
@@ -808,20 +1027,25 @@ void send_udp_datagram_to_fire_alarm_unit() {
 
     memset(&servaddr, 0, sizeof(servaddr));
 
-    // Iterate through all fire alarms and send the datagram
-    for (int i = 0; i < MAX_FIRE_ALARMS; i++) {
-        // If the fire alarm ID is empty, it's likely the end of the registered alarms
-        if (strlen(fireAlarms[i].id) == 0) {
-            break;
-        }
-
+    // Every fire alarm gets the same four bytes: one sendmmsg per UDP_FANOUT_DEFAULT_SIZE of them
+    UdpFanout fanout;
+    if (udp_fanout_init(&fanout, sockfd, UDP_FANOUT_DEFAULT_SIZE) == -1) {
+        close(sockfd);
+        return;
+    }
+    struct iovec iov = { datagram, sizeof(datagram) };
+    FireAlarm fireAlarm;
+    for (int i = 0; registry_get(&firealarm_registry, i, &fireAlarm) == 0; i++) {
         servaddr.sin_family = AF_INET;
-        servaddr.sin_port = htons(fireAlarms[i].port);
-        inet_pton(AF_INET, fireAlarms[i].address, &(servaddr.sin_addr));
-
-        sendto(sockfd, datagram, sizeof(datagram), 0, (struct sockaddr*)&servaddr, sizeof(servaddr));
+        servaddr.sin_port = htons(fireAlarm.port);
+        inet_pton(AF_INET, fireAlarm.address, &(servaddr.sin_addr));
+        udp_fanout_add(&fanout, &servaddr, &iov, 1);
     }
+    udp_fanout_flush(&fanout);
+    atomic_fetch_add_explicit(&fire_fanout_calls, fanout.calls, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fire_fanout_datagrams, fanout.datagrams, memory_order_relaxed);
 
+    udp_fanout_free(&fanout);
     close(sockfd);
 }
 
@@ -838,10 +1062,11 @@ void raise_security_alarm() {
     // Signal the condition variable
     pthread_cond_signal(&shared_memory.cond);
 
-    // Loop through every FAIL_SECURE door
-    for (int i = 0; strlen(doors[i].id) > 0; i++) {
-        if (strcmp(doors[i].type, "FAIL_SECURE") == 0) {
-            send_tcp_message(doors[i].address, doors[i].port, "CLOSE_SECURE#");
+    // Loop through every FAIL_SECURE door, copying each out so no command runs under the registry lock
+    Door door;
+    for (int i = 0; registry_get(&door_registry, i, &door) == 0; i++) {
+        if (strcmp(door.type, "FAIL_SECURE") == 0 && door.link) {
+            door_link_command(door.link, "CLOSE_SECURE#", NULL, 0);
         }
     }
 }
@@ -878,6 +1103,43 @@ int main(int argc, char *argv[]) {
     // Initialize global data structures and mutexes
     initialize_global_data();
 
+    // Authorisation and connections are loaded once, then reloaded whenever either file changes
+    if (site_data_init(auth_file, connections_file) == -1) {
+        fprintf(stderr, "Failed to load %s and %s\n", auth_file, connections_file);
+        return 1;
+    }
+    site_data_watch();
+
+    // One timer service for the whole process; tick no coarser than the datagram resend delay
+    unsigned int tick_us = TIMER_DEFAULT_TICK_US;
+    if (datagram_resend_delay > 0 && datagram_resend_delay < TIMER_DEFAULT_TICK_US) {
+        tick_us = datagram_resend_delay;
+    }
+    if (timer_wheel_init(&timer_wheel, tick_us) == -1 || timer_wheel_start(&timer_wheel) == -1) {
+        fprintf(stderr, "Failed to start the timer service\n");
+        return 1;
+    }
+    timer_init(&fire_resend_timer, send_fire_alarm_resend, NULL);
+
+    door_sync = door_sync_create(&timer_wheel, datagram_resend_delay, DOOR_ANNOUNCE_ATTEMPTS, DOOR_SYNC_DEFAULT_WINDOW,
+                                 on_door_synced, NULL);
+    if (!door_sync) {
+        fprintf(stderr, "Failed to start the fire alarm door sync\n");
+        return 1;
+    }
+
+    cycle_engine = door_cycle_engine_create(door_open_duration, &timer_wheel);
+    if (!cycle_engine) {
+        fprintf(stderr, "Failed to start the door cycle engine\n");
+        return 1;
+    }
+
+    scan_pool = create_scan_pool();
+    if (!scan_pool) {
+        fprintf(stderr, "Failed to start the scan worker pool\n");
+        return 1;
+    }
+
     // Initialize TCP and UDP servers
     int tcp_sockfd = init_tcp_server(address_port);
     int udp_sockfd = init_udp_server(address_port);
@@ -886,11 +1148,14 @@ int main(int argc, char *argv[]) {
         perror("Server initialization failed");
         return 1;
     }
+    if (udp_batch_init(&udp_batch, udp_sockfd, udp_batch_size_from_env("OVERSEER_UDP_BATCH"), UDP_DATAGRAM_MAX) == -1) {
+        return 1;
+    }
 
     // Create threads for TCP and UDP servers
     pthread_t tcp_thread, udp_thread;
     pthread_create(&tcp_thread, NULL, tcp_server_thread, &tcp_sockfd);
-    pthread_create(&udp_thread, NULL, udp_server_thread, &udp_sockfd);
+    pthread_create(&udp_thread, NULL, udp_server_thread, &udp_batch);
 
     // Command-line interface for manual commands
     manual_access();
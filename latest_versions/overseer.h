@@ -5,21 +5,54 @@
 #include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "frame.h"
+#include "workpool.h"
+#include "doorpool.h"
+#include "sitedata.h"
+#include "registry.h"
+#include "doorcycle.h"
+#include "timerwheel.h"
+#include "latency.h"
+#include "doorsync.h"
+#include "doorset.h"
+#include "udpbatch.h"
+#include "tempwire.h"
+#include "udpfanout.h"
 
-#define MAX_DOORS 50
-#define MAX_CARD_READERS 50
 #define PORT 8080
+#define UDP_DATAGRAM_MAX 1024 // larger datagrams are dropped by the UDP server
+#define MAX_EPOLL_EVENTS 256
+#define DOOR_ANNOUNCE_ATTEMPTS 3
 
+// Per-connection read state owned by the TCP reactor
 typedef struct {
-    int socket;
-    char message[1024];
-} ThreadArgs;
+    int fd;
+    struct timespec accepted_at;
+    int frames; // number of frames already dispatched on this connection
+    FrameReader reader;
+} Connection;
+
+// Counters for the TCP front end, written by the reactor and read by the CLI
+typedef struct {
+    atomic_ulong accepted;
+    atomic_ulong active;
+    atomic_ulong peak_active;
+    atomic_ulong frames;
+    atomic_ulong accept_latency_total_ns; // listener readiness -> accept() returned
+    atomic_ulong accept_latency_max_ns;
+    atomic_ulong first_frame_total_ns;    // accept() -> first complete frame
+    atomic_ulong first_frame_max_ns;
+} ReactorStats;
 
 typedef struct {
     char id[50];
     char address[50];
     int port;
     char type[15]; 
+    DoorLink* link; // pooled connection, created on first registration and never freed
 } Door;
 
 typedef struct {
@@ -40,6 +73,14 @@ typedef struct {
     int port;
 } Simulator;
 
+// How far one fire alarm is through the FAIL_SAFE door set, guarded by fail_safe_lock
+typedef struct {
+    struct sockaddr_in addr;
+    uint64_t target;    // door set version the fire alarm holds once everything outstanding is confirmed
+    size_t outstanding; // doors announced and not yet confirmed or given up on
+    int incomplete;     // a door went unconfirmed: do not tell the fire alarm it is up to date
+} FireAlarmSync;
+
 typedef struct {
     int temp;
     struct timeval timestamp;
@@ -55,20 +96,6 @@ struct temperature_entry {
     float temperature;
 };
 
-struct addr_entry {
-    struct in_addr sensor_addr;
-    in_port_t sensor_port;
-};
-
-struct datagram_format {
-    char header[4]; // {'T', 'E', 'M', 'P'}
-    struct timeval timestamp;
-    float temperature;
-    uint16_t id;
-    uint8_t address_count;
-    struct addr_entry address_list[50];
-};
-
 /**
  * Initialize the overseer listening on the specified port.
  * @param port The port to listen on.
@@ -84,6 +111,31 @@ int init_overseer(const char* ip, int port);
  */
 void* tcp_server_thread(void* arg);
 
+/**
+ * Accept every pending connection on the (non-blocking) listening socket
+ * and add it to the reactor's epoll set.
+ * @param epoll_fd The reactor's epoll descriptor.
+ * @param listen_fd The listening socket.
+ * @param ready_at When epoll reported the listener readable.
+ */
+void accept_connections(int epoll_fd, int listen_fd, const struct timespec* ready_at);
+
+/**
+ * Drain a readable connection and dispatch every complete '#' frame.
+ * Clients send one burst per connection, so the connection is finished
+ * once the socket is drained and at least one frame was dispatched.
+ * @param conn The connection's read state.
+ * @return 1 if the connection is finished and should be closed, 0 otherwise.
+ */
+int read_connection(Connection* conn);
+
+/**
+ * Remove a connection from the reactor's epoll set, close it and free it.
+ */
+void close_connection(int epoll_fd, Connection* conn);
+
+void print_reactor_stats();
+
 /**
  * Register a door with the provided message. The message should contain 
  * the necessary details about the door.
@@ -92,12 +144,19 @@ void* tcp_server_thread(void* arg);
 void register_door(char* msg);
 
 /**
- * Find or add a door to the list of tracked doors. 
+ * Find or add a door in the door registry, keeping its pooled connection.
  * @param new_door The door details.
- * @return The index at which the door was added or found, -1 if an error occurred.
+ * @return The door's interned registry ID, -1 if the registry could not grow.
  */
 int find_or_add_door(Door new_door);
 
+/**
+ * Point a registered door's pooled connection at the address it registered
+ * with. Never waits for a command in progress on the link.
+ * @param index The door's interned registry ID.
+ */
+void repoint_door_link(int index, const Door* door);
+
 void register_device(char* msg);
 
 int find_or_add_cardReader(CardReader cardReader);
@@ -106,11 +165,19 @@ int find_or_add_fireAlarm(FireAlarm fireAlarm);
 
 int find_or_add_simulator(Simulator simulator);
 
+/**
+ * Receive datagrams on the overseer's UDP socket a batch at a time and dispatch them.
+ * @param arg The UdpBatch set up on that socket.
+ */
 void* udp_server_thread(void* arg);
 
 void cleanup_resources();
 
-void process_udp_message(char* msg);
+/**
+ * Handle a datagram that is not a door confirmation: TEMP readings update the sensor table.
+ * @param len Bytes received; the datagram is validated against it and read in place.
+ */
+void process_udp_message(const char* msg, size_t len);
 
 void command_line_interface();
 
@@ -124,21 +191,67 @@ int init_tcp_server(const char* address_port);
 
 void register_fire_alarm(char* msg);
 
-void send_all_saved_doors_to_firealarm();
+/**
+ * Queue the FAIL_SAFE doors a newly registered fire alarm is missing.
+ * Returns at once; the door sync sends, resends and matches the DREGs,
+ * and the fire alarm is sent a DVER once it holds the whole set.
+ * @param epoch The door set epoch from the fire alarm's HELLO, 0 if it sent none.
+ * @param version The door set version it holds for that epoch; only later doors are sent.
+ */
+void send_all_saved_doors_to_firealarm(const FireAlarm* fire_alarm, uint64_t epoch, uint64_t version);
 
+/**
+ * Add a FAIL_SAFE door to the versioned door set and, if it is new,
+ * queue it for every registered fire alarm.
+ */
 void send_door_to_fire_alarm(Door door);
 
+void on_door_synced(void* arg, const struct sockaddr_in* fire_alarm, const DoorDatagram* door, int confirmed);
+
+void print_fire_alarm_sync();
+
 int is_fire_alarm_registered();
 
-void handle_scanned_message(int client_socket, char* message);
+/**
+ * Decide a SCANNED request and answer the card reader on its own connection.
+ * @param client_socket The reader's connection; closed once the reply is sent.
+ * @param message The frame, without its '#'.
+ * @param received_at When the frame was read, for the latency histograms.
+ */
+void handle_scanned_message(int client_socket, char* message, const struct timespec* received_at);
+
+/**
+ * Worker pool entry point for a queued SCANNED frame.
+ */
+void handle_scanned_job(WorkItem* item);
 
-char* lookup_authorisation(const char* scanned_code);
+/**
+ * Size the scan worker pool from OVERSEER_WORKERS, OVERSEER_QUEUE_DEPTH and
+ * OVERSEER_OVERFLOW (reject | caller-runs), falling back to the defaults.
+ * Any worker count is accepted; past MAX_READER_THREADS readers the extra
+ * workers read the site data through a shared lock rather than lock-free.
+ * @return The started pool, or NULL on failure.
+ */
+WorkPool* create_scan_pool();
 
+/**
+ * Route a card reader to the door it controls.
+ * @param card_reader_id The reader's ID.
+ * @return The door ID, or -1 if the reader is not connected to a door.
+ */
 int lookup_door_id(int card_reader_id);
 
-int has_access(const char* access_data, int door_id);
+/**
+ * Send a command over the door's pooled connection and wait for its final reply.
+ * @param door_id The registered door ID.
+ * @param command The command frame, e.g. "OPEN#".
+ * @param reply Receives the final reply without its '#' (may be NULL).
+ * @param reply_size Size of the reply buffer.
+ * @return 0 if the door answered, -1 otherwise.
+ */
+int send_command_to_door(const char* door_id, const char* command, char* reply, size_t reply_size);
 
-void send_command_to_door(char* door_id, char* command);
+void print_door_link_stats();
 
 void send_command_to_reader(char* reader_id, char* command);
 
@@ -148,15 +261,14 @@ void open_door(char* door_id);
 
 void close_door(char* door_id);
 
-void* handle_scanned_message_thread(void* arg);
-
-int get_door_sockfd(const char* door_id);
-
 void send_udp_datagram_to_fire_alarm_unit();
 
+// Timer callback for the FIRE ALARM command's periodic resend
+void send_fire_alarm_resend(void* arg);
+
 void raise_security_alarm();
 
-void update_temperature(struct datagram_format *datagram);
+void update_temperature(const TempReading *reading);
 
 void display_temperature_sensors();
 #endif // OVERSEER_H
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "readingcache.h"
+
+int reading_cache_init(ReadingCache* cache, size_t capacity, uint64_t window_us) {
+    size_t buckets = 1;
+    while (buckets * READING_CACHE_WAYS < capacity) buckets <<= 1;
+
+    cache->entries = calloc(buckets * READING_CACHE_WAYS, sizeof(ReadingCacheEntry));
+    if (!cache->entries) {
+        perror("Failed to allocate reading cache");
+        return -1;
+    }
+    cache->bucket_mask = buckets - 1;
+    cache->window_us = window_us;
+    cache->evicted = 0;
+    return 0;
+}
+
+void reading_cache_free(ReadingCache* cache) {
+    free(cache->entries);
+    cache->entries = NULL;
+}
+
+static size_t bucket_of(const ReadingCache* cache, uint16_t id, uint64_t timestamp_us) {
+    uint64_t hash = (timestamp_us ^ ((uint64_t)id << 48)) * 0x9E3779B97F4A7C15ULL;
+    return (hash >> 32) & cache->bucket_mask;
+}
+
+int reading_cache_seen(ReadingCache* cache, uint16_t id, uint64_t timestamp_us, uint64_t now_us) {
+    ReadingCacheEntry* bucket = cache->entries + bucket_of(cache, id, timestamp_us) * READING_CACHE_WAYS;
+    ReadingCacheEntry* victim = &bucket[0];
+    // A reading first seen at now_us - window_us or earlier has expired
+    uint64_t live_after = now_us > cache->window_us ? now_us - cache->window_us : 0;
+
+    for (int way = 0; way < READING_CACHE_WAYS; way++) {
+        ReadingCacheEntry* entry = &bucket[way];
+        int live = entry->seen_us != 0 && entry->seen_us > live_after;
+        if (live && entry->id == id && entry->timestamp_us == timestamp_us) {
+            return 1;
+        }
+        if (!live) {
+            victim = entry; // empty or expired: no need to look for an older one
+        } else if ((victim->seen_us != 0 && victim->seen_us > live_after) && entry->seen_us < victim->seen_us) {
+            victim = entry;
+        }
+    }
+
+    if (victim->seen_us != 0 && victim->seen_us > live_after) {
+        cache->evicted++;
+    }
+    victim->id = id;
+    victim->timestamp_us = timestamp_us;
+    victim->seen_us = now_us ? now_us : 1;
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef READINGCACHE_H
+#define READINGCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define READING_CACHE_WAYS 4
+#define READING_CACHE_DEFAULT_CAPACITY 1024
+#define READING_CACHE_DEFAULT_WINDOW_US 2000000
+
+typedef struct {
+    uint16_t id;
+    uint64_t timestamp_us; // when the sensor took the reading
+    uint64_t seen_us;      // when it was first seen here, 0 for an empty way
+} ReadingCacheEntry;
+
+/*
+ * Recently seen temperature readings, keyed by (sensor id, timestamp), so
+ * a reading that comes back over another path of the mesh is recognised
+ * and dropped before anything else is done with it. Entries count for
+ * `window_us` after they are first seen.
+ *
+ * Set-associative: a key hashes to one bucket of READING_CACHE_WAYS ways,
+ * and a new key takes an empty or expired way, or else the oldest one.
+ * Evicting a live entry only risks forwarding that reading once more;
+ * the visited filter in the datagram still stops it from looping.
+ */
+typedef struct {
+    ReadingCacheEntry* entries;
+    size_t bucket_mask; // buckets - 1, buckets a power of two
+    uint64_t window_us;
+    unsigned long evicted; // live entries pushed out before their window ended
+} ReadingCache;
+
+/**
+ * @param capacity Readings held, rounded up to whole power-of-two buckets.
+ * @param window_us How long a reading counts as seen.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int reading_cache_init(ReadingCache* cache, size_t capacity, uint64_t window_us);
+
+void reading_cache_free(ReadingCache* cache);
+
+/**
+ * Look a reading up and remember it if it is new.
+ * @param now_us The current time, on any clock that only moves forward.
+ * @return 1 if it was seen within the window, 0 if it is new.
+ */
+int reading_cache_seen(ReadingCache* cache, uint16_t id, uint64_t timestamp_us, uint64_t now_us);
+
+#endif // READINGCACHE_H
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "registry.h"
+
+#define REGISTRY_INITIAL_CAPACITY 64
+
+static uint32_t hash_key(const char* key) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (; *key; key++) {
+        hash ^= (unsigned char)*key;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const char* key_of(Registry* registry, size_t id) {
+    return registry->items + id * registry->element_size + registry->key_offset;
+}
+
+// Slot in the index holding key, or the empty slot where it would go
+static size_t probe(Registry* registry, const char* key) {
+    size_t slot = hash_key(key) & registry->index_mask;
+    while (registry->index[slot] != 0 && strcmp(key_of(registry, registry->index[slot] - 1), key) != 0) {
+        slot = (slot + 1) & registry->index_mask;
+    }
+    return slot;
+}
+
+static int grow(Registry* registry) {
+    size_t capacity = registry->capacity * 2;
+    char* items = realloc(registry->items, capacity * registry->element_size);
+    uint32_t* index = calloc(capacity * 2, sizeof(uint32_t));
+    if (!items || !index) {
+        perror("Failed to grow registry");
+        if (items) registry->items = items;
+        free(index);
+        return -1;
+    }
+
+    free(registry->index);
+    registry->items = items;
+    registry->capacity = capacity;
+    registry->index = index;
+    registry->index_mask = capacity * 2 - 1;
+
+    for (size_t id = 0; id < registry->count; id++) {
+        registry->index[probe(registry, key_of(registry, id))] = id + 1;
+    }
+    return 0;
+}
+
+int registry_init(Registry* registry, size_t element_size, size_t key_offset) {
+    pthread_rwlock_init(&registry->lock, NULL);
+    registry->element_size = element_size;
+    registry->key_offset = key_offset;
+    registry->count = 0;
+    registry->capacity = REGISTRY_INITIAL_CAPACITY;
+    registry->items = malloc(registry->capacity * element_size);
+    // The index is kept at twice the record capacity, so it is never more than half full
+    registry->index = calloc(registry->capacity * 2, sizeof(uint32_t));
+    registry->index_mask = registry->capacity * 2 - 1;
+
+    if (!registry->items || !registry->index) {
+        perror("Failed to allocate registry");
+        free(registry->items);
+        free(registry->index);
+        return -1;
+    }
+    return 0;
+}
+
+void registry_destroy(Registry* registry) {
+    free(registry->items);
+    free(registry->index);
+    pthread_rwlock_destroy(&registry->lock);
+}
+
+int registry_find_or_insert(Registry* registry, const char* key, int* created) {
+    // A longer ID would be cut short in the record and could collide with another
+    if (strlen(key) >= REGISTRY_KEY_SIZE) {
+        fprintf(stderr, "ID %.20s... is longer than %d characters, not registered\n", key, REGISTRY_KEY_SIZE - 1);
+        return -1;
+    }
+    pthread_rwlock_wrlock(&registry->lock);
+
+    size_t slot = probe(registry, key);
+    if (registry->index[slot] != 0) {
+        int id = registry->index[slot] - 1;
+        pthread_rwlock_unlock(&registry->lock);
+        if (created) *created = 0;
+        return id;
+    }
+
+    if (registry->count == registry->capacity) {
+        if (grow(registry) == -1) {
+            pthread_rwlock_unlock(&registry->lock);
+            return -1;
+        }
+        slot = probe(registry, key);
+    }
+
+    int id = registry->count++;
+    char* record = registry->items + (size_t)id * registry->element_size;
+    memset(record, 0, registry->element_size);
+    snprintf(record + registry->key_offset, REGISTRY_KEY_SIZE, "%s", key);
+    registry->index[slot] = id + 1;
+
+    pthread_rwlock_unlock(&registry->lock);
+    if (created) *created = 1;
+    return id;
+}
+
+int registry_find(Registry* registry, const char* key) {
+    pthread_rwlock_rdlock(&registry->lock);
+    uint32_t entry = registry->index[probe(registry, key)];
+    pthread_rwlock_unlock(&registry->lock);
+    return (int)entry - 1;
+}
+
+int registry_get(Registry* registry, int id, void* out) {
+    pthread_rwlock_rdlock(&registry->lock);
+    if (id < 0 || (size_t)id >= registry->count) {
+        pthread_rwlock_unlock(&registry->lock);
+        return -1;
+    }
+    memcpy(out, registry->items + (size_t)id * registry->element_size, registry->element_size);
+    pthread_rwlock_unlock(&registry->lock);
+    return 0;
+}
+
+int registry_set(Registry* registry, int id, const void* record) {
+    pthread_rwlock_wrlock(&registry->lock);
+    if (id < 0 || (size_t)id >= registry->count) {
+        pthread_rwlock_unlock(&registry->lock);
+        return -1;
+    }
+    char* slot = registry->items + (size_t)id * registry->element_size;
+    char key[REGISTRY_KEY_SIZE];
+    memcpy(key, slot + registry->key_offset, REGISTRY_KEY_SIZE);
+    memcpy(slot, record, registry->element_size);
+    memcpy(slot + registry->key_offset, key, REGISTRY_KEY_SIZE); // the ID is what the index hashes
+    pthread_rwlock_unlock(&registry->lock);
+    return 0;
+}
+
+size_t registry_count(Registry* registry) {
+    pthread_rwlock_rdlock(&registry->lock);
+    size_t count = registry->count;
+    pthread_rwlock_unlock(&registry->lock);
+    return count;
+}
+
+void registry_read_lock(Registry* registry) {
+    pthread_rwlock_rdlock(&registry->lock);
+}
+
+void registry_write_lock(Registry* registry) {
+    pthread_rwlock_wrlock(&registry->lock);
+}
+
+void registry_unlock(Registry* registry) {
+    pthread_rwlock_unlock(&registry->lock);
+}
+
+void* registry_at(Registry* registry, int id) {
+    return registry->items + (size_t)id * registry->element_size;
+}
@@ -0,0 +1,80 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REGISTRY_KEY_SIZE 50
+
+/*
+ * Growable registry of fixed-size device records keyed by a string ID.
+ *
+ * Records live contiguously in insertion order, so a record's index is
+ * its interned integer ID and iteration is a plain array walk. A hashed
+ * index (open addressing over ID + 1, 0 meaning empty) makes
+ * find-or-insert O(1). Both arrays double when full. Records are never
+ * removed, so interned IDs stay valid for the life of the registry.
+ *
+ * Records may move when the registry grows: pointers from registry_at()
+ * are only valid while the lock is held.
+ */
+typedef struct {
+    pthread_rwlock_t lock;
+    size_t element_size;
+    size_t key_offset; // offset of the NUL-terminated char[REGISTRY_KEY_SIZE] key in a record
+
+    char* items;
+    size_t count;
+    size_t capacity;
+
+    uint32_t* index;
+    size_t index_mask;
+} Registry;
+
+/**
+ * Set up an empty registry.
+ * @param element_size Size of one record.
+ * @param key_offset offsetof() the record's string ID.
+ * @return 0 on success, -1 if allocation failed.
+ */
+int registry_init(Registry* registry, size_t element_size, size_t key_offset);
+
+void registry_destroy(Registry* registry);
+
+/**
+ * Find a record by ID, adding a zeroed record carrying that ID if there is none.
+ * @param registry The registry.
+ * @param key The string ID.
+ * @param created Set to 1 if the record was added, 0 if it already existed (may be NULL).
+ * @return The interned ID, or -1 if the ID does not fit in REGISTRY_KEY_SIZE or the registry could not grow.
+ */
+int registry_find_or_insert(Registry* registry, const char* key, int* created);
+
+/**
+ * @return The interned ID for key, or -1 if it is not registered.
+ */
+int registry_find(Registry* registry, const char* key);
+
+/**
+ * Copy a record out of the registry.
+ * @return 0 on success, -1 if id is out of range.
+ */
+int registry_get(Registry* registry, int id, void* out);
+
+/**
+ * Overwrite a record, keeping its ID.
+ * @return 0 on success, -1 if id is out of range.
+ */
+int registry_set(Registry* registry, int id, const void* record);
+
+size_t registry_count(Registry* registry);
+
+void registry_read_lock(Registry* registry);
+void registry_write_lock(Registry* registry);
+void registry_unlock(Registry* registry);
+
+// Record for an interned ID; the caller must hold the lock
+void* registry_at(Registry* registry, int id);
+
+#endif // REGISTRY_H
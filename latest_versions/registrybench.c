@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "doorset.h"
+#include "doorsync.h"
+#include "timerwheel.h"
+
+// Fire alarm restart-to-armed with a door registry: mapping and validating the
+// registry file, against learning every door again through the DOOR/DREG handshake
+
+#define DEFAULT_DOORS 1000
+#define WARM_ROUNDS 200
+#define RESEND_US 100000
+#define ATTEMPTS 5
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static struct in_addr door_addr(long i) {
+    struct in_addr addr;
+    addr.s_addr = htonl(0x0A000000 | (uint32_t)(i / 50000)); // 10.0.x.x
+    return addr;
+}
+
+static in_port_t door_port(long i) {
+    return (in_port_t)(10000 + i % 50000);
+}
+
+// A fire alarm that has just restarted: empty set, confirming every DOOR it is sent
+typedef struct {
+    int sockfd;
+    DoorSet set;
+    atomic_int stop;
+} Responder;
+
+static void* responder_thread(void* arg) {
+    Responder* responder = arg;
+    char buffer[64];
+    while (!atomic_load(&responder->stop)) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(responder->sockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &from_len);
+        if (len < (ssize_t)sizeof(DoorDatagram) || memcmp(buffer, "DOOR", 4) != 0) {
+            continue;
+        }
+        DoorDatagram datagram;
+        memcpy(&datagram, buffer, sizeof(datagram));
+        doorset_add(&responder->set, datagram.door_addr, datagram.door_port);
+        memcpy(datagram.header, "DREG", 4);
+        sendto(responder->sockfd, &datagram, sizeof(datagram), 0, (struct sockaddr*)&from, from_len);
+    }
+    return NULL;
+}
+
+// Every door announced by the overseer's door sync and confirmed by a fresh fire alarm
+static double network_resync_ms(long count) {
+    Responder responder;
+    memset(&responder, 0, sizeof(responder));
+    responder.sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in alarm_addr;
+    memset(&alarm_addr, 0, sizeof(alarm_addr));
+    alarm_addr.sin_family = AF_INET;
+    alarm_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alarm_len = sizeof(alarm_addr);
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(responder.sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (responder.sockfd == -1 || bind(responder.sockfd, (struct sockaddr*)&alarm_addr, sizeof(alarm_addr)) == -1 ||
+        getsockname(responder.sockfd, (struct sockaddr*)&alarm_addr, &alarm_len) == -1 ||
+        doorset_init(&responder.set) == -1) {
+        perror("Failed to set up the fire alarm responder");
+        exit(EXIT_FAILURE);
+    }
+
+    TimerWheel wheel;
+    if (timer_wheel_init(&wheel, 1000) == -1 || timer_wheel_start(&wheel) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    DoorSync* sync = door_sync_create(&wheel, RESEND_US, ATTEMPTS, DOOR_SYNC_DEFAULT_WINDOW, NULL, NULL);
+    if (!sync) {
+        exit(EXIT_FAILURE);
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, responder_thread, &responder);
+
+    uint64_t start = now_ns();
+    for (long i = 0; i < count; i++) {
+        door_sync_announce(sync, &alarm_addr, door_addr(i), door_port(i));
+    }
+    while (door_sync_pending(sync) > 0) {
+        usleep(100);
+    }
+    double elapsed_ms = (now_ns() - start) / 1e6;
+    if ((long)doorset_count(&responder.set) != count) {
+        fprintf(stderr, "Resync left the fire alarm with %zu of %ld doors\n", doorset_count(&responder.set), count);
+    }
+
+    atomic_store(&responder.stop, 1);
+    pthread_join(thread, NULL);
+    door_sync_destroy(sync);
+    timer_wheel_destroy(&wheel);
+    doorset_free(&responder.set);
+    close(responder.sockfd);
+    return elapsed_ms;
+}
+
+int main(int argc, char *argv[]) {
+    long count = argc > 1 ? atol(argv[1]) : DEFAULT_DOORS;
+    char path[] = "/tmp/registrybench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    unlink(path); // doorset_open creates it afresh
+
+    // The registry as a running fire alarm leaves it
+    DoorSet set;
+    uint64_t start = now_ns();
+    if (doorset_open(&set, path) != 0) {
+        fprintf(stderr, "Expected a new registry file\n");
+        return 1;
+    }
+    for (long i = 0; i < count; i++) {
+        doorset_add(&set, door_addr(i), door_port(i));
+    }
+    doorset_set_sync(&set, 0x1234, count);
+    double build_ms = (now_ns() - start) / 1e6;
+    doorset_free(&set);
+
+    // Restart: map, validate and index the file
+    uint64_t* samples = malloc(WARM_ROUNDS * sizeof(uint64_t));
+    for (int r = 0; r < WARM_ROUNDS; r++) {
+        start = now_ns();
+        int warm = doorset_open(&set, path);
+        samples[r] = now_ns() - start;
+        if (warm != 1 || (long)doorset_count(&set) != count) {
+            fprintf(stderr, "Warm start lost the registry (%d, %zu doors)\n", warm, doorset_count(&set));
+            return 1;
+        }
+        doorset_free(&set);
+    }
+    qsort(samples, WARM_ROUNDS, sizeof(uint64_t), compare_u64);
+
+    // A torn write must be caught, not trusted, and only cost the doors from the torn one on
+    FILE* file = fopen(path, "r+b");
+    fseek(file, sizeof(DoorSetFileHeader) + (count / 2) * sizeof(DoorSetEntry), SEEK_SET);
+    fputc(0xFF, file);
+    fclose(file);
+    long kept = doorset_open(&set, path) == 1 ? (long)doorset_count(&set) : -1;
+    int detected = kept == count / 2;
+    doorset_free(&set);
+    unlink(path);
+
+    double resync_ms = network_resync_ms(count);
+
+    printf("%ld doors, registry file of %zu bytes written in %.3f ms\n", count,
+           sizeof(DoorSetFileHeader) + count * sizeof(DoorSetEntry), build_ms);
+    printf("warm start:        median %8.3f ms, p99 %8.3f ms, max %8.3f ms (%d restarts)\n",
+           samples[WARM_ROUNDS / 2] / 1e6, samples[WARM_ROUNDS * 99 / 100] / 1e6, samples[WARM_ROUNDS - 1] / 1e6, WARM_ROUNDS);
+    printf("network resync:    %8.3f ms for the DOOR/DREG handshake over loopback\n", resync_ms);
+    printf("corrupted file:    %s, kept %ld of %ld doors\n", detected ? "torn entry caught" : "NOT DETECTED", kept, count);
+    free(samples);
+    return detected ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include "routes.h"
+
+typedef struct {
+    int source;
+    Route route;
+} ParsedRoute;
+
+typedef struct {
+    ParsedRoute* items;
+    size_t count;
+    size_t capacity;
+    int min_id;
+    int max_id;
+} ParsedList;
+
+static int parse_line(const char* line, ParsedRoute* parsed) {
+    memset(parsed, 0, sizeof(*parsed));
+
+    if (sscanf(line, "DOOR %d %d", &parsed->source, &parsed->route.target) == 2) {
+        parsed->route.kind = ROUTE_DOOR;
+        return 0;
+    }
+    if (sscanf(line, "ELEVATOR %d %d %d", &parsed->source, &parsed->route.target, &parsed->route.floor) == 3) {
+        parsed->route.kind = ROUTE_ELEVATOR;
+        return 0;
+    }
+    return -1;
+}
+
+static int append(ParsedList* list, const ParsedRoute* route) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        ParsedRoute* grown = realloc(list->items, capacity * sizeof(ParsedRoute));
+        if (!grown) {
+            perror("Failed to allocate routes");
+            return -1;
+        }
+        list->items = grown;
+        list->capacity = capacity;
+    }
+
+    if (list->count == 0 || route->source < list->min_id) list->min_id = route->source;
+    if (list->count == 0 || route->source > list->max_id) list->max_id = route->source;
+    list->items[list->count++] = *route;
+    return 0;
+}
+
+static int build_array(RouteArray* array, const ParsedList* list, const char* path) {
+    size_t span = list->count ? (size_t)(list->max_id - list->min_id) + 1 : 0;
+    if (span > MAX_ROUTE_SPAN) {
+        fprintf(stderr, "IDs in %s span %zu values, more than %d\n", path, span, MAX_ROUTE_SPAN);
+        return -1;
+    }
+
+    array->routes = calloc(span ? span : 1, sizeof(Route));
+    if (!array->routes) {
+        perror("Failed to allocate routes");
+        return -1;
+    }
+    array->min_id = list->min_id;
+    array->span = span;
+
+    for (size_t i = 0; i < list->count; i++) {
+        Route* slot = &array->routes[list->items[i].source - list->min_id];
+        if (slot->kind != ROUTE_NONE) {
+            fprintf(stderr, "%d is connected more than once in %s, keeping the last line\n", list->items[i].source, path);
+        } else {
+            array->count++;
+        }
+        *slot = list->items[i].route;
+    }
+    return 0;
+}
+
+RouteTable* route_table_load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror("Failed to open connections file");
+        return NULL;
+    }
+
+    ParsedList doors = {0}, elevators = {0};
+    char line[256];
+    int failed = 0;
+
+    while (!failed && fgets(line, sizeof(line), file)) {
+        ParsedRoute route;
+        if (parse_line(line, &route) == -1) {
+            continue;
+        }
+        if (route.source < 0) {
+            fprintf(stderr, "Ignoring negative ID in %s: %s", path, line);
+            continue;
+        }
+        failed = append(route.route.kind == ROUTE_DOOR ? &doors : &elevators, &route) == -1;
+    }
+    fclose(file);
+
+    RouteTable* table = calloc(1, sizeof(RouteTable));
+    if (!table || failed ||
+        build_array(&table->doors, &doors, path) == -1 ||
+        build_array(&table->elevators, &elevators, path) == -1) {
+        route_table_free(table);
+        table = NULL;
+    }
+
+    free(doors.items);
+    free(elevators.items);
+    return table;
+}
+
+void route_table_free(RouteTable* table) {
+    if (!table) return;
+    free(table->doors.routes);
+    free(table->elevators.routes);
+    free(table);
+}
+
+const Route* route_lookup(const RouteTable* table, RouteKind kind, int source_id) {
+    const RouteArray* array = kind == ROUTE_DOOR ? &table->doors : &table->elevators;
+    size_t offset = (size_t)((long)source_id - array->min_id);
+    if (offset >= array->span || array->routes[offset].kind == ROUTE_NONE) {
+        return NULL;
+    }
+    return &array->routes[offset];
+}
+
+void route_table_dump(const RouteTable* table, FILE* out) {
+    fprintf(out, "Card reader routes: %zu readers over %zu slots\n", table->doors.count, table->doors.span);
+    fprintf(out, "Reader\tDoor\n");
+    for (size_t i = 0; i < table->doors.span; i++) {
+        if (table->doors.routes[i].kind != ROUTE_NONE) {
+            fprintf(out, "%ld\t%d\n", (long)table->doors.min_id + (long)i, table->doors.routes[i].target);
+        }
+    }
+
+    fprintf(out, "Destination select routes: %zu selectors over %zu slots\n", table->elevators.count, table->elevators.span);
+    fprintf(out, "Select\tElevator\tFloor\n");
+    for (size_t i = 0; i < table->elevators.span; i++) {
+        const Route* route = &table->elevators.routes[i];
+        if (route->kind != ROUTE_NONE) {
+            fprintf(out, "%ld\t%d\t\t%d\n", (long)table->elevators.min_id + (long)i, route->target, route->floor);
+        }
+    }
+}
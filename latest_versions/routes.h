@@ -0,0 +1,62 @@
+#ifndef ROUTES_H
+#define ROUTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_ROUTE_SPAN (1 << 20) // largest reader ID range a dense table may cover
+
+typedef enum {
+    ROUTE_NONE = 0,
+    ROUTE_DOOR,
+    ROUTE_ELEVATOR
+} RouteKind;
+
+typedef struct {
+    int32_t kind;   // RouteKind
+    int32_t target; // door ID or elevator ID
+    int32_t floor;  // ELEVATOR lines only
+} Route;
+
+// Routes for one family of source IDs, indexed by (id - min_id)
+typedef struct {
+    int min_id;
+    size_t span;  // routes[0 .. span) covers IDs min_id .. min_id + span - 1
+    size_t count; // IDs with a route
+    Route* routes;
+} RouteArray;
+
+/*
+ * connections.txt compiled into dense arrays indexed by source ID:
+ *   DOOR {card reader id} {door id}
+ *   ELEVATOR {destination select id} {elevator id} {floor}
+ * Card readers and destination selectors are numbered independently,
+ * so each has its own array. Routing a scan is one bounds check and
+ * one array access.
+ */
+typedef struct {
+    RouteArray doors;
+    RouteArray elevators;
+} RouteTable;
+
+/**
+ * Compile a connections file into a routing table.
+ * @param path Path of connections.txt.
+ * @return The table, or NULL if the file could not be read or its IDs span too wide a range.
+ */
+RouteTable* route_table_load(const char* path);
+
+void route_table_free(RouteTable* table);
+
+/**
+ * @param table The routing table.
+ * @param kind ROUTE_DOOR to route a card reader, ROUTE_ELEVATOR for a destination selector.
+ * @param source_id The reader's or selector's ID.
+ * @return The route, or NULL if the source is not connected to anything.
+ */
+const Route* route_lookup(const RouteTable* table, RouteKind kind, int source_id);
+
+void route_table_dump(const RouteTable* table, FILE* out);
+
+#endif // ROUTES_H
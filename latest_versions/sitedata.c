@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "sitedata.h"
+
+// Epoch a reader announced on entry, 0 while it is outside any critical section
+typedef struct {
+    _Alignas(64) atomic_ulong epoch;
+    atomic_int in_use;
+} ReaderSlot;
+
+static char* auth_file_path;
+static char* connections_file_path;
+
+static _Atomic(SiteData*) current;
+static atomic_ulong global_epoch = 1;
+static ReaderSlot reader_slots[MAX_READER_THREADS];
+
+// Readers that found every slot taken share this lock instead; a reclaimer takes it exclusively
+static pthread_rwlock_t overflow_lock = PTHREAD_RWLOCK_INITIALIZER;
+static atomic_ulong overflow_readers;
+
+#define NO_SLOT -1
+#define OVERFLOW_SLOT -2
+
+static __thread int reader_slot = NO_SLOT;
+static __thread int reader_depth;
+static pthread_key_t reader_key;
+static pthread_once_t reader_key_once = PTHREAD_ONCE_INIT;
+
+// Reloads are rare, a mutex keeps two of them from reclaiming at once
+static pthread_mutex_t reload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long next_version = 1;
+static unsigned long reloads;
+static unsigned long failed_reloads;
+static uint64_t last_reload_ns;
+static uint64_t last_grace_ns;
+static time_t last_reload_at;
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void release_slot(void* arg) {
+    ReaderSlot* slot = arg;
+    atomic_store(&slot->epoch, 0);
+    atomic_store(&slot->in_use, 0);
+}
+
+static void make_reader_key() {
+    pthread_key_create(&reader_key, release_slot);
+}
+
+static int claim_slot() {
+    pthread_once(&reader_key_once, make_reader_key);
+    for (int i = 0; i < MAX_READER_THREADS; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&reader_slots[i].in_use, &expected, 1)) {
+            pthread_setspecific(reader_key, &reader_slots[i]);
+            return i;
+        }
+    }
+    if (atomic_fetch_add(&overflow_readers, 1) == 0) {
+        fprintf(stderr, "More than %d threads read site data, the rest take a lock\n", MAX_READER_THREADS);
+    }
+    return OVERFLOW_SLOT;
+}
+
+static void free_generation(SiteData* site) {
+    if (!site) return;
+    auth_index_free(site->auth);
+    route_table_free(site->routes);
+    free(site);
+}
+
+static SiteData* load_generation() {
+    uint64_t start = now_ns();
+    SiteData* site = calloc(1, sizeof(SiteData));
+    if (!site) {
+        return NULL;
+    }
+
+    site->auth = auth_index_load(auth_file_path);
+    site->routes = route_table_load(connections_file_path);
+    if (!site->auth || !site->routes) {
+        free_generation(site);
+        return NULL;
+    }
+    site->load_ns = now_ns() - start;
+    return site;
+}
+
+// Wait until no reader can still be inside a critical section that began before `epoch`
+static void wait_for_readers(unsigned long epoch) {
+    for (int i = 0; i < MAX_READER_THREADS; i++) {
+        while (1) {
+            unsigned long seen = atomic_load(&reader_slots[i].epoch);
+            if (seen == 0 || seen >= epoch) break;
+            usleep(1000);
+        }
+    }
+}
+
+const SiteData* site_data_acquire() {
+    if (reader_depth++ == 0) {
+        if (reader_slot == NO_SLOT) {
+            reader_slot = claim_slot();
+        }
+        if (reader_slot == OVERFLOW_SLOT) {
+            pthread_rwlock_rdlock(&overflow_lock);
+            return atomic_load(&current);
+        }
+        // seq_cst store then load: a reclaimer that misses this epoch is guaranteed to have swapped first
+        atomic_store(&reader_slots[reader_slot].epoch, atomic_load(&global_epoch));
+    }
+    return atomic_load(&current);
+}
+
+void site_data_release() {
+    if (--reader_depth == 0) {
+        if (reader_slot == OVERFLOW_SLOT) {
+            pthread_rwlock_unlock(&overflow_lock);
+        } else {
+            atomic_store(&reader_slots[reader_slot].epoch, 0);
+        }
+    }
+}
+
+int site_data_init(const char* auth_path, const char* connections_path) {
+    auth_file_path = strdup(auth_path);
+    connections_file_path = strdup(connections_path);
+    return site_data_reload() < 0 ? -1 : 0;
+}
+
+long site_data_reload() {
+    pthread_mutex_lock(&reload_mutex);
+
+    uint64_t start = now_ns();
+    SiteData* site = load_generation();
+    if (!site) {
+        failed_reloads++;
+        pthread_mutex_unlock(&reload_mutex);
+        fprintf(stderr, "Reload failed, keeping the current authorisation and connections data\n");
+        return -1;
+    }
+    site->version = next_version++;
+
+    SiteData* old = atomic_exchange(&current, site);
+    unsigned long epoch = atomic_fetch_add(&global_epoch, 1) + 1;
+
+    uint64_t grace_start = now_ns();
+    wait_for_readers(epoch);
+    // Any overflow reader still holding the old generation holds the lock too
+    pthread_rwlock_wrlock(&overflow_lock);
+    pthread_rwlock_unlock(&overflow_lock);
+    free_generation(old);
+
+    last_grace_ns = now_ns() - grace_start;
+    last_reload_ns = now_ns() - start;
+    last_reload_at = time(NULL);
+    reloads++;
+
+    long version = site->version;
+    pthread_mutex_unlock(&reload_mutex);
+    return version;
+}
+
+static int is_watched(const char* name, const char* path) {
+    char copy[PATH_MAX];
+    snprintf(copy, sizeof(copy), "%s", path);
+    return strcmp(name, basename(copy)) == 0;
+}
+
+static void* watch_thread(void* arg) {
+    int fd = *(int*)arg;
+    free(arg);
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (len == -1 && errno == EINTR) continue;
+            perror("inotify read failed");
+            break;
+        }
+
+        int changed = 0;
+        for (char* p = buffer; p < buffer + len;) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            if (event->len > 0 &&
+                (is_watched(event->name, auth_file_path) || is_watched(event->name, connections_file_path))) {
+                changed = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+
+        if (changed) {
+            usleep(RELOAD_SETTLE_US);
+            long version = site_data_reload();
+            if (version > 0) {
+                printf("Reloaded authorisation and connections data (version %ld)\n", version);
+            }
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+static int watch_directory(int fd, const char* path) {
+    char copy[PATH_MAX];
+    snprintf(copy, sizeof(copy), "%s", path);
+    // Watch the directory, editors often replace the file rather than rewrite it
+    if (inotify_add_watch(fd, dirname(copy), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1) {
+        perror("inotify_add_watch failed");
+        return -1;
+    }
+    return 0;
+}
+
+int site_data_watch() {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd == -1) {
+        perror("inotify_init1 failed");
+        return -1;
+    }
+    // Adding the same directory twice just returns the existing watch
+    if (watch_directory(fd, auth_file_path) == -1 || watch_directory(fd, connections_file_path) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    int* arg = malloc(sizeof(int));
+    *arg = fd;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, watch_thread, arg) != 0) {
+        perror("Failed to start reload watcher");
+        free(arg);
+        close(fd);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+void site_data_print_status() {
+    pthread_mutex_lock(&reload_mutex);
+    const SiteData* site = site_data_acquire();
+    printf("Site data version %lu: %zu cards, %zu reader routes, %zu selector routes\n",
+           site->version, site->auth->count, site->routes->doors.count, site->routes->elevators.count);
+    printf("  loads: %lu, failed: %lu, readers without a slot: %lu\n", reloads, failed_reloads,
+           atomic_load(&overflow_readers));
+    printf("  last reload: %.3f ms total, %.3f ms building, %.3f ms grace period, at %s",
+           last_reload_ns / 1e6, site->load_ns / 1e6, last_grace_ns / 1e6, ctime(&last_reload_at));
+    site_data_release();
+    pthread_mutex_unlock(&reload_mutex);
+}
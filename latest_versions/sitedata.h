@@ -0,0 +1,59 @@
+#ifndef SITEDATA_H
+#define SITEDATA_H
+
+#include <stdint.h>
+#include <time.h>
+#include "authindex.h"
+#include "routes.h"
+
+#define MAX_READER_THREADS 128 // lock-free reader slots; further reader threads share a rwlock
+#define RELOAD_SETTLE_US 50000 // let an editor finish writing before re-reading
+
+/*
+ * One immutable generation of the overseer's file-backed data.
+ * A reload builds a complete new SiteData off to the side and publishes
+ * it with a single atomic pointer swap; readers never see a half-loaded
+ * table.
+ */
+typedef struct {
+    AuthIndex* auth;
+    RouteTable* routes;
+    unsigned long version;
+    uint64_t load_ns; // time taken to build this generation
+} SiteData;
+
+/**
+ * Load the first generation from the authorisation and connections files.
+ * @return 0 on success, -1 if either file could not be loaded.
+ */
+int site_data_init(const char* auth_path, const char* connections_path);
+
+/**
+ * Enter a read-side critical section and return the current generation.
+ * Lock-free: announces the reader's epoch and loads the pointer. A thread
+ * that finds all MAX_READER_THREADS slots taken takes a shared rwlock
+ * instead, which a reload waits out. The generation stays valid until the
+ * matching site_data_release(). Calls may nest on the same thread.
+ */
+const SiteData* site_data_acquire();
+
+void site_data_release();
+
+/**
+ * Build a new generation from the files and publish it. The previous
+ * generation is freed once every reader that could still see it has
+ * released it (epoch-based grace period).
+ * @return The new version, or -1 if loading failed and the old data stays current.
+ */
+long site_data_reload();
+
+/**
+ * Start a thread that reloads whenever inotify reports either file being
+ * rewritten or replaced.
+ * @return 0 on success, -1 otherwise.
+ */
+int site_data_watch();
+
+void site_data_print_status();
+
+#endif // SITEDATA_H
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spscring.h"
+
+int spsc_init(SpscRing* ring, size_t capacity, size_t elem_size) {
+    memset(ring, 0, sizeof(*ring));
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    ring->slots = malloc(size * elem_size);
+    ring->pushed_ns = malloc(size * sizeof(uint64_t));
+    if (!ring->slots || !ring->pushed_ns) {
+        perror("Failed to allocate ring");
+        spsc_free(ring);
+        return -1;
+    }
+    ring->elem_size = elem_size;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+void spsc_free(SpscRing* ring) {
+    free(ring->slots);
+    free(ring->pushed_ns);
+    ring->slots = NULL;
+    ring->pushed_ns = NULL;
+}
+
+int spsc_push(SpscRing* ring, const void* elem, uint64_t now_ns) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head > ring->mask) {
+        ring->full++;
+        return -1;
+    }
+
+    size_t slot = tail & ring->mask;
+    memcpy(ring->slots + slot * ring->elem_size, elem, ring->elem_size);
+    ring->pushed_ns[slot] = now_ns;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    if (tail + 1 - head > ring->peak_depth) {
+        ring->peak_depth = tail + 1 - head;
+    }
+    return 0;
+}
+
+int spsc_pop(SpscRing* ring, void* elem, uint64_t* pushed_ns) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+
+    size_t slot = head & ring->mask;
+    memcpy(elem, ring->slots + slot * ring->elem_size, ring->elem_size);
+    if (pushed_ns) *pushed_ns = ring->pushed_ns[slot];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+size_t spsc_depth(SpscRing* ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return tail - head;
+}
+
+uint64_t spsc_oldest_age_ns(SpscRing* ring, uint64_t now_ns) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (head == tail) {
+        return 0;
+    }
+    // The consumer may pop it meanwhile, but the slot keeps its time until the producer reuses it
+    uint64_t pushed = ring->pushed_ns[head & ring->mask];
+    return now_ns > pushed ? now_ns - pushed : 0;
+}
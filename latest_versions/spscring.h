@@ -0,0 +1,62 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define SPSC_CACHE_LINE 64
+
+/*
+ * Bounded single-producer, single-consumer queue of fixed-size elements.
+ * Push and pop are a copy plus one release store, with no locks: the
+ * producer alone moves tail and the consumer alone moves head, each on
+ * its own cache line. Every slot also records when it was pushed, so the
+ * age of the oldest queued element can be reported.
+ */
+typedef struct {
+    char* slots;
+    uint64_t* pushed_ns;
+    size_t elem_size;
+    size_t mask; // capacity - 1, capacity a power of two
+
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head; // next slot to pop, written by the consumer
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail; // next slot to push, written by the producer
+    size_t peak_depth;  // producer side
+    unsigned long full; // pushes refused because the ring was full, producer side
+} SpscRing;
+
+/**
+ * @param capacity Rounded up to a power of two.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int spsc_init(SpscRing* ring, size_t capacity, size_t elem_size);
+
+void spsc_free(SpscRing* ring);
+
+/**
+ * Producer only.
+ * @param now_ns When the element was produced, kept for spsc_oldest_age_ns.
+ * @return 0 on success, -1 if the ring is full.
+ */
+int spsc_push(SpscRing* ring, const void* elem, uint64_t now_ns);
+
+/**
+ * Consumer only.
+ * @param pushed_ns Set to the time given when the element was pushed; may be NULL.
+ * @return 1 if an element was copied to `elem`, 0 if the ring is empty.
+ */
+int spsc_pop(SpscRing* ring, void* elem, uint64_t* pushed_ns);
+
+/**
+ * @return Elements queued; exact from either end, approximate from elsewhere.
+ */
+size_t spsc_depth(SpscRing* ring);
+
+/**
+ * Producer only: the slots it reads are not reused until it pushes again.
+ * @return How long the oldest queued element has waited, 0 if the ring is empty.
+ */
+uint64_t spsc_oldest_age_ns(SpscRing* ring, uint64_t now_ns);
+
+#endif // SPSCRING_H
@@ -11,23 +11,19 @@
 #include <fcntl.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "tempwire.h"
+#include "readingcache.h"
+#include "udpfanout.h"
 
 #define MAX_RECEIVERS 50
 
-struct addr_entry {
-    struct in_addr sensor_addr;
-    in_port_t sensor_port;
-};
-
-struct datagram_format {
-    char header[4]; // {'T', 'E', 'M', 'P'}
-    struct timeval timestamp;
-    float temperature;
-    uint16_t id;
-    uint8_t address_count;
-    struct addr_entry address_list[50];
-};
-
 struct shared_memory_structure {
     float temperature;
     pthread_mutex_t mutex;
@@ -36,6 +32,7 @@ struct shared_memory_structure {
 
 struct shared_memory_structure *shared_memory;
 struct sockaddr_in receiver_addresses[MAX_RECEIVERS];
+TempVisited receiver_masks[MAX_RECEIVERS]; // each receiver's visited-filter bits, computed once
 int num_receivers;
 #define MAX_PEERS 10
 #define MESSAGE_SIZE 100
@@ -48,73 +45,160 @@ int num_receivers;
 struct shared_memory_structure *shared_memory;
 int sockfd;
 
+// Recently forwarded readings, and what the mesh sent this sensor
+ReadingCache seen_readings;
+unsigned long readings_received;   // well formed TEMP datagrams from other sensors
+unsigned long readings_suppressed; // repeats of a reading already seen, dropped
+unsigned long readings_forwarded;  // readings passed on to at least one receiver
+UdpFanout fanout; // every receiver of a reading in one sendmmsg
+volatile sig_atomic_t stats_requested = 0;
+
 // Prototype declarations
 void broadcast_temperature(int temperature);
 
-int should_send_update(float prev_temperature, float current_temperature, struct timeval *last_sent, struct timeval *current_time, int max_update_wait);
-void receive_and_forward(int sockfd, int max_update_wait);
-int has_address(struct datagram_format *datagram, struct in_addr addr, in_port_t port);
-void append_address(struct datagram_format *datagram, struct in_addr addr, in_port_t port);
+void receive_and_forward(int sockfd);
 
-int should_send_update(float prev_temperature, float current_temperature, struct timeval *last_sent, struct timeval *current_time, int max_update_wait) {
-    if (prev_temperature != current_temperature) {
-        return 1;
-    }
-    int time_diff = (current_time->tv_sec - last_sent->tv_sec) * 1000000 + (current_time->tv_usec - last_sent->tv_usec);
-    if (time_diff >= max_update_wait) {
-        return 1;
-    }
-    return 0;
+uint64_t monotonic_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
 }
 
-void receive_and_forward(int sockfd, int max_update_wait) {
-    struct timeval timeout;
-    timeout.tv_sec = max_update_wait / 1000000;
-    timeout.tv_usec = max_update_wait % 1000000;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+void print_stats(uint16_t sensor_id) {
+    unsigned long unique = readings_received - readings_suppressed;
+    printf("Temperature sensor %u mesh traffic:\n", sensor_id);
+    printf("  received: %lu, suppressed as repeats: %lu, forwarded: %lu\n",
+           readings_received, readings_suppressed, readings_forwarded);
+    printf("  amplification: %.2f copies received per reading, cache evictions before expiry: %lu\n",
+           unique ? (double)readings_received / unique : 0.0, seen_readings.evicted);
+    udp_fanout_print_stats(&fanout, stdout, "Temperature sensor");
+    fflush(stdout);
+}
 
-    struct datagram_format received_datagram;
-    int addr_len = sizeof(struct sockaddr_in);
-    struct sockaddr_in src_addr;
+// SIGUSR1 asks for the mesh statistics; they are printed from the main loop
+void request_stats(int signo) {
+    (void)signo;
+    stats_requested = 1;
+}
 
-    int bytes_received = recvfrom(sockfd, &received_datagram, sizeof(received_datagram), 0, (struct sockaddr *)&src_addr, &addr_len);
+// Forward everything queued on the (non-blocking) socket
+void receive_and_forward(int sockfd) {
+    // One byte spare, so an oversized datagram shows up as a length mismatch
+    char buffer[sizeof(TempWireHeader) + TEMP_WIRE_MAX_ADDRESSES * sizeof(TempWireAddr) + 1];
+    TempWireAddr forwarded_to[MAX_RECEIVERS];
+    TempWireHeader headers[MAX_RECEIVERS]; // the visited filter and path differ per receiver
+    struct iovec iov[TEMP_WIRE_IOVECS];
+    int bytes_received = recvfrom(sockfd, buffer, sizeof(buffer), 0, NULL, NULL);
     while (bytes_received > 0) {
-        // Forward logic
-        for (int i = 0; i < num_receivers; i++) {
-            if (!has_address(&received_datagram, receiver_addresses[i].sin_addr, receiver_addresses[i].sin_port)) {
-                append_address(&received_datagram, receiver_addresses[i].sin_addr, receiver_addresses[i].sin_port);
-                sendto(sockfd, &received_datagram, sizeof(received_datagram), 0, (struct sockaddr *)&receiver_addresses[i], sizeof(receiver_addresses[i]));
+        TempReading reading;
+        if (temp_wire_decode(buffer, bytes_received, &reading) == -1) {
+            bytes_received = recvfrom(sockfd, buffer, sizeof(buffer), 0, NULL, NULL);
+            continue;
+        }
+        readings_received++;
+
+        // A reading seen before was forwarded the first time; nothing to check in its path
+        if (reading_cache_seen(&seen_readings, reading.id, reading.timestamp_us, monotonic_us())) {
+            readings_suppressed++;
+        } else {
+            // Forward logic: each receiver also learns of the ones forwarded to before it,
+            // so every datagram shares the received entries and a prefix of forwarded_to
+            int forwarded = 0;
+            for (int i = 0; i < num_receivers; i++) {
+                if (!temp_wire_visited(&reading, &receiver_masks[i], receiver_addresses[i].sin_addr, receiver_addresses[i].sin_port)) {
+                    temp_visited_add(&reading.visited, &receiver_masks[i]);
+                    forwarded_to[forwarded].sensor_addr = receiver_addresses[i].sin_addr;
+                    forwarded_to[forwarded].sensor_port = receiver_addresses[i].sin_port;
+                    forwarded++;
+                    int iovcnt = temp_wire_encode(&reading, forwarded_to, forwarded, &headers[forwarded - 1], iov);
+                    udp_fanout_add(&fanout, &receiver_addresses[i], iov, iovcnt);
+                }
+            }
+            if (forwarded > 0) {
+                udp_fanout_flush(&fanout); // before the next receive reuses the buffer
+                readings_forwarded++;
             }
         }
 
-        bytes_received = recvfrom(sockfd, &received_datagram, sizeof(received_datagram), 0, (struct sockaddr *)&src_addr, &addr_len);
+        bytes_received = recvfrom(sockfd, buffer, sizeof(buffer), 0, NULL, NULL);
     }
 }
 
-void send_udp_datagram(struct datagram_format *datagram) {
+void send_udp_datagram(const TempReading *reading) {
+    // Our own reading coming back round the mesh is a repeat like any other
+    reading_cache_seen(&seen_readings, reading->id, reading->timestamp_us, monotonic_us());
+    TempWireHeader header;
+    struct iovec iov[TEMP_WIRE_IOVECS];
+    int iovcnt = temp_wire_encode(reading, NULL, 0, &header, iov);
     for (int i = 0; i < num_receivers; i++) {
-        sendto(sockfd, datagram, sizeof(*datagram), 0, (struct sockaddr *)&receiver_addresses[i], sizeof(receiver_addresses[i]));
+        udp_fanout_add(&fanout, &receiver_addresses[i], iov, iovcnt);
     }
+    udp_fanout_flush(&fanout);
 }
 
-int has_address(struct datagram_format *datagram, struct in_addr addr, in_port_t port) {
-    for (int i = 0; i < datagram->address_count; i++) {
-        if (datagram->address_list[i].sensor_addr.s_addr == addr.s_addr && datagram->address_list[i].sensor_port == port) {
-            return 1;
+typedef struct {
+    int eventfd;
+    int max_condvar_wait;
+} WatchArgs;
+
+// Bridge the shared memory condition variable onto an eventfd, so the main loop waits in one place
+void *temperature_watch_thread(void *arg) {
+    WatchArgs *args = arg;
+    float last_temperature = NAN;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&shared_memory->mutex);
+    while (1) {
+        // The simulator signals every change; the timeout only covers one it did not signal
+        struct timespec max_wait_time;
+        clock_gettime(CLOCK_REALTIME, &max_wait_time);
+        max_wait_time.tv_sec += args->max_condvar_wait / 1000000;
+        max_wait_time.tv_nsec += (long)(args->max_condvar_wait % 1000000) * 1000;
+        if (max_wait_time.tv_nsec >= 1000000000) {
+            max_wait_time.tv_sec++;
+            max_wait_time.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&shared_memory->cond, &shared_memory->mutex, &max_wait_time);
+
+        float current_temperature = shared_memory->temperature;
+        if (current_temperature != last_temperature) {
+            last_temperature = current_temperature;
+            pthread_mutex_unlock(&shared_memory->mutex);
+            write(args->eventfd, &one, sizeof(one));
+            pthread_mutex_lock(&shared_memory->mutex);
         }
     }
-    return 0;
+    return NULL;
+}
+
+void send_reading(uint16_t sensor_id, const char *local_addr, int local_port, float temperature) {
+    struct timeval current_time;
+    gettimeofday(&current_time, NULL);
+
+    TempWireAddr self;
+    inet_pton(AF_INET, local_addr, &self.sensor_addr);
+    self.sensor_port = htons(local_port);
+    TempReading reading;
+    reading.id = sensor_id;
+    reading.temperature = temperature;
+    reading.timestamp_us = (uint64_t)current_time.tv_sec * 1000000 + current_time.tv_usec;
+    reading.address_count = 1;
+    reading.addresses = &self;
+    reading.path_length = 1;
+    temp_visited_mask(&reading.visited, self.sensor_addr, self.sensor_port);
+    send_udp_datagram(&reading);
 }
 
-void append_address(struct datagram_format *datagram, struct in_addr addr, in_port_t port) {
-    if (datagram->address_count >= 50) {
-        // Shift addresses if list is full
-        memmove(&datagram->address_list[0], &datagram->address_list[1], sizeof(struct addr_entry) * 49);
-        datagram->address_count = 49;
+// The next periodic reading is due max_update_wait after the last one sent
+void arm_update_timer(int timerfd, int max_update_wait) {
+    struct itimerspec deadline;
+    memset(&deadline, 0, sizeof(deadline));
+    deadline.it_value.tv_sec = max_update_wait / 1000000;
+    deadline.it_value.tv_nsec = (long)(max_update_wait % 1000000) * 1000;
+    if (max_update_wait <= 0) {
+        deadline.it_value.tv_nsec = 1000; // a zero it_value would disarm it
     }
-    datagram->address_list[datagram->address_count].sensor_addr = addr;
-    datagram->address_list[datagram->address_count].sensor_port = port;
-    datagram->address_count++;
+    timerfd_settime(timerfd, 0, &deadline, NULL);
 }
 
 int main(int argc, char *argv[]) {
@@ -132,56 +216,130 @@ int main(int argc, char *argv[]) {
         receiver_addresses[i].sin_family = AF_INET;
         receiver_addresses[i].sin_port = htons(receiver_port);
         inet_pton(AF_INET, receiver_addr, &receiver_addresses[i].sin_addr);
+        temp_visited_mask(&receiver_masks[i], receiver_addresses[i].sin_addr, receiver_addresses[i].sin_port);
     }
 
     //shared memory
-    int shm_fd = shm_open(argv[5], O_RDONLY, 0666);
-    shared_memory = (struct shared_memory_structure *) mmap(0, sizeof(struct shared_memory_structure), PROT_READ, MAP_SHARED, shm_fd, atoi(argv[6]));
+    // Locking the mutex writes to it, and the offset need not be page aligned: map it all read-write
+    int shm_fd = shm_open(argv[5], O_RDWR, 0666);
+    struct stat shm_stat;
+    if (shm_fd == -1 || fstat(shm_fd, &shm_stat) == -1) {
+        perror("Failed to open shared memory");
+        exit(EXIT_FAILURE);
+    }
+    char *shm = mmap(0, shm_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap()");
+        exit(EXIT_FAILURE);
+    }
+    shared_memory = (struct shared_memory_structure *)(shm + atoi(argv[6]));
 
     //udp socket
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     struct sockaddr_in server_addr;
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(local_port);
     inet_pton(AF_INET, local_addr, &server_addr.sin_addr);
     bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr));
 
+    if (udp_fanout_init(&fanout, sockfd, MAX_RECEIVERS) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    // TEMPSENSOR_DEDUP_WINDOW_US: how long a reading counts as seen; it should outlast the slowest path
+    char *window = getenv("TEMPSENSOR_DEDUP_WINDOW_US");
+    uint64_t window_us = window && atoll(window) > 0 ? (uint64_t)atoll(window) : READING_CACHE_DEFAULT_WINDOW_US;
+    if (reading_cache_init(&seen_readings, READING_CACHE_DEFAULT_CAPACITY, window_us) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    // SIGUSR1 makes epoll_wait fail with EINTR (it is never restarted), so the main loop prints the stats at once
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stats;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+
+    // One wait point: datagrams to forward, the periodic update deadline and temperature changes
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int changefd = eventfd(0, EFD_NONBLOCK);
+    int epoll_fd = epoll_create1(0);
+    if (timerfd == -1 || changefd == -1 || epoll_fd == -1) {
+        perror("Failed to set up the event loop");
+        exit(EXIT_FAILURE);
+    }
+    int fds[] = { sockfd, timerfd, changefd };
+    for (int i = 0; i < 3; i++) {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fds[i];
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i], &event) == -1) {
+            perror("epoll_ctl");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    WatchArgs watch_args = { changefd, max_condvar_wait };
+    pthread_t watch_thread;
+    sigset_t usr1, previous;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &usr1, &previous); // SIGUSR1 is for the main loop
+    if (pthread_create(&watch_thread, NULL, temperature_watch_thread, &watch_args) != 0) {
+        perror("Failed to start the temperature watch thread");
+        exit(EXIT_FAILURE);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
     //loop for normal operation
-    float prev_temperature = -9999; //initial value
-    struct timeval last_sent_time, current_time;
+    pthread_mutex_lock(&shared_memory->mutex);
+    float prev_temperature = shared_memory->temperature;
+    pthread_mutex_unlock(&shared_memory->mutex);
+    send_reading(sensor_id, local_addr, local_port, prev_temperature);
+    arm_update_timer(timerfd, max_update_wait);
 
+    struct epoll_event events[3];
     while (1) {
-        pthread_mutex_lock(&shared_memory->mutex);
-        float current_temperature = shared_memory->temperature;
-        pthread_mutex_unlock(&shared_memory->mutex);
-
-        gettimeofday(&current_time, NULL);
-
-        if (should_send_update(prev_temperature, current_temperature, &last_sent_time, &current_time, max_update_wait)) {
-            struct datagram_format datagram;
-            datagram.header[0] = 'T'; datagram.header[1] = 'E'; datagram.header[2] = 'M'; datagram.header[3] = 'P';
-            datagram.temperature = current_temperature;
-            datagram.id = sensor_id;
-            datagram.address_count = 1;
-            inet_pton(AF_INET, local_addr, &datagram.address_list[0].sensor_addr);
-            datagram.address_list[0].sensor_port = htons(local_port);
-            send_udp_datagram(&datagram);
-            prev_temperature = current_temperature;
-            last_sent_time = current_time;
+        int n = epoll_wait(epoll_fd, events, 3, -1);
+        if (stats_requested) {
+            stats_requested = 0;
+            print_stats(sensor_id);
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
         }
 
-        receive_and_forward(sockfd, max_update_wait);
+        int periodic = 0, changed = 0;
+        for (int i = 0; i < n; i++) {
+            uint64_t count;
+            if (events[i].data.fd == sockfd) {
+                receive_and_forward(sockfd);
+            } else if (events[i].data.fd == timerfd) {
+                read(timerfd, &count, sizeof(count));
+                periodic = 1; // nothing sent for max_update_wait: repeat the reading
+            } else if (events[i].data.fd == changefd) {
+                read(changefd, &count, sizeof(count));
+                changed = 1; // sent only if it differs from the last reading sent
+            }
+        }
+        if (!periodic && !changed) {
+            continue;
+        }
 
-        // waiting
-        struct timespec max_wait_time;
-        max_wait_time.tv_sec = current_time.tv_sec + (max_condvar_wait / 1000000);
-        max_wait_time.tv_nsec = (current_time.tv_usec + (max_condvar_wait % 1000000)) * 1000;
         pthread_mutex_lock(&shared_memory->mutex);
-        pthread_cond_timedwait(&shared_memory->cond, &shared_memory->mutex, &max_wait_time);
+        float current_temperature = shared_memory->temperature;
         pthread_mutex_unlock(&shared_memory->mutex);
+        if (periodic || current_temperature != prev_temperature) {
+            send_reading(sensor_id, local_addr, local_port, current_temperature);
+            prev_temperature = current_temperature;
+            arm_update_timer(timerfd, max_update_wait);
+        }
     }
 
-
     close(sockfd);
     return 0;
 }
@@ -0,0 +1,119 @@
+#include <string.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include "tempwire.h"
+
+size_t temp_wire_size(size_t address_count) {
+    return sizeof(TempWireHeader) + address_count * sizeof(TempWireAddr);
+}
+
+int temp_wire_decode(const char* buffer, size_t len, TempReading* reading) {
+    const TempWireHeader* header = (const TempWireHeader*)buffer;
+    if (len < sizeof(TempWireHeader) || memcmp(header->header, "TEMP", 4) != 0 ||
+        header->version != TEMP_WIRE_VERSION || header->address_count > TEMP_WIRE_MAX_ADDRESSES ||
+        len != temp_wire_size(header->address_count)) {
+        return -1;
+    }
+
+    uint32_t bits = ntohl(header->temperature);
+    memcpy(&reading->temperature, &bits, sizeof(bits));
+    if (reading->temperature != reading->temperature) {
+        return -1; // NaN
+    }
+    reading->id = ntohs(header->id);
+    reading->timestamp_us = be64toh(header->timestamp_us);
+    reading->address_count = header->address_count;
+    reading->addresses = (const TempWireAddr*)(buffer + sizeof(TempWireHeader));
+    reading->path_length = ntohs(header->path_length);
+    if (reading->path_length < reading->address_count) {
+        return -1;
+    }
+    for (int i = 0; i < TEMP_VISITED_WORDS; i++) {
+        reading->visited.words[i] = be64toh(header->visited[i]);
+    }
+    return 0;
+}
+
+void temp_visited_mask(TempVisited* mask, struct in_addr addr, in_port_t port) {
+    // splitmix64 finaliser over the host-order key, so every sensor sets the same bits
+    uint64_t hash = ((uint64_t)ntohl(addr.s_addr) << 16 | ntohs(port)) + 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+
+    memset(mask, 0, sizeof(*mask));
+    for (int i = 0; i < TEMP_VISITED_HASHES; i++) {
+        unsigned bit = (hash >> (i * 8)) & (TEMP_VISITED_WORDS * 64 - 1);
+        mask->words[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+int temp_visited_contains(const TempVisited* visited, const TempVisited* mask) {
+    uint64_t missing = 0;
+    for (int i = 0; i < TEMP_VISITED_WORDS; i++) {
+        missing |= mask->words[i] & ~visited->words[i];
+    }
+    return missing == 0;
+}
+
+void temp_visited_add(TempVisited* visited, const TempVisited* mask) {
+    for (int i = 0; i < TEMP_VISITED_WORDS; i++) {
+        visited->words[i] |= mask->words[i];
+    }
+}
+
+int temp_wire_visited(const TempReading* reading, const TempVisited* mask, struct in_addr addr, in_port_t port) {
+    if (!temp_visited_contains(&reading->visited, mask)) {
+        return 0;
+    }
+    if (reading->path_length > reading->address_count) {
+        return 1; // the list has lost the start of the path, so the filter decides
+    }
+    for (int i = 0; i < reading->address_count; i++) {
+        if (reading->addresses[i].sensor_addr.s_addr == addr.s_addr && reading->addresses[i].sensor_port == port) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int temp_wire_encode(const TempReading* reading, const TempWireAddr* appended, size_t appended_count,
+                     TempWireHeader* header, struct iovec iov[TEMP_WIRE_IOVECS]) {
+    const TempWireAddr* addresses = reading->addresses;
+    size_t count = reading->address_count;
+    if (appended_count > TEMP_WIRE_MAX_ADDRESSES) {
+        appended += appended_count - TEMP_WIRE_MAX_ADDRESSES;
+        appended_count = TEMP_WIRE_MAX_ADDRESSES;
+    }
+    if (count + appended_count > TEMP_WIRE_MAX_ADDRESSES) {
+        size_t dropped = count + appended_count - TEMP_WIRE_MAX_ADDRESSES;
+        addresses += dropped;
+        count -= dropped;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &reading->temperature, sizeof(bits));
+    memcpy(header->header, "TEMP", 4);
+    header->version = TEMP_WIRE_VERSION;
+    header->address_count = count + appended_count;
+    header->id = htons(reading->id);
+    header->temperature = htonl(bits);
+    header->timestamp_us = htobe64(reading->timestamp_us);
+    header->path_length = htons(reading->path_length + appended_count);
+    for (int i = 0; i < TEMP_VISITED_WORDS; i++) {
+        header->visited[i] = htobe64(reading->visited.words[i]);
+    }
+
+    int iovcnt = 0;
+    iov[iovcnt].iov_base = header;
+    iov[iovcnt++].iov_len = sizeof(*header);
+    if (count > 0) {
+        iov[iovcnt].iov_base = (void*)addresses;
+        iov[iovcnt++].iov_len = count * sizeof(TempWireAddr);
+    }
+    if (appended_count > 0) {
+        iov[iovcnt].iov_base = (void*)appended;
+        iov[iovcnt++].iov_len = appended_count * sizeof(TempWireAddr);
+    }
+    return iovcnt;
+}
@@ -0,0 +1,109 @@
+#ifndef TEMPWIRE_H
+#define TEMPWIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+
+#define TEMP_WIRE_VERSION 2
+#define TEMP_WIRE_MAX_ADDRESSES 50
+#define TEMP_VISITED_WORDS 4  // 256-bit filter
+#define TEMP_VISITED_HASHES 3
+#define TEMP_WIRE_IOVECS 3 // header, received entries, appended entries
+
+/*
+ * Bloom filter of every sensor a reading has been forwarded to, keyed on
+ * address:port. Unlike the address list it never drops a member, so loop
+ * protection holds however long the path gets. The mask of a single
+ * address is computed once and checked with a few word operations; while
+ * the path still fits the address list, a hit is confirmed there, so false
+ * positives (about 0.1% at 10 hops, 9% at 50) only cost forwards on paths
+ * longer than that.
+ */
+typedef struct {
+    uint64_t words[TEMP_VISITED_WORDS];
+} TempVisited;
+
+/*
+ * TEMP datagram as sent between temperature sensors, the fire alarm and
+ * the overseer: this fixed header followed by exactly `address_count`
+ * address entries, with no padding anywhere. Multi-byte fields are in
+ * network byte order, so receivers can read the header where it lies.
+ * A datagram whose length is not exactly the header plus its entries is
+ * rejected. The entries are the latest TEMP_WIRE_MAX_ADDRESSES of the
+ * path, for reporting; `visited` holds all of it, for forwarding.
+ */
+typedef struct __attribute__((packed)) {
+    char header[4];        // {'T', 'E', 'M', 'P'}
+    uint8_t version;       // TEMP_WIRE_VERSION
+    uint8_t address_count; // latest sensors the reading has visited, at most TEMP_WIRE_MAX_ADDRESSES
+    uint16_t id;
+    uint32_t temperature;  // bits of the float
+    uint64_t timestamp_us; // since the epoch
+    uint16_t path_length;  // sensors visited in all, beyond the ones listed
+    uint64_t visited[TEMP_VISITED_WORDS];
+} TempWireHeader;
+
+typedef struct __attribute__((packed)) {
+    struct in_addr sensor_addr;
+    in_port_t sensor_port;
+} TempWireAddr;
+
+// A decoded datagram; `addresses` points into the received buffer
+typedef struct {
+    uint16_t id;
+    float temperature;
+    uint64_t timestamp_us;
+    uint8_t address_count;
+    const TempWireAddr* addresses;
+    uint16_t path_length;
+    TempVisited visited;
+} TempReading;
+
+/**
+ * @return Bytes on the wire for a datagram carrying `address_count` entries.
+ */
+size_t temp_wire_size(size_t address_count);
+
+/**
+ * Check a received datagram and decode its header without copying the entries.
+ * @return 0 if it is a well formed TEMP datagram of this version, -1 otherwise.
+ */
+int temp_wire_decode(const char* buffer, size_t len, TempReading* reading);
+
+/**
+ * @param mask Set to the filter bits of addr:port (network order).
+ */
+void temp_visited_mask(TempVisited* mask, struct in_addr addr, in_port_t port);
+
+/**
+ * @return 1 if every bit of `mask` is in `visited`: the sensor has probably had the reading.
+ */
+int temp_visited_contains(const TempVisited* visited, const TempVisited* mask);
+
+void temp_visited_add(TempVisited* visited, const TempVisited* mask);
+
+/**
+ * Whether the reading has already been sent to addr:port: the filter first,
+ * then the address list for a hit it can still confirm or rule out.
+ * @param mask temp_visited_mask of addr:port.
+ * @return 1 if it has (or, past the listed path, probably has), 0 otherwise.
+ */
+int temp_wire_visited(const TempReading* reading, const TempVisited* mask, struct in_addr addr, in_port_t port);
+
+/**
+ * Lay a reading out for sending as its header, its entries and then `appended`,
+ * gathered straight from where they lie. When that would exceed
+ * TEMP_WIRE_MAX_ADDRESSES the oldest entries are left out. `reading->visited`
+ * is sent as it is, so it should already hold the appended entries; the path
+ * length is counted on.
+ * @param appended Further entries to carry; may be NULL if `appended_count` is 0.
+ * @param header Filled in; it and the entries must stay put until the datagram is sent.
+ * @return The number of iovecs filled in.
+ */
+int temp_wire_encode(const TempReading* reading, const TempWireAddr* appended, size_t appended_count,
+                     TempWireHeader* header, struct iovec iov[TEMP_WIRE_IOVECS]);
+
+#endif // TEMPWIRE_H
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include "timerwheel.h"
+
+// Arm, re-arm, cancel and expire cost of the timer wheel with many concurrent timers,
+// against the linear deadline scan it replaces
+
+#define DEFAULT_TIMERS 100000
+#define SPREAD_US 2000000 // deadlines spread over two seconds
+
+typedef struct {
+    Timer timer;
+    uint64_t deadline_ns;
+    uint64_t fired_ns;
+} BenchTimer;
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static uint64_t cpu_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static long fired;
+
+static void on_fire(void* arg) {
+    BenchTimer* timer = arg;
+    timer->fired_ns = now_ns();
+    fired++;
+}
+
+static uint64_t delay_for(long i, long count) {
+    // Deterministic spread with neighbours far apart, so slots fill unevenly
+    return 1000 + ((uint64_t)i * 2654435761ULL) % count * (SPREAD_US / count);
+}
+
+// The scan the old per-loop deadline search did: find the earliest of n deadlines
+static double linear_scan_ns(const BenchTimer* timers, long count) {
+    int rounds = 100;
+    volatile uint64_t earliest = 0;
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        uint64_t min = UINT64_MAX;
+        for (long i = 0; i < count; i++) {
+            if (timers[i].deadline_ns < min) min = timers[i].deadline_ns;
+        }
+        earliest = min;
+    }
+    (void)earliest;
+    return (double)(now_ns() - start) / rounds;
+}
+
+int main(int argc, char *argv[]) {
+    long count = argc > 1 ? atol(argv[1]) : DEFAULT_TIMERS;
+    TimerWheel wheel;
+    if (timer_wheel_init(&wheel, TIMER_DEFAULT_TICK_US) == -1) {
+        return 1;
+    }
+
+    BenchTimer* timers = calloc(count, sizeof(BenchTimer));
+    for (long i = 0; i < count; i++) {
+        timer_init(&timers[i].timer, on_fire, &timers[i]);
+    }
+
+    // Arm every timer
+    uint64_t start = now_ns();
+    for (long i = 0; i < count; i++) {
+        uint64_t delay = delay_for(i, count);
+        timers[i].deadline_ns = now_ns() + delay * 1000;
+        timer_arm(&wheel, &timers[i].timer, delay, 0);
+    }
+    double arm_ns = (double)(now_ns() - start) / count;
+
+    // Re-arm every timer to a new expiry, as a door's hold being extended does
+    start = now_ns();
+    for (long i = 0; i < count; i++) {
+        uint64_t delay = delay_for(count - 1 - i, count);
+        timers[i].deadline_ns = now_ns() + delay * 1000;
+        timer_arm(&wheel, &timers[i].timer, delay, 0);
+    }
+    double rearm_ns = (double)(now_ns() - start) / count;
+
+    // Cancel every tenth timer and leave it cancelled
+    long cancelled = 0;
+    start = now_ns();
+    for (long i = 0; i < count; i += 10) {
+        cancelled += timer_cancel(&wheel, &timers[i].timer);
+        timers[i].deadline_ns = UINT64_MAX;
+    }
+    double cancel_ns = cancelled ? (double)(now_ns() - start) / cancelled : 0.0;
+
+    // Let the rest expire, driving the wheel from its timerfd
+    long expected = count - cancelled;
+    struct pollfd pfd = { timer_wheel_fd(&wheel), POLLIN, 0 };
+    uint64_t cpu_start = cpu_ns();
+    start = now_ns();
+    while (fired < expected) {
+        poll(&pfd, 1, -1);
+        timer_wheel_expire(&wheel);
+    }
+    double run_seconds = (now_ns() - start) / 1e9;
+    double expire_cpu_ns = (double)(cpu_ns() - cpu_start) / expected;
+    double scan_ns = linear_scan_ns(timers, count);
+
+    uint64_t late_total = 0, late_max = 0;
+    long early = 0;
+    for (long i = 0; i < count; i++) {
+        if (timers[i].deadline_ns == UINT64_MAX) continue;
+        if (timers[i].fired_ns < timers[i].deadline_ns) {
+            early++;
+            continue;
+        }
+        uint64_t late = timers[i].fired_ns - timers[i].deadline_ns;
+        late_total += late;
+        if (late > late_max) late_max = late;
+    }
+
+    printf("%ld timers, 1 ms ticks, deadlines spread over %.1f s\n", count, SPREAD_US / 1e6);
+    printf("arm:               %8.1f ns/timer\n", arm_ns);
+    printf("re-arm:            %8.1f ns/timer\n", rearm_ns);
+    printf("cancel:            %8.1f ns/timer (%ld cancelled)\n", cancel_ns, cancelled);
+    printf("expire:            %8.1f ns CPU/timer, %ld fired in %.3f s\n", expire_cpu_ns, fired, run_seconds);
+    printf("lateness:          avg %.3f ms, max %.3f ms, %ld early\n",
+           fired ? late_total / 1e6 / fired : 0.0, late_max / 1e6, early);
+    printf("linear scan:       %8.1f ns per earliest-deadline search over %ld timers\n", scan_ns, count);
+    timer_wheel_print_stats(&wheel);
+
+    timer_wheel_destroy(&wheel);
+    free(timers);
+    return early != 0;
+}
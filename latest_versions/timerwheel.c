@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "timerwheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA ((1ULL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void list_init(TimerLink* head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static int list_empty(const TimerLink* head) {
+    return head->next == head;
+}
+
+static void list_add_tail(TimerLink* head, TimerLink* link) {
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void list_del(TimerLink* link) {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    list_init(link);
+}
+
+// Move every entry of `from` onto the end of `to`, leaving `from` empty
+static void list_splice_tail(TimerLink* to, TimerLink* from) {
+    if (list_empty(from)) return;
+    from->next->prev = to->prev;
+    to->prev->next = from->next;
+    from->prev->next = to;
+    to->prev = from->prev;
+    list_init(from);
+}
+
+static uint64_t current_tick(TimerWheel* wheel) {
+    return (now_ns() - wheel->start_ns) / wheel->tick_ns;
+}
+
+// First tick at or after `tick` on which level 0 wraps and the outer levels cascade
+static uint64_t next_boundary(uint64_t tick) {
+    return (tick + SLOT_MASK) & ~(uint64_t)SLOT_MASK;
+}
+
+// Link a timer into the slot for its expiry; returns the level it went to
+static int add_locked(TimerWheel* wheel, Timer* timer) {
+    if (timer->expires < wheel->next_tick) {
+        timer->expires = wheel->next_tick;
+    }
+    uint64_t delta = timer->expires - wheel->next_tick;
+    if (delta > MAX_DELTA) {
+        delta = MAX_DELTA;
+        timer->expires = wheel->next_tick + MAX_DELTA;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    size_t slot = (timer->expires >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK;
+    list_add_tail(&wheel->slots[level][slot], &timer->link);
+    return level;
+}
+
+static void program(TimerWheel* wheel, uint64_t tick) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (tick != 0) {
+        uint64_t at = wheel->start_ns + tick * wheel->tick_ns;
+        its.it_value.tv_sec = at / 1000000000ULL;
+        its.it_value.tv_nsec = at % 1000000000ULL;
+    }
+    if (timerfd_settime(wheel->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+        perror("timerfd_settime failed");
+    }
+    wheel->programmed_tick = tick;
+}
+
+// Sleep until the next non-empty level 0 slot, or the next cascade if that comes first
+static void reprogram(TimerWheel* wheel) {
+    if (wheel->count == 0) {
+        if (wheel->programmed_tick != 0) program(wheel, 0);
+        return;
+    }
+
+    uint64_t tick = wheel->next_tick;
+    while (list_empty(&wheel->slots[0][tick & SLOT_MASK]) && ((tick & SLOT_MASK) != 0)) {
+        tick++;
+    }
+    if (tick != wheel->programmed_tick) {
+        program(wheel, tick);
+    }
+}
+
+static void cascade(TimerWheel* wheel, int level, size_t slot) {
+    TimerLink pending;
+    list_init(&pending);
+    list_splice_tail(&pending, &wheel->slots[level][slot]);
+
+    while (!list_empty(&pending)) {
+        Timer* timer = (Timer*)pending.next;
+        list_del(&timer->link);
+        add_locked(wheel, timer);
+        wheel->cascaded++;
+    }
+}
+
+static void process_tick(TimerWheel* wheel) {
+    size_t index = wheel->next_tick & SLOT_MASK;
+    if (index == 0) {
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            size_t slot = (wheel->next_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK;
+            cascade(wheel, level, slot);
+            if (slot != 0) break;
+        }
+    }
+    list_splice_tail(&wheel->due, &wheel->slots[0][index]);
+    wheel->next_tick++;
+}
+
+int timer_wheel_init(TimerWheel* wheel, unsigned int tick_us) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (wheel->timer_fd == -1) {
+        perror("timerfd_create failed");
+        return -1;
+    }
+
+    pthread_mutex_init(&wheel->lock, NULL);
+    pthread_cond_init(&wheel->callback_done, NULL);
+    wheel->tick_ns = (uint64_t)(tick_us ? tick_us : TIMER_DEFAULT_TICK_US) * 1000;
+    wheel->start_ns = now_ns();
+    wheel->next_tick = 1;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+    list_init(&wheel->due);
+    return 0;
+}
+
+void timer_wheel_destroy(TimerWheel* wheel) {
+    if (wheel->has_thread) {
+        atomic_store(&wheel->stopping, 1);
+        pthread_mutex_lock(&wheel->lock);
+        program(wheel, wheel->next_tick); // wake the thread at once
+        pthread_mutex_unlock(&wheel->lock);
+        pthread_join(wheel->thread, NULL);
+    }
+    close(wheel->timer_fd);
+    pthread_cond_destroy(&wheel->callback_done);
+    pthread_mutex_destroy(&wheel->lock);
+}
+
+void timer_init(Timer* timer, TimerCallback callback, void* arg) {
+    memset(timer, 0, sizeof(*timer));
+    list_init(&timer->link);
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+void timer_arm(TimerWheel* wheel, Timer* timer, uint64_t delay_us, uint64_t interval_us) {
+    pthread_mutex_lock(&wheel->lock);
+
+    if (timer->pending) {
+        list_del(&timer->link);
+        wheel->count--;
+    }
+    if (wheel->count == 0) {
+        // Nothing is waiting on the ticks we slept through, so skip them
+        uint64_t now_tick = current_tick(wheel);
+        if (wheel->next_tick <= now_tick) wheel->next_tick = now_tick + 1;
+    }
+
+    // Round up so the timer never fires before its delay has passed
+    uint64_t deadline = now_ns() + delay_us * 1000 - wheel->start_ns;
+    timer->expires = (deadline + wheel->tick_ns - 1) / wheel->tick_ns;
+    timer->interval = interval_us ? (interval_us * 1000 + wheel->tick_ns - 1) / wheel->tick_ns : 0;
+
+    int level = add_locked(wheel, timer);
+    timer->pending = 1;
+    wheel->count++;
+    wheel->armed++;
+
+    uint64_t wake = level == 0 ? timer->expires : next_boundary(wheel->next_tick);
+    if (wheel->programmed_tick == 0 || wake < wheel->programmed_tick) {
+        program(wheel, wake);
+    }
+    pthread_mutex_unlock(&wheel->lock);
+}
+
+static int cancel_locked(TimerWheel* wheel, Timer* timer) {
+    if (!timer->pending) {
+        return 0;
+    }
+    list_del(&timer->link);
+    timer->pending = 0;
+    wheel->count--;
+    wheel->cancelled++;
+    return 1;
+}
+
+int timer_cancel(TimerWheel* wheel, Timer* timer) {
+    pthread_mutex_lock(&wheel->lock);
+    int was_pending = cancel_locked(wheel, timer);
+    pthread_mutex_unlock(&wheel->lock);
+    return was_pending;
+}
+
+void timer_cancel_sync(TimerWheel* wheel, Timer* timer) {
+    pthread_mutex_lock(&wheel->lock);
+    cancel_locked(wheel, timer);
+    while (wheel->running == timer) {
+        pthread_cond_wait(&wheel->callback_done, &wheel->lock);
+    }
+    pthread_mutex_unlock(&wheel->lock);
+}
+
+int timer_wheel_fd(TimerWheel* wheel) {
+    return wheel->timer_fd;
+}
+
+int timer_wheel_expire(TimerWheel* wheel) {
+    uint64_t expirations;
+    if (read(wheel->timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+        perror("timerfd read failed");
+    }
+
+    pthread_mutex_lock(&wheel->lock);
+    wheel->wakeups++;
+    wheel->programmed_tick = 0; // a one-shot timerfd is disarmed once it has fired
+    uint64_t now_tick = current_tick(wheel);
+    int fired = 0;
+
+    while (1) {
+        if (!list_empty(&wheel->due)) {
+            Timer* timer = (Timer*)wheel->due.next;
+            list_del(&timer->link);
+            timer->pending = 0;
+            wheel->count--;
+
+            if (timer->interval) {
+                timer->expires += timer->interval;
+                add_locked(wheel, timer);
+                timer->pending = 1;
+                wheel->count++;
+            }
+
+            TimerCallback callback = timer->callback;
+            void* arg = timer->arg;
+            wheel->running = timer;
+            pthread_mutex_unlock(&wheel->lock);
+
+            callback(arg);
+
+            pthread_mutex_lock(&wheel->lock);
+            wheel->running = NULL;
+            pthread_cond_broadcast(&wheel->callback_done);
+            wheel->fired++;
+            fired++;
+            continue;
+        }
+
+        if (wheel->next_tick > now_tick) break;
+        if (wheel->count == 0) {
+            wheel->next_tick = now_tick + 1;
+            break;
+        }
+        process_tick(wheel);
+    }
+
+    reprogram(wheel);
+    pthread_mutex_unlock(&wheel->lock);
+    return fired;
+}
+
+static void* wheel_thread(void* arg) {
+    TimerWheel* wheel = arg;
+    struct pollfd pfd = { wheel->timer_fd, POLLIN, 0 };
+
+    while (!atomic_load(&wheel->stopping)) {
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+            perror("poll failed");
+            break;
+        }
+        if (atomic_load(&wheel->stopping)) break;
+        timer_wheel_expire(wheel);
+    }
+    return NULL;
+}
+
+int timer_wheel_start(TimerWheel* wheel) {
+    if (pthread_create(&wheel->thread, NULL, wheel_thread, wheel) != 0) {
+        perror("Failed to start timer thread");
+        return -1;
+    }
+    wheel->has_thread = 1;
+    return 0;
+}
+
+void timer_wheel_print_stats(TimerWheel* wheel) {
+    pthread_mutex_lock(&wheel->lock);
+    printf("Timer wheel: %.3f ms ticks, %zu timers pending\n", wheel->tick_ns / 1e6, wheel->count);
+    printf("  armed: %lu, cancelled: %lu, fired: %lu, cascaded: %lu, wakeups: %lu\n",
+           wheel->armed, wheel->cancelled, wheel->fired, wheel->cascaded, wheel->wakeups);
+    pthread_mutex_unlock(&wheel->lock);
+}
@@ -0,0 +1,118 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_DEFAULT_TICK_US 1000
+
+typedef void (*TimerCallback)(void* arg);
+
+typedef struct TimerLink {
+    struct TimerLink* next;
+    struct TimerLink* prev;
+} TimerLink;
+
+/*
+ * A timer embedded in its owner's struct; the wheel never allocates.
+ * The link must stay the first member.
+ */
+typedef struct {
+    TimerLink link;
+    uint64_t expires;  // tick the timer is due on
+    uint64_t interval; // ticks between firings, 0 for one-shot
+    TimerCallback callback;
+    void* arg;
+    int pending;
+} Timer;
+
+/*
+ * Hierarchical timer wheel: four levels of 256 slots, so level n holds
+ * timers due within 256^(n+1) ticks. Arming and cancelling are O(1) list
+ * operations; timers on the outer levels are cascaded inwards as the
+ * inner level wraps. One timerfd per wheel sleeps until the next
+ * non-empty slot (or the next cascade), so an idle wheel does not tick.
+ *
+ * Thread-safe. Callbacks run on whichever thread calls
+ * timer_wheel_expire(), without the wheel's lock held, so they may arm
+ * and cancel timers themselves.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t callback_done;
+    int timer_fd;
+    uint64_t start_ns;
+    uint64_t tick_ns;
+    uint64_t next_tick;      // next tick to process
+    uint64_t programmed_tick; // tick the timerfd is set for, 0 if disarmed
+    TimerLink slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    TimerLink due;           // popped from level 0, callbacks not yet run
+    Timer* running;          // timer whose callback is running now
+    size_t count;
+    pthread_t thread;
+    int has_thread;
+    atomic_int stopping;
+
+    unsigned long armed;
+    unsigned long cancelled;
+    unsigned long fired;
+    unsigned long cascaded;
+    unsigned long wakeups;
+} TimerWheel;
+
+/**
+ * Set up an empty wheel and its timerfd.
+ * @param tick_us Resolution of the wheel in microseconds.
+ * @return 0 on success, -1 otherwise.
+ */
+int timer_wheel_init(TimerWheel* wheel, unsigned int tick_us);
+
+void timer_wheel_destroy(TimerWheel* wheel);
+
+void timer_init(Timer* timer, TimerCallback callback, void* arg);
+
+/**
+ * Arm (or re-arm) a timer. A pending timer is moved to its new expiry.
+ * Timers never fire early; they fire up to one tick late.
+ * @param delay_us Time until the first firing.
+ * @param interval_us Period for repeating timers, 0 for one-shot.
+ */
+void timer_arm(TimerWheel* wheel, Timer* timer, uint64_t delay_us, uint64_t interval_us);
+
+/**
+ * Disarm a timer.
+ * @return 1 if it was pending, 0 if it had already fired (its callback may still be running).
+ */
+int timer_cancel(TimerWheel* wheel, Timer* timer);
+
+/**
+ * Disarm a timer and wait for a running callback to return, so the
+ * timer's memory can be reused. Must not be called from that callback.
+ */
+void timer_cancel_sync(TimerWheel* wheel, Timer* timer);
+
+/**
+ * The wheel's timerfd, readable when timers are due. Add it to an
+ * existing poll/epoll loop, or use timer_wheel_start().
+ */
+int timer_wheel_fd(TimerWheel* wheel);
+
+/**
+ * Run the callbacks of every timer due by now.
+ * @return The number of callbacks run.
+ */
+int timer_wheel_expire(TimerWheel* wheel);
+
+/**
+ * Start a thread that waits on the timerfd and runs callbacks.
+ * @return 0 on success, -1 otherwise.
+ */
+int timer_wheel_start(TimerWheel* wheel);
+
+void timer_wheel_print_stats(TimerWheel* wheel);
+
+#endif // TIMERWHEEL_H
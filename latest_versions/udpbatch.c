@@ -0,0 +1,129 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "udpbatch.h"
+
+#define UDP_BATCH_CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+
+int udp_batch_init(UdpBatch* batch, int sockfd, size_t batch_size, size_t buffer_size) {
+    memset(batch, 0, sizeof(*batch));
+    if (batch_size == 0) batch_size = 1;
+    if (batch_size > UDP_BATCH_MAX_SIZE) batch_size = UDP_BATCH_MAX_SIZE;
+    batch->sockfd = sockfd;
+    batch->size = batch_size;
+    batch->buffer_size = buffer_size;
+
+    batch->msgs = calloc(batch_size, sizeof(struct mmsghdr));
+    batch->iovecs = calloc(batch_size, sizeof(struct iovec));
+    batch->addrs = calloc(batch_size, sizeof(struct sockaddr_in));
+    batch->buffers = malloc(batch_size * (buffer_size + 1));
+    batch->controls = calloc(batch_size, UDP_BATCH_CONTROL_SIZE);
+    if (!batch->msgs || !batch->iovecs || !batch->addrs || !batch->buffers || !batch->controls) {
+        perror("Failed to allocate UDP batch");
+        udp_batch_free(batch);
+        return -1;
+    }
+
+    for (size_t i = 0; i < batch_size; i++) {
+        batch->iovecs[i].iov_base = batch->buffers + i * (buffer_size + 1);
+        batch->iovecs[i].iov_len = buffer_size;
+    }
+
+    int on = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) == -1) {
+        perror("SO_RXQ_OVFL unavailable, socket drops will not be counted");
+    }
+    return 0;
+}
+
+size_t udp_batch_size_from_env(const char* name) {
+    char* value = getenv(name);
+    if (value && atoi(value) > 0) {
+        return atoi(value) > UDP_BATCH_MAX_SIZE ? UDP_BATCH_MAX_SIZE : (size_t)atoi(value);
+    }
+    return UDP_BATCH_DEFAULT_SIZE;
+}
+
+int udp_batch_receive(UdpBatch* batch) {
+    // recvmmsg overwrites the lengths, so every header is set up again
+    for (size_t i = 0; i < batch->size; i++) {
+        struct msghdr* header = &batch->msgs[i].msg_hdr;
+        header->msg_name = &batch->addrs[i];
+        header->msg_namelen = sizeof(struct sockaddr_in);
+        header->msg_iov = &batch->iovecs[i];
+        header->msg_iovlen = 1;
+        header->msg_control = batch->controls + i * UDP_BATCH_CONTROL_SIZE;
+        header->msg_controllen = UDP_BATCH_CONTROL_SIZE;
+        header->msg_flags = 0;
+    }
+
+    batch->received = 0;
+    int n = recvmmsg(batch->sockfd, batch->msgs, batch->size, MSG_WAITFORONE, NULL);
+    if (n <= 0) {
+        return n;
+    }
+    batch->received = n;
+
+    atomic_fetch_add_explicit(&batch->batches, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batch->datagrams, n, memory_order_relaxed);
+    if ((size_t)n == batch->size) {
+        atomic_fetch_add_explicit(&batch->full_batches, 1, memory_order_relaxed);
+    }
+    if ((unsigned long)n > atomic_load_explicit(&batch->max_fill, memory_order_relaxed)) {
+        atomic_store_explicit(&batch->max_fill, n, memory_order_relaxed);
+    }
+
+    // The drop counter is cumulative; the last datagram carries the latest value
+    struct msghdr* last = &batch->msgs[n - 1].msg_hdr;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(last); cmsg; cmsg = CMSG_NXTHDR(last, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            atomic_store_explicit(&batch->drops, drops, memory_order_relaxed);
+        }
+    }
+    return n;
+}
+
+char* udp_batch_datagram(UdpBatch* batch, size_t i, size_t* len, const struct sockaddr_in** from) {
+    if (i >= batch->received) {
+        return NULL;
+    }
+    if (batch->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+        atomic_fetch_add_explicit(&batch->truncated, 1, memory_order_relaxed);
+        return NULL;
+    }
+    char* data = batch->iovecs[i].iov_base;
+    *len = batch->msgs[i].msg_len;
+    data[*len] = '\0';
+    if (from) *from = &batch->addrs[i];
+    return data;
+}
+
+void udp_batch_print_stats(UdpBatch* batch, FILE* out, const char* name) {
+    unsigned long batches = atomic_load_explicit(&batch->batches, memory_order_relaxed);
+    unsigned long datagrams = atomic_load_explicit(&batch->datagrams, memory_order_relaxed);
+    fprintf(out, "%s UDP receive (batch of %zu):\n", name, batch->size);
+    fprintf(out, "  datagrams: %lu in %lu batches, average fill %.2f, max fill %lu, full batches: %lu\n",
+            datagrams, batches, batches ? (double)datagrams / batches : 0.0,
+            atomic_load_explicit(&batch->max_fill, memory_order_relaxed),
+            atomic_load_explicit(&batch->full_batches, memory_order_relaxed));
+    fprintf(out, "  truncated: %lu, dropped by the kernel (SO_RXQ_OVFL): %lu\n",
+            atomic_load_explicit(&batch->truncated, memory_order_relaxed),
+            atomic_load_explicit(&batch->drops, memory_order_relaxed));
+}
+
+void udp_batch_free(UdpBatch* batch) {
+    free(batch->msgs);
+    free(batch->iovecs);
+    free(batch->addrs);
+    free(batch->buffers);
+    free(batch->controls);
+    batch->msgs = NULL;
+    batch->iovecs = NULL;
+    batch->addrs = NULL;
+    batch->buffers = NULL;
+    batch->controls = NULL;
+    batch->received = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef UDPBATCH_H
+#define UDPBATCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define UDP_BATCH_DEFAULT_SIZE 32
+#define UDP_BATCH_MAX_SIZE 1024 // recvmmsg takes at most UIO_MAXIOV messages
+
+/*
+ * Receives datagrams with recvmmsg into a preallocated batch of buffers,
+ * so a busy socket is drained with one syscall per batch rather than per
+ * datagram. The kernel's count of datagrams dropped for want of socket
+ * buffer space (SO_RXQ_OVFL) arrives with each batch.
+ *
+ * Only the receiving thread touches the buffers; the counters may be
+ * read from anywhere.
+ */
+typedef struct {
+    int sockfd;
+    size_t size;        // datagrams per batch
+    size_t buffer_size; // bytes per datagram, excluding the terminating NUL
+    size_t received;    // datagrams in the current batch
+    struct mmsghdr* msgs; // complete only where _GNU_SOURCE is defined
+    struct iovec* iovecs;
+    struct sockaddr_in* addrs;
+    char* buffers;
+    char* controls;
+
+    atomic_ulong batches;
+    atomic_ulong datagrams;
+    atomic_ulong full_batches; // every buffer was used: more may have been waiting
+    atomic_ulong max_fill;
+    atomic_ulong truncated;    // larger than buffer_size, skipped
+    atomic_ulong drops;        // SO_RXQ_OVFL: dropped by the kernel since the batch was set up
+} UdpBatch;
+
+/**
+ * Allocate the batch and ask the kernel to report socket drops.
+ * @param batch_size Datagrams received per syscall, at most UDP_BATCH_MAX_SIZE.
+ * @param buffer_size Largest datagram accepted.
+ * @return 0 on success, -1 on failure.
+ */
+int udp_batch_init(UdpBatch* batch, int sockfd, size_t batch_size, size_t buffer_size);
+
+/**
+ * @return The batch size from the environment variable `name`, or UDP_BATCH_DEFAULT_SIZE if it is unset or invalid.
+ */
+size_t udp_batch_size_from_env(const char* name);
+
+/**
+ * Wait for at least one datagram, then take every datagram already queued, up to the batch size.
+ * @return The number received, or -1 on error (errno is kept, EINTR included).
+ */
+int udp_batch_receive(UdpBatch* batch);
+
+/**
+ * Datagram `i` of the last batch, NUL-terminated.
+ * @param len Set to its length.
+ * @param from Set to its sender; may be NULL.
+ * @return The datagram, or NULL if it was truncated.
+ */
+char* udp_batch_datagram(UdpBatch* batch, size_t i, size_t* len, const struct sockaddr_in** from);
+
+void udp_batch_print_stats(UdpBatch* batch, FILE* out, const char* name);
+
+void udp_batch_free(UdpBatch* batch);
+
+#endif // UDPBATCH_H
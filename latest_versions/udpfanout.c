@@ -0,0 +1,82 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "udpfanout.h"
+
+int udp_fanout_init(UdpFanout* fanout, int sockfd, size_t size) {
+    memset(fanout, 0, sizeof(*fanout));
+    if (size == 0) size = 1;
+    if (size > UDP_FANOUT_MAX_SIZE) size = UDP_FANOUT_MAX_SIZE;
+    fanout->sockfd = sockfd;
+    fanout->size = size;
+
+    fanout->msgs = calloc(size, sizeof(struct mmsghdr));
+    fanout->iovecs = calloc(size * UDP_FANOUT_MAX_IOVECS, sizeof(struct iovec));
+    fanout->addrs = calloc(size, sizeof(struct sockaddr_in));
+    if (!fanout->msgs || !fanout->iovecs || !fanout->addrs) {
+        perror("Failed to allocate UDP fan-out");
+        udp_fanout_free(fanout);
+        return -1;
+    }
+    return 0;
+}
+
+int udp_fanout_add(UdpFanout* fanout, const struct sockaddr_in* to, const struct iovec* iov, int iovcnt) {
+    if (iovcnt > UDP_FANOUT_MAX_IOVECS) {
+        return -1;
+    }
+    if (fanout->count == fanout->size) {
+        udp_fanout_flush(fanout);
+    }
+
+    size_t i = fanout->count++;
+    struct iovec* iovecs = fanout->iovecs + i * UDP_FANOUT_MAX_IOVECS;
+    memcpy(iovecs, iov, iovcnt * sizeof(struct iovec));
+    fanout->addrs[i] = *to;
+
+    struct msghdr* header = &fanout->msgs[i].msg_hdr;
+    memset(header, 0, sizeof(*header));
+    header->msg_name = &fanout->addrs[i];
+    header->msg_namelen = sizeof(struct sockaddr_in);
+    header->msg_iov = iovecs;
+    header->msg_iovlen = iovcnt;
+    return 0;
+}
+
+int udp_fanout_flush(UdpFanout* fanout) {
+    size_t next = 0;
+    int sent_total = 0;
+    while (next < fanout->count) {
+        int sent = sendmmsg(fanout->sockfd, fanout->msgs + next, fanout->count - next, 0);
+        fanout->calls++;
+        if (sent == -1) {
+            if (errno == EINTR) continue;
+            fanout->failed++; // the first one queued was refused; the rest may still go
+            next++;
+            continue;
+        }
+        next += sent;
+        sent_total += sent;
+    }
+    fanout->datagrams += sent_total;
+    fanout->count = 0;
+    return sent_total;
+}
+
+void udp_fanout_print_stats(UdpFanout* fanout, FILE* out, const char* name) {
+    fprintf(out, "%s UDP fan-out (batch of %zu):\n", name, fanout->size);
+    fprintf(out, "  datagrams: %lu in %lu sendmmsg calls (%.2f per call), refused: %lu\n",
+            fanout->datagrams, fanout->calls, fanout->calls ? (double)fanout->datagrams / fanout->calls : 0.0,
+            fanout->failed);
+}
+
+void udp_fanout_free(UdpFanout* fanout) {
+    free(fanout->msgs);
+    free(fanout->iovecs);
+    free(fanout->addrs);
+    fanout->msgs = NULL;
+    fanout->iovecs = NULL;
+    fanout->addrs = NULL;
+    fanout->count = 0;
+}
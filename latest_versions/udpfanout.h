@@ -0,0 +1,59 @@
+#ifndef UDPFANOUT_H
+#define UDPFANOUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#define UDP_FANOUT_DEFAULT_SIZE 64
+#define UDP_FANOUT_MAX_SIZE 1024 // sendmmsg takes at most UIO_MAXIOV messages
+#define UDP_FANOUT_MAX_IOVECS 4
+
+/*
+ * Sends one datagram to many destinations with sendmmsg: datagrams are
+ * queued, each as a destination and a few iovecs, and go out together
+ * on the next flush, one syscall per `size` datagrams rather than one
+ * each. Only the iovec descriptors are copied, so payload shared between
+ * destinations is laid out once and must stay put until the flush.
+ *
+ * Not thread safe: one fan-out per sending thread.
+ */
+typedef struct {
+    int sockfd;
+    size_t size;  // datagrams per sendmmsg
+    size_t count; // queued since the last flush
+    struct mmsghdr* msgs; // complete only where _GNU_SOURCE is defined
+    struct iovec* iovecs; // UDP_FANOUT_MAX_IOVECS per datagram
+    struct sockaddr_in* addrs;
+
+    unsigned long calls;     // sendmmsg syscalls made
+    unsigned long datagrams; // datagrams the kernel accepted
+    unsigned long failed;    // datagrams refused, each skipped
+} UdpFanout;
+
+/**
+ * @param size Datagrams per syscall, at most UDP_FANOUT_MAX_SIZE.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int udp_fanout_init(UdpFanout* fanout, int sockfd, size_t size);
+
+/**
+ * Queue a datagram, flushing first if the batch is full.
+ * @param iovcnt At most UDP_FANOUT_MAX_IOVECS; the data must stay valid until the flush.
+ * @return 0 on success, -1 if the datagram has too many iovecs.
+ */
+int udp_fanout_add(UdpFanout* fanout, const struct sockaddr_in* to, const struct iovec* iov, int iovcnt);
+
+/**
+ * Send everything queued. A datagram the kernel refuses is counted and skipped.
+ * @return The number of datagrams sent.
+ */
+int udp_fanout_flush(UdpFanout* fanout);
+
+void udp_fanout_print_stats(UdpFanout* fanout, FILE* out, const char* name);
+
+void udp_fanout_free(UdpFanout* fanout);
+
+#endif // UDPFANOUT_H
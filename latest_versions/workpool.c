@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include "workpool.h"
+
+static int dequeue(WorkPool* pool, WorkItem* out) {
+    size_t pos = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+
+    while (1) {
+        WorkSlot* slot = &pool->slots[pos & pool->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pool->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                *out = slot->item;
+                // Hand the slot back to producers one lap later
+                atomic_store_explicit(&slot->sequence, pos + pool->mask + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // empty
+        } else {
+            pos = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static int enqueue(WorkPool* pool, const WorkItem* item) {
+    size_t pos = atomic_load_explicit(&pool->enqueue_pos, memory_order_relaxed);
+
+    while (1) {
+        WorkSlot* slot = &pool->slots[pos & pool->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pool->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                slot->item = *item;
+                atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // full
+        } else {
+            pos = atomic_load_explicit(&pool->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static void run_item(WorkPool* pool, WorkItem* item) {
+    atomic_fetch_add_explicit(&pool->busy, 1, memory_order_relaxed);
+    pool->handler(item);
+    atomic_fetch_sub_explicit(&pool->busy, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->completed, 1, memory_order_relaxed);
+}
+
+static void* worker_thread(void* arg) {
+    WorkPool* pool = arg;
+    WorkItem item;
+
+    while (1) {
+        while (sem_wait(&pool->available) == -1 && errno == EINTR) {
+        }
+        // Every post follows an enqueue, so an item is on its way even if the head slot
+        // looks empty: an earlier producer may have claimed it and not yet published it.
+        // Giving up here would strand a later producer's item with no token left for it.
+        int got = dequeue(pool, &item) == 0;
+        while (!got && !atomic_load(&pool->stopping)) {
+            sched_yield();
+            got = dequeue(pool, &item) == 0;
+        }
+        if (!got) {
+            break;
+        }
+        run_item(pool, &item);
+    }
+    return NULL;
+}
+
+WorkPool* workpool_create(size_t threads, size_t capacity, void (*handler)(WorkItem*), OverflowPolicy policy) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    WorkPool* pool = calloc(1, sizeof(WorkPool));
+    if (!pool) {
+        perror("Failed to allocate worker pool");
+        return NULL;
+    }
+
+    pool->slots = calloc(size, sizeof(WorkSlot));
+    pool->threads = calloc(threads, sizeof(pthread_t));
+    if (!pool->slots || !pool->threads) {
+        perror("Failed to allocate worker pool");
+        free(pool->slots);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&pool->slots[i].sequence, i);
+    }
+    pool->mask = size - 1;
+    pool->handler = handler;
+    pool->policy = policy;
+    sem_init(&pool->available, 0, 0);
+
+    for (size_t i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0) {
+            perror("Failed to start worker thread");
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        workpool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int workpool_submit(WorkPool* pool, const WorkItem* item) {
+    if (enqueue(pool, item) == 0) {
+        atomic_fetch_add_explicit(&pool->submitted, 1, memory_order_relaxed);
+
+        size_t depth = workpool_depth(pool);
+        unsigned long high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+        while (depth > high_water && !atomic_compare_exchange_weak_explicit(&pool->high_water, &high_water, depth, memory_order_relaxed, memory_order_relaxed)) {
+        }
+
+        sem_post(&pool->available);
+        return 0;
+    }
+
+    if (pool->policy == WORKPOOL_CALLER_RUNS) {
+        WorkItem copy = *item;
+        atomic_fetch_add_explicit(&pool->caller_ran, 1, memory_order_relaxed);
+        run_item(pool, &copy);
+        return 0;
+    }
+
+    atomic_fetch_add_explicit(&pool->rejected, 1, memory_order_relaxed);
+    return -1;
+}
+
+size_t workpool_depth(WorkPool* pool) {
+    size_t enqueued = atomic_load_explicit(&pool->enqueue_pos, memory_order_relaxed);
+    size_t dequeued = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+void workpool_print_stats(WorkPool* pool) {
+    printf("Worker pool: %zu threads, queue capacity %zu, overflow policy %s\n",
+           pool->thread_count, pool->mask + 1,
+           pool->policy == WORKPOOL_REJECT ? "reject" : "caller-runs");
+    printf("  queue depth: %zu, high water: %lu, busy workers: %u\n",
+           workpool_depth(pool), atomic_load(&pool->high_water), atomic_load(&pool->busy));
+    printf("  submitted: %lu, completed: %lu, rejected: %lu, ran on caller: %lu\n",
+           atomic_load(&pool->submitted), atomic_load(&pool->completed),
+           atomic_load(&pool->rejected), atomic_load(&pool->caller_ran));
+}
+
+void workpool_destroy(WorkPool* pool) {
+    atomic_store(&pool->stopping, 1);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        sem_post(&pool->available);
+    }
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    sem_destroy(&pool->available);
+    free(pool->slots);
+    free(pool->threads);
+    free(pool);
+}
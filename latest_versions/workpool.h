@@ -0,0 +1,82 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WORK_MESSAGE_SIZE 256
+#define WORKPOOL_DEFAULT_THREADS 16
+#define WORKPOOL_DEFAULT_CAPACITY 1024
+
+// One unit of work, copied by value into the queue so submission never allocates
+typedef struct {
+    int socket;                      // client connection, owned by the job
+    struct timespec received_at;     // when the frame was taken off the socket
+    char message[WORK_MESSAGE_SIZE];
+} WorkItem;
+
+typedef enum {
+    WORKPOOL_REJECT,      // fail the submission, the caller answers for the job
+    WORKPOOL_CALLER_RUNS  // run the job on the submitting thread
+} OverflowPolicy;
+
+typedef struct {
+    atomic_size_t sequence;
+    WorkItem item;
+} WorkSlot;
+
+/*
+ * Fixed set of worker threads fed by a bounded lock-free MPMC ring
+ * (sequence-numbered slots, one CAS per enqueue/dequeue). Idle workers
+ * sleep on a semaphore that is posted once per queued item.
+ */
+typedef struct {
+    WorkSlot* slots;
+    size_t mask;
+    _Alignas(64) atomic_size_t enqueue_pos;
+    _Alignas(64) atomic_size_t dequeue_pos;
+    _Alignas(64) sem_t available;
+
+    pthread_t* threads;
+    size_t thread_count;
+    void (*handler)(WorkItem* item);
+    OverflowPolicy policy;
+    atomic_int stopping;
+
+    atomic_ulong submitted;
+    atomic_ulong rejected;
+    atomic_ulong caller_ran;
+    atomic_ulong completed;
+    atomic_ulong high_water;
+    atomic_uint busy;
+} WorkPool;
+
+/**
+ * Start a pool of worker threads.
+ * @param threads Number of worker threads.
+ * @param capacity Queue capacity, rounded up to a power of two.
+ * @param handler Called on a worker for every submitted item.
+ * @param policy What to do when the queue is full.
+ * @return The pool, or NULL on failure.
+ */
+WorkPool* workpool_create(size_t threads, size_t capacity, void (*handler)(WorkItem*), OverflowPolicy policy);
+
+/**
+ * Queue an item for the workers.
+ * @return 0 if queued (or run on the caller), -1 if rejected because the queue is full.
+ */
+int workpool_submit(WorkPool* pool, const WorkItem* item);
+
+// Items currently waiting in the queue
+size_t workpool_depth(WorkPool* pool);
+
+void workpool_print_stats(WorkPool* pool);
+
+// Stop the workers once the queue has drained and free the pool
+void workpool_destroy(WorkPool* pool);
+
+#endif // WORKPOOL_H